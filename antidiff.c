@@ -208,7 +208,7 @@ static const may_antidiff_table_t may_antidiff_table[] = {
   { "^F0L1-2", "tan(a+b*x)/b", NOTHING},
   { "*2F1L1^F0L1-2", "1/b/cos(a+b*x)", NOTHING},
   { "*2F2L1^F0L1-1", "1/b/cos(a+b*x)", NOTHING},
-  { "*2^F12^F0L1-1", "-sin(a+b*x)/b+ln(1/cos(a+b*x)+tan(a+b*x))/b", NOTHING},
+  { "*2^F1L12^F0L1-1", "-sin(a+b*x)/b+ln(1/cos(a+b*x)+tan(a+b*x))/b", NOTHING},
   { "*2F1L1F2L1",    "-sin(a+b*x)/b+ln(1/cos(a+b*x)+tan(a+b*x))/b", NOTHING},
   { "*2F0L1^F1L1-2", "-1/b/sin(a+b*x)", NOTHING},
   { "*2^F2L1-1^F1L1-1", "-1/b/sin(a+b*x)", NOTHING},
@@ -269,9 +269,17 @@ static const char *const FunctionTable[] = {
   may_exp_name, may_log_name, may_abs_name, may_sign_name, may_floor_name
 };
 
-/* Name of the variables A, B, C, D and X in the expression colummn of may_antidiff_table */
+/* Return the index in FunctionTable of the function code c */
+static int function_code (int c)
+{
+  int n = (c >= '0' && c <= '9') ? c-'0' : (c >= 'A' && c <= 'Z') ? c-'A'+10 : c-'a'+26+10;
+  MAY_ASSERT (n >= 0 && n < (int)numberof( FunctionTable));
+  return n;
+}
+
+/* Name of the variables A, B, C, D, X and P in the expression colummn of may_antidiff_table */
 static const char *const name[] = {
-  "a", "b", "c", "d", "x", "p", "SQRT"
+  "a", "b", "c", "d", "x", "p"
 };
 
 /* Lists all the permutations of {0, 1} and {0, 1, 2} */
@@ -546,7 +554,7 @@ static int match_product (const char ** ByteCode, may_t f, int n)
 static int fast_match (const char ** ByteCode, may_t f)
 {
   long p, q = 1;
-  int sign, n;
+  int n;
 
   /* Compare the byte code with the expression */
   switch (*(*ByteCode)++) {
@@ -618,9 +626,7 @@ static int fast_match (const char ** ByteCode, may_t f)
 
     /* Does it match a function? */
   case 'F':
-    sign = *(*ByteCode)++;
-    n = (sign >= '0' && sign <= '9') ? sign-'0' : (sign >= 'A' && sign <= 'Z') ? sign-'A'+10 : sign-'a'+26+10;
-    MAY_ASSERT (n >= 0 && n < (int)numberof( FunctionTable));
+    n = function_code (*(*ByteCode)++);
     if (may_get_name (f) != FunctionTable[n])
       return 0;
     return fast_match (ByteCode, may_op (f, 0));
@@ -656,6 +662,297 @@ static int fast_match (const char ** ByteCode, may_t f)
   }
 }
 
+/* Classes of expressions used to index the table:
+   an entry is only tried if the class of its first opcode agrees
+   with the class of the expression (See class_agree) */
+#define CLASS_GENERIC    0
+#define CLASS_X          1
+#define CLASS_POW        2
+#define CLASS_PRODUCT2   3
+#define CLASS_PRODUCT3   4
+#define CLASS_FUNC(n)    (5+(n))
+#define CLASS_POWFUNC(n) (5+(int) numberof (FunctionTable)+(n))
+#define CLASS_NUM        (5+2*(int) numberof (FunctionTable))
+#define CLASS_INVALID    CLASS_NUM /* Malformed ByteCode: never agrees */
+
+/* Return the ByteCode after the first term of ByteCode
+   (It stops at the end of the ByteCode if it is truncated) */
+static const char *skip_bytecode (const char *ByteCode)
+{
+  int n;
+  if (*ByteCode == 0)
+    return ByteCode;
+  switch (*ByteCode++) {
+  case '$':
+    return skip_bytecode (ByteCode);
+  case '^':
+    return skip_bytecode (skip_bytecode (ByteCode));
+  case 'F':
+    return *ByteCode == 0 ? ByteCode : skip_bytecode (ByteCode+1);
+  case 'L':
+  case 'J':
+    return *ByteCode == 0 ? ByteCode : ByteCode+1;
+  case '*':
+    if (*ByteCode == 0)
+      return ByteCode;
+    n = *ByteCode++ - '0';
+    while (n-- > 0)
+      ByteCode = skip_bytecode (ByteCode);
+    return ByteCode;
+  case '-':
+  case '0': case '1': case '2': case '3': case '4':
+  case '5': case '6': case '7': case '8': case '9':
+    while (*ByteCode >= '0' && *ByteCode <= '9')
+      ByteCode++;
+    if (*ByteCode == ',')
+      while (*++ByteCode >= '0' && *ByteCode <= '9')
+        ;
+    return ByteCode;
+  default:
+    return ByteCode;
+  }
+}
+
+/* Return the class of the expressions which may match the first term of ByteCode */
+static int class_bytecode (const char *ByteCode)
+{
+  while (*ByteCode == '$')
+    ByteCode++;
+  switch (ByteCode[0]) {
+  case 'X':
+    return CLASS_X;
+  case '^':
+    return ByteCode[1] == 'F' ? CLASS_POWFUNC (function_code (ByteCode[2])) : CLASS_POW;
+  case 'F':
+    return CLASS_FUNC (function_code (ByteCode[1]));
+  case '*':
+    return ByteCode[1] == '2' ? CLASS_PRODUCT2
+      : ByteCode[1] == '3' ? CLASS_PRODUCT3 : CLASS_GENERIC;
+  default:
+    return CLASS_GENERIC;
+  }
+}
+
+/* Check if an expression of class 'e' may match a ByteCode of class 'r' */
+static int class_agree (int r, int e)
+{
+  return r == CLASS_GENERIC || r == e
+    || (r == CLASS_POW && e >= CLASS_POWFUNC (0));
+}
+
+/* Return the class of the expression f (not a product) */
+static int class_term (may_t f)
+{
+  const char *fname;
+  int i, pow = 0;
+
+  if (may_identical (f, X) == 0)
+    return CLASS_X;
+  fname = may_get_name (f);
+  if (fname == may_pow_name) {
+    fname = may_get_name (may_op (f, 0));
+    pow = 1;
+  }
+  for (i = 0; i < (int) numberof (FunctionTable); i++)
+    if (fname == FunctionTable[i])
+      return pow ? CLASS_POWFUNC (i) : CLASS_FUNC (i);
+  return pow ? CLASS_POW : CLASS_GENERIC;
+}
+
+/* Return the class of the expression f, and if it is a product of 2 or 3 terms,
+   the classes of its terms in klass (See match_product) */
+static int class_expr (may_t f, unsigned char klass[3])
+{
+  if (!may_product_p (f))
+    return class_term (f);
+
+  may_t coeff, p, b;
+  may_iterator_t it;
+  int n = 0;
+  for ( coeff = may_product_iterator_init (it, f) ;
+        may_product_iterator_end (&p, &b, it)     ;
+        may_product_iterator_next (it) ) {
+    if (n >= 3)
+      return CLASS_GENERIC;
+    klass[n++] = class_term (may_product_iterator_ref (it));
+  }
+  if (!may_one_p (coeff)) {
+    if (n >= 3)
+      return CLASS_GENERIC;
+    klass[n++] = CLASS_GENERIC;
+  }
+  return n == 2 ? CLASS_PRODUCT2 : n == 3 ? CLASS_PRODUCT3 : CLASS_GENERIC;
+}
+
+/* Quick check of the terms of a product: each class expected by the entry
+   must be provided by at least as many terms of the product */
+static int check_klass (const unsigned char rule[3], const unsigned char klass[3], int n)
+{
+  for (int i = 0; i < n; i++) {
+    int r = rule[i], need = 0, have = 0;
+    if (r == CLASS_GENERIC)
+      continue;
+    for (int j = 0; j < n; j++) {
+      need += rule[j] == r;
+      have += class_agree (r, klass[j]);
+    }
+    if (have < need)
+      return 0;
+  }
+  return 1;
+}
+
+/* The compiled antidiff table:
+   + formula: the parsed and evaluated formula of each entry of the table,
+     with the variables replaced by the wildcards $0..$5 (See name)
+   + sqrt_p: if the formula of each entry uses SQRT
+   + klass: the classes of the operands expected by each entry (3 per entry)
+   + start / rule: the entries to try for each class of expression
+   It is compiled by the first call to may_antidiff in its own heap,
+   which is never compacted, and shared by all the threads. */
+#ifdef MAY_WANT_THREAD
+# define ANTIDIFF_ATOMIC MAY_ATOMIC_ATTR
+#else
+# define ANTIDIFF_ATOMIC
+#endif
+
+#define ANTIDIFF_HEAP_SIZE (256*1024)
+
+static struct {
+  may_t *formula;
+  unsigned char *sqrt_p;
+  unsigned char *klass;
+  unsigned short *start, *rule;
+  struct may_heap_s heap;
+  ANTIDIFF_ATOMIC int compiled;
+  MAY_DEF_IF_THREAD (pthread_mutex_t mutex;)
+} antidiff_table = { NULL, NULL, NULL, NULL, NULL, {0}, 0
+                     MAY_DEF_IF_THREAD (, PTHREAD_MUTEX_INITIALIZER) };
+
+/* Compile the antidiff table in the current heap */
+static void
+antidiff_compile_table (void)
+{
+  const unsigned int n = numberof (may_antidiff_table);
+  unsigned char lead[numberof (may_antidiff_table)];
+  const void *wildcard[numberof (name)];
+  unsigned int i, k, count;
+  int e;
+
+  for (i = 0; i < numberof (name); i++) {
+    char buffer[3] = { '$', '0' + i, 0 };
+    wildcard[i] = may_set_str (buffer);
+  }
+  antidiff_table.formula = MAY_ALLOC (n * sizeof (may_t));
+  antidiff_table.sqrt_p  = MAY_ALLOC (n);
+  antidiff_table.klass   = MAY_ALLOC (3 * n);
+  for (i = 0; i < n; i++) {
+    const char *ByteCode = may_antidiff_table[i].ByteCode;
+    may_mark_t mark;
+    may_t r;
+    may_mark (mark);
+    may_parse_c (&r, may_antidiff_table[i].expression);
+    MAY_ASSERT (r != NULL);
+    r = may_subs_c (r, 1, numberof (name), name, wildcard);
+    /* The formulas using diff can't be evaluated before the substitution
+       (diff(p,x) is 0 if p is not replaced) */
+    if (strstr (may_antidiff_table[i].expression, "diff(") == NULL)
+      r = may_eval (r);
+    antidiff_table.formula[i] = may_compact (mark, r);
+    antidiff_table.sqrt_p[i]
+      = strstr (may_antidiff_table[i].expression, "SQRT(") != NULL;
+    lead[i] = class_bytecode (ByteCode);
+    memset (&antidiff_table.klass[3*i], CLASS_GENERIC, 3);
+    if (lead[i] == CLASS_PRODUCT2 || lead[i] == CLASS_PRODUCT3) {
+      /* Classes of each term of the product */
+      ByteCode += 2;
+      for (k = 0; k < (lead[i] == CLASS_PRODUCT2 ? 2U : 3U); k++) {
+        antidiff_table.klass[3*i+k] = class_bytecode (ByteCode);
+        ByteCode = skip_bytecode (ByteCode);
+      }
+    } else
+      ByteCode = skip_bytecode (ByteCode);
+    /* An entry which doesn't end exactly with its ByteCode is malformed:
+       it is never tried */
+    if (*ByteCode != 0) {
+      MAY_LOG_MSG (("Malformed antidiff entry '%s'\n",
+                    may_antidiff_table[i].ByteCode));
+      lead[i] = CLASS_INVALID;
+    }
+  }
+
+  /* Build the list of entries for each class (keeping the order of the table) */
+  antidiff_table.start = MAY_ALLOC ((CLASS_NUM + 1) * sizeof (unsigned short));
+  for (count = 0, e = 0; e < CLASS_NUM; e++)
+    for (i = 0; i < n; i++)
+      count += class_agree (lead[i], e);
+  antidiff_table.rule = MAY_ALLOC (count * sizeof (unsigned short));
+  for (count = 0, e = 0; e < CLASS_NUM; e++) {
+    antidiff_table.start[e] = count;
+    for (i = 0; i < n; i++)
+      if (class_agree (lead[i], e))
+        antidiff_table.rule[count++] = i;
+  }
+  antidiff_table.start[CLASS_NUM] = count;
+}
+
+/* Compile the antidiff table if it isn't done yet.
+   It is compiled in the heap of the table with the default settings
+   of the kernel, and without the budget of the computation */
+static void
+antidiff_compile (void)
+{
+  if (MAY_LIKELY (antidiff_table.compiled))
+    return;
+  MAY_DEF_IF_THREAD (pthread_mutex_lock (&antidiff_table.mutex);)
+  if (!antidiff_table.compiled) {
+    struct may_heap_s heap = may_g.Heap;
+    struct may_budget_s budget = may_g.budget;
+    may_t intmod = may_kernel_intmod (NULL);
+    may_domain_e domain = may_kernel_domain (MAY_COMPLEX_D);
+    int presimplify = may_kernel_num_presimplify (1);
+    int base = may_kernel_base (10);
+    volatile int error = 0;
+    const char *error_str = NULL;
+
+    may_g.budget.active = 0;
+    may_g.budget.limit = NULL;
+    may_g.budget.disabled ++;
+    may_heap_init (&antidiff_table.heap, ANTIDIFF_HEAP_SIZE, 0, 0);
+    MAY_TRY {
+      may_g.Heap = antidiff_table.heap;
+      antidiff_compile_table ();
+      antidiff_table.heap = may_g.Heap;
+    } MAY_CATCH {
+      error = MAY_ERROR;
+      may_error_get (NULL, &error_str);
+    } MAY_ENDTRY;
+    may_g.Heap = heap;
+    may_g.budget = budget;
+    may_kernel_intmod (intmod);
+    may_kernel_domain (domain);
+    may_kernel_num_presimplify (presimplify);
+    may_kernel_base (base);
+    if (MAY_UNLIKELY (error != 0)) {
+      may_heap_clear (&antidiff_table.heap);
+      MAY_DEF_IF_THREAD (pthread_mutex_unlock (&antidiff_table.mutex);)
+      may_error_throw (error, error_str);
+    }
+    antidiff_table.compiled = 1;
+  }
+  MAY_DEF_IF_THREAD (pthread_mutex_unlock (&antidiff_table.mutex);)
+}
+
+/* Free the compiled antidiff table (at the end of the kernel) */
+void
+may_antidiff_clear (void)
+{
+  if (antidiff_table.compiled) {
+    may_heap_clear (&antidiff_table.heap);
+    antidiff_table.compiled = 0;
+  }
+}
+
 static may_t
 antidiff (may_t f)
 {
@@ -701,20 +998,30 @@ antidiff (may_t f)
    }
 
    /* Lock for base in the precomputed antidiff table.
+      Only the entries which agree with the class of base are tried.
       If it matches, return the antidiff by replacing a,b,c,x by their values. */
-   for (unsigned int i = 0; i < numberof (may_antidiff_table) ; i++) {
+   unsigned char klass[3];
+   int e = class_expr (base, klass);
+   int n = e == CLASS_PRODUCT2 ? 2 : e == CLASS_PRODUCT3 ? 3 : 0;
+   for (unsigned int j = antidiff_table.start[e];
+        j < antidiff_table.start[e+1]; j++) {
+     unsigned int i = antidiff_table.rule[j];
+     if (!check_klass (&antidiff_table.klass[3*i], klass, n))
+       continue;
      const char *ByteCode = may_antidiff_table[i].ByteCode;
      /* Reinit the wildcard variables */
      A = B = C = D = P = 0;
      may_g.antidiff.condition = may_antidiff_table[i].condition;
      if (fast_match(&ByteCode, base)) {
        /* Note that the following evaluation may destroy the values of the global variables */
-       const void *value[numberof(name)] = { A, B , C , D, X , P, (const void *)special_sqrt};
-       may_t r;
-       /* So don't eval the expression until we have replace the values of the global variables */
-       may_parse_c (&r, may_antidiff_table[i].expression);
-       MAY_ASSERT (r != NULL);
-       r = may_subs_c (r, 1, numberof (name), name, value);
+       const may_t value[numberof(name)] = { A, B , C , D, X , P };
+       may_t r = may_rewrite_instantiate (antidiff_table.formula[i], value,
+                                          numberof (name));
+       if (antidiff_table.sqrt_p[i]) {
+         static const char *const sqrt_name[] = { "SQRT" };
+         const void *sqrt_func[] = { (const void *) special_sqrt };
+         r = may_subs_c (r, 1, 1, sqrt_name, sqrt_func);
+       }
        /* Now the global variables may be reused */
        return may_mul (constant, may_eval (r));
      }
@@ -730,6 +1037,8 @@ may_antidiff (may_t f, may_t var)
   MAY_LOG_FUNC (("f='%Y' var='%Y'", f, var));
   MAY_ASSERT (MAY_TYPE (var) == MAY_STRING_T);
 
+  antidiff_compile ();
+
   may_mark ();
   X = var;
   may_t f2, y;
@@ -19,52 +19,218 @@ MA 02110-1301, USA. */
 
 #include "may-impl.h"
 
-/* Define a generic BINTREE by overiding the numerical functions used in
-   bintree */
-#define may_bintree_size may_genbintree_size
-#define may_bintree_get_sum may_genbintree_get_sum
-#define may_bintree_insert may_genbintree_insert
-#undef MAY_PURENUM_P
-#define MAY_PURENUM_P(x) MAY_EVAL_P(x)
-#undef MAY_CLOSE_C
-#define MAY_CLOSE_C(a,b,c) (void)0
-#define may_num_zero_p(x) (0)
-#define may_num_one_p(x)  (0)
-#define may_num_simplify(x) may_eval(x)
-#define may_num_set(d,a) (a)
-#define may_num_add(d,a,b) may_add_c(a,b)
-#include "expand_bintree.c"
+/* The polynomial in x is accumulated in a hash set of its monomials in x
+   (the keys) with, for each key, the list of the terms of its coefficient.
+   The expression is collected recursively without being expanded:
+   the independent subterms are kept as they are, the sums are collected
+   term by term, the independent factors of the products are moved to
+   the coefficients, and only the dependent factors are multiplied. */
+typedef struct {
+  may_hset_t  key;      /* Monomials in x */
+  may_list_t *coef;     /* coef[i]: terms of the coefficient of the i-th key */
+  may_size_t  alloc;
+} collect_t;
+
+static void
+collect_init (collect_t *r)
+{
+  may_hset_init (r->key, 0);
+  r->coef = NULL;
+  r->alloc = 0;
+}
+
+static may_size_t
+collect_size (collect_t *r)
+{
+  return may_hset_get_size (r->key);
+}
+
+/* Add c*k to r (k being a monomial in x) */
+static void
+collect_add (collect_t *r, may_t k, may_t c)
+{
+  may_size_t n = may_hset_get_size (r->key);
+  may_size_t i = may_hset_push_back (r->key, k);
+
+  if (i == n) {
+    if (n >= r->alloc) {
+      may_size_t alloc = 2 * r->alloc + 8;
+      r->coef = may_realloc (r->coef, r->alloc * sizeof (may_list_t),
+                             alloc * sizeof (may_list_t));
+      r->alloc = alloc;
+    }
+    may_list_init (r->coef[i], 0);
+  }
+  may_list_push_back (r->coef[i], c);
+}
+
+/* Return the (evaluated) coefficient of the i-th key of r */
+static may_t
+collect_coef (collect_t *r, may_size_t i)
+{
+  may_size_t n = may_list_get_size (r->coef[i]);
+  if (n == 1)
+    return may_eval (may_list_at (r->coef[i], 0));
+  return may_eval (may_add_vc (n, r->coef[i]->base));
+}
+
+static int
+collect_independent_p (may_t a, may_t x)
+{
+  return MAY_TYPE (x) == MAY_LIST_T ? may_independent_vp (a, x)
+    : may_independent_p (a, x);
+}
+
+/* Return true if the dependent factor a belongs to the monomials */
+static int
+collect_key_p (may_t a, may_t x)
+{
+  if (MAY_TYPE (x) == MAY_LIST_T)
+    return 1;
+  if (MAY_TYPE (a) == MAY_POW_T)
+    a = MAY_AT (a, 0);
+  return may_identical (a, x) == 0;
+}
+
+static void collect_recur (collect_t *, may_t, may_t, may_t, may_t);
+
+/* r += k*c*a*b */
+static void
+collect_mul (collect_t *r, collect_t *a, collect_t *b, may_t k, may_t c)
+{
+  may_size_t i, j;
+  for (i = 0; i < collect_size (a); i++) {
+    may_t ka = may_mul (k, may_hset_at (a->key, i));
+    may_t ca = may_mul_c (c, collect_coef (a, i));
+    for (j = 0; j < collect_size (b); j++)
+      collect_add (r, may_mul (ka, may_hset_at (b->key, j)),
+                   may_mul_c (ca, collect_coef (b, j)));
+  }
+}
+
+/* r += k*c*a^n by binary powering */
+static void
+collect_pow (collect_t *r, may_t a, unsigned long n, may_t x, may_t k, may_t c)
+{
+  collect_t q, t;
+  may_size_t i;
+
+  if (n == 1) {
+    collect_recur (r, a, x, k, c);
+    return;
+  }
+  collect_init (&q);
+  collect_pow (&q, a, n/2, x, MAY_ONE, MAY_ONE);
+  if (n % 2 == 0) {
+    collect_mul (r, &q, &q, k, c);
+    return;
+  }
+  collect_init (&t);
+  collect_mul (&t, &q, &q, MAY_ONE, MAY_ONE);
+  for (i = 0; i < collect_size (&t); i++)
+    collect_recur (r, a, x, may_mul (k, may_hset_at (t.key, i)),
+                   may_mul_c (c, collect_coef (&t, i)));
+}
+
+/* r += k*c*a with a evaluated */
+static void
+collect_recur (collect_t *r, may_t a, may_t x, may_t k, may_t c)
+{
+  may_size_t i, n;
+
+  if (collect_independent_p (a, x)) {
+    collect_add (r, k, may_mul_c (c, a));
+    return;
+  }
+
+  switch (MAY_TYPE (a)) {
+  case MAY_SUM_T:
+    n = MAY_NODE_SIZE (a);
+    for (i = 0; i < n; i++)
+      collect_recur (r, MAY_AT (a, i), x, k, c);
+    return;
+  case MAY_FACTOR_T:
+    collect_recur (r, MAY_AT (a, 1), x, k, may_mul_c (c, MAY_AT (a, 0)));
+    return;
+  case MAY_PRODUCT_T:
+    {
+      collect_t p, q;
+      may_t dep = NULL;
+      int first = 1;
+
+      n = MAY_NODE_SIZE (a);
+      collect_init (&p);
+      for (i = 0; i < n; i++) {
+        may_t f = MAY_AT (a, i);
+        if (collect_independent_p (f, x))
+          c = may_mul_c (c, f);
+        else if (dep == NULL)
+          dep = f;
+        else {
+          /* p = p * f */
+          if (first) {
+            collect_recur (&p, dep, x, MAY_ONE, MAY_ONE);
+            first = 0;
+          }
+          collect_init (&q);
+          for (may_size_t j = 0; j < collect_size (&p); j++)
+            collect_recur (&q, f, x, may_hset_at (p.key, j),
+                           collect_coef (&p, j));
+          p = q;
+        }
+      }
+      if (first)
+        collect_recur (r, dep, x, k, c);
+      else
+        for (i = 0; i < collect_size (&p); i++)
+          collect_add (r, may_mul (k, may_hset_at (p.key, i)),
+                       may_mul_c (c, collect_coef (&p, i)));
+    }
+    return;
+  case MAY_POW_T:
+    if (MAY_TYPE (MAY_AT (a, 1)) == MAY_INT_T
+        && (MAY_TYPE (MAY_AT (a, 0)) == MAY_SUM_T
+            || MAY_TYPE (MAY_AT (a, 0)) == MAY_PRODUCT_T
+            || MAY_TYPE (MAY_AT (a, 0)) == MAY_FACTOR_T)
+        && mpz_cmp_ui (MAY_INT (MAY_AT (a, 1)), 1) > 0
+        && mpz_fits_ulong_p (MAY_INT (MAY_AT (a, 1)))) {
+      collect_pow (r, MAY_AT (a, 0), mpz_get_ui (MAY_INT (MAY_AT (a, 1))),
+                   x, k, c);
+      return;
+    }
+    break;
+  default:
+    break;
+  }
+  /* Dependent factor which isn't decomposed */
+  if (collect_key_p (a, x))
+    collect_add (r, may_mul (k, a), c);
+  else
+    collect_add (r, k, may_mul_c (c, a));
+}
 
 may_t
 may_collect (may_t a, may_t x)
 {
+  collect_t r;
+  may_size_t i, n;
+
+  MAY_ASSERT (MAY_EVAL_P (a));
   MAY_LOG_FUNC (("a='%Y', x='%Y'", a, x));
 
+  if (collect_independent_p (a, x))
+    return a;
+
   may_mark();
 
-  /* Expand */
-  a = may_expand (a);
-
-  /* Collect */
-  may_iterator_t it1, it2;
-  may_t num, c, b, pseudo_num, pseudo_key, e2, b2;
-  may_bintree_t t = NULL;
-  for (num = may_sum_iterator_init (it1, a) ;
-       may_sum_iterator_end (&c, &b, it1);
-       may_sum_iterator_next (it1) ) {
-    pseudo_num = c;
-    pseudo_key = may_set_ui (1);
-    for (may_product_iterator_init (it2, b);
-         may_product_iterator_end (&e2, &b2, it2) ;
-         may_product_iterator_next (it2) ) {
-      if ((MAY_TYPE (x) == MAY_LIST_T ? may_independent_vp : may_identical) (b2, x) == 0)
-        pseudo_key = may_mulinc_c (pseudo_key, may_product_iterator_ref (it2));
-      else
-        pseudo_num = may_mulinc_c (pseudo_num, may_product_iterator_ref (it2));
-    }
-    t = may_genbintree_insert (t, may_eval (pseudo_num), may_eval (pseudo_key));
-  }
-  a = may_genbintree_get_sum (num, t);
+  collect_init (&r);
+  collect_recur (&r, a, x, MAY_ONE, MAY_ONE);
+
+  n = collect_size (&r);
+  may_t tab[n];
+  for (i = 0; i < n; i++)
+    tab[i] = may_mul_c (collect_coef (&r, i), may_hset_at (r.key, i));
+  a = may_add_vc (n, tab);
 
   return may_keep (may_eval (a));
 }
@@ -0,0 +1,129 @@
+/* This file is part of the MAYLIB libray.
+   Copyright 2007-2018 Patrick Pelissier
+
+This Library is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This Library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with th Library; see the file COPYING.LESSER.txt.
+If not, write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston,
+MA 02110-1301, USA. */
+
+#include "may-impl.h"
+
+/* Composition f(g) of the univariate polynomial f given by the dense
+   array of its coefficients.
+   Below MAY_COMPOSE_THRESHOLD coefficients, the Horner scheme is used.
+   Otherwise f is split into f = f0 + x^m * f1 with m the greatest power
+   of 2 below its size, and f(g) = f0(g) + g^m * f1(g) where the powers
+   g^(2^k) are computed once.
+   If order is not NULL, the result is truncated modulo x^order
+   and is computed as the sum of the terms of the powers of g instead
+   (See series_compo) */
+
+static may_t
+compose_horner (unsigned long n, may_t tab[n], may_t g)
+{
+  may_t r = may_expand (may_eval (tab[n-1]));
+  for (unsigned long i = n-1; i-- > 0; ) {
+    MAY_BUDGET_CHECK ();
+    r = may_expand (may_eval (may_add_c (may_mul_c (r, g), tab[i])));
+  }
+  return r;
+}
+
+/* Sum of the terms tab[i]*g^i mod x^order: the valuations of the powers
+   of g increase (g has a positive valuation for a series), so that they
+   are computed with less terms than the Horner scheme */
+static may_t
+compose_powers (unsigned long n, may_t tab[n], may_t g,
+                may_t x, may_t order)
+{
+  MAY_RECORD ();
+  may_t *term = may_alloc (n * sizeof *term);
+  may_t rp = MAY_ONE;
+  term[0] = tab[0];
+  for (unsigned long i = 1; i < n ; i++) {
+    MAY_BUDGET_CHECK ();
+    rp = may_mul (rp, g);
+    may_div_qr_xexp (NULL, &rp, rp, x, order);
+    if (may_zero_p (rp)) {
+      n = i;
+      break;
+    }
+    term[i] = may_mul_c (tab[i], rp);
+  }
+  MAY_RET (may_expand (may_eval (may_add_vc (n, term))));
+}
+
+/* pw[k] = g^(2^k) */
+static may_t
+compose_rec (unsigned long n, may_t tab[n], may_t g, const may_t pw[])
+{
+  unsigned long m, k;
+  may_t r0, r1;
+
+  if (n <= MAY_COMPOSE_THRESHOLD)
+    return compose_horner (n, tab, g);
+
+  MAY_RECORD ();
+  for (k = 0, m = 1; 2 * m < n; k++, m *= 2);
+  r0 = compose_rec (m, tab, g, pw);
+  r1 = compose_rec (n - m, tab + m, g, pw);
+  r1 = may_expand (may_mul (r1, pw[k]));
+  MAY_RET (may_expand (may_add (r0, r1)));
+}
+
+/* Return the expanded polynomial sum(tab[i]*g^i, i=0..n-1)
+   (mod x^order if order is not NULL). The coefficients of tab
+   must not depend on x */
+may_t
+may_compose_upol (unsigned long n, may_t tab[], may_t g,
+                  may_t x, may_t order)
+{
+  unsigned long m, k;
+
+  if (n == 0)
+    return MAY_ZERO;
+  g = may_expand (g);
+  if (order != NULL)
+    return compose_powers (n, tab, g, x, order);
+  if (n <= MAY_COMPOSE_THRESHOLD)
+    return compose_horner (n, tab, g);
+
+  MAY_RECORD ();
+  /* Precompute the powers g^(2^k) for 2^k < n */
+  for (k = 0, m = 1; 2 * m < n; k++, m *= 2);
+  may_t pw[k+1];
+  pw[0] = g;
+  for (unsigned long i = 1; i <= k; i++)
+    pw[i] = may_expand (may_mul (pw[i-1], pw[i-1]));
+  MAY_RET (compose_rec (n, tab, g, pw));
+}
+
+may_t
+may_compose (may_t f, may_t g, may_t x)
+{
+  unsigned long n;
+  may_t *tab;
+
+  MAY_LOG_FUNC (("f='%Y' g='%Y' x='%Y'", f, g, x));
+  MAY_ASSERT (MAY_EVAL_P (f) && MAY_EVAL_P (g));
+
+  may_mark ();
+  f = may_expand (f);
+  if (may_zero_fastp (f))
+    return may_keep (MAY_ZERO);
+  if (MAY_TYPE (x) != MAY_STRING_T
+      || !may_upol2array (&n, &tab, f, x, true))
+    return may_keep (NULL);
+  return may_keep (may_compose_upol (n, tab, g, x, NULL));
+}
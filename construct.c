@@ -739,7 +739,7 @@ may_func_domain_c (const char name[], may_t x, may_domain_e domain)
   MAY_ASSERT (start >= numberof (FuncTab) || strcmp (name, FuncTab[start].name) != 0);
 
   z = MAY_NODE_C (MAY_FUNC_T, 2);
-  MAY_SET_AT (z, 0, MAY_STRING_C (name, domain));
+  MAY_SET_AT (z, 0, may_symbol_intern (name, domain));
   MAY_SET_AT (z, 1, x);
   return z;
 }
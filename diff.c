@@ -285,3 +285,354 @@ may_eval_diff (may_t x)
 
   return y;
 }
+
+/* Gradient and Jacobian.
+   The nodes of the expressions are numbered once in a hash set, children
+   first, and each distinct node gets its local partial derivatives with
+   respect to its arguments (computed once, and shared by all the
+   outputs and all the variables).
+   The derivatives are then accumulated either forward (the vector of the
+   partials of each node w.r.t. all the variables), or backward (the
+   adjoint of each node for one output) if there are fewer outputs than
+   variables.
+   Nodes which are not decomposed (functions, diff, extensions, ...)
+   are differentiated with may_diff_recur for each variable. */
+
+typedef struct {
+  may_t  *local;  /* Local partials w.r.t. each argument (or NULL) */
+  may_t  *fwd;    /* Forward mode: partials w.r.t. each variable */
+  may_t   adj;    /* Reverse mode: adjoint */
+  int     dep;    /* Depend on one of the variables? */
+} grad_node_t;
+
+typedef struct {
+  may_hset_t   node;      /* All nodes, the children before their parent */
+  grad_node_t *info;      /* Data of each node */
+  may_size_t   alloc;
+  may_hset_t   var;       /* The variables */
+  unsigned long n;        /* Number of variables */
+} grad_t;
+
+/* Return true if x is decomposed w.r.t. its arguments */
+static int
+grad_decompose_p (may_t x)
+{
+  switch (MAY_TYPE (x)) {
+  case MAY_SUM_T:
+  case MAY_PRODUCT_T:
+  case MAY_FACTOR_T:
+  case MAY_POW_T:
+  case MAY_EXP_T:
+  case MAY_LOG_T:
+  case MAY_ABS_T:
+  case MAY_SIN_T:
+  case MAY_COS_T:
+  case MAY_TAN_T:
+  case MAY_ASIN_T:
+  case MAY_ACOS_T:
+  case MAY_ATAN_T:
+  case MAY_SINH_T:
+  case MAY_COSH_T:
+  case MAY_TANH_T:
+  case MAY_ASINH_T:
+  case MAY_ACOSH_T:
+  case MAY_ATANH_T:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/* Number the nodes of x (and its subexpressions) in g.
+   Return the index of x */
+static may_size_t
+grad_visit (grad_t *g, may_t x)
+{
+  may_size_t i, j, n;
+  int dep;
+
+  if (may_hset_find (&i, g->node, x))
+    return i;
+
+  if (MAY_TYPE (x) == MAY_STRING_T)
+    dep = may_hset_find (&j, g->var, x);
+  else if (MAY_NUM_P (x))
+    dep = 0;
+  else if (grad_decompose_p (x)) {
+    dep = 0;
+    n = MAY_NODE_SIZE (x);
+    for (j = 0; j < n; j++) {
+      i = grad_visit (g, MAY_AT (x, j));
+      dep |= g->info[i].dep;
+    }
+  } else {
+    dep = 0;
+    for (j = 0; j < g->n && dep == 0; j++)
+      dep = !may_independent_p (x, may_hset_at (g->var, j));
+  }
+
+  i = may_hset_push_back (g->node, x);
+  if (i >= g->alloc) {
+    may_size_t alloc = 2 * g->alloc + 16;
+    g->info = may_realloc (g->info, g->alloc * sizeof (grad_node_t),
+                           alloc * sizeof (grad_node_t));
+    g->alloc = alloc;
+  }
+  g->info[i].local = NULL;
+  g->info[i].fwd = NULL;
+  g->info[i].adj = NULL;
+  g->info[i].dep = dep;
+  return i;
+}
+
+/* Return the derivative of the decomposed node x w.r.t. its argument j */
+static may_t
+grad_local (may_t x, may_size_t j)
+{
+  may_t u = MAY_AT (x, 0), y;
+  may_size_t i, n;
+
+  switch (MAY_TYPE (x)) {
+  case MAY_SUM_T:
+    return MAY_ONE;
+  case MAY_FACTOR_T:
+    return u;
+  case MAY_PRODUCT_T:
+    n = MAY_NODE_SIZE (x);
+    if (n == 2)
+      return MAY_AT (x, 1-j);
+    y = MAY_NODE_C (MAY_PRODUCT_T, n-1);
+    for (i = 0; i < n-1; i++)
+      MAY_SET_AT (y, i, MAY_AT (x, i < j ? i : i+1));
+    return y;
+  case MAY_POW_T:
+    /* u^v --> v*u^(v-1) and u^v*log(u) */
+    if (j == 0)
+      return may_mul_c (MAY_AT (x, 1),
+                        may_pow_c (u, may_sub_c (MAY_AT (x, 1), MAY_ONE)));
+    return may_mul_c (x, may_log_c (u));
+  case MAY_EXP_T:
+    return x;
+  case MAY_LOG_T:
+    return may_div_c (MAY_ONE, u);
+  case MAY_ABS_T:
+    return may_sign_c (u);
+  case MAY_SIN_T:
+    return may_cos_c (u);
+  case MAY_COS_T:
+    return may_neg_c (may_sin_c (u));
+  case MAY_TAN_T:
+    return may_add_c (MAY_ONE, may_sqr_c (x));
+  case MAY_ASIN_T:
+    return may_div_c (MAY_ONE, may_sqrt_c (may_sub_c (MAY_ONE, may_sqr_c (u))));
+  case MAY_ACOS_T:
+    return may_div_c (MAY_N_ONE, may_sqrt_c (may_sub_c (MAY_ONE, may_sqr_c (u))));
+  case MAY_ATAN_T:
+    return may_div_c (MAY_ONE, may_add_c (MAY_ONE, may_sqr_c (u)));
+  case MAY_SINH_T:
+    return may_cosh_c (u);
+  case MAY_COSH_T:
+    return may_sinh_c (u);
+  case MAY_TANH_T:
+    return may_sub_c (MAY_ONE, may_sqr_c (x));
+  case MAY_ASINH_T:
+    return may_div_c (MAY_ONE, may_sqrt_c (may_add_c (MAY_ONE, may_sqr_c (u))));
+  case MAY_ACOSH_T:
+    return may_div_c (MAY_ONE,
+                      may_mul_c (may_sqrt_c (may_add_c (u, MAY_N_ONE)),
+                                 may_sqrt_c (may_add_c (u, MAY_ONE))));
+  case MAY_ATANH_T:
+    return may_div_c (MAY_ONE, may_sub_c (MAY_ONE, may_sqr_c (u)));
+  default:
+    MAY_ASSERT (0);
+    return NULL;
+  }
+}
+
+/* Return the (evaluated) local partials of the i-th node */
+static may_t *
+grad_get_local (grad_t *g, may_size_t i)
+{
+  may_t x = may_hset_at (g->node, i);
+  may_size_t j, k, n = MAY_NODE_SIZE (x);
+
+  if (g->info[i].local == NULL) {
+    may_t *local = may_alloc (n * sizeof (may_t));
+    for (j = 0; j < n; j++) {
+      may_hset_find (&k, g->node, MAY_AT (x, j));
+      local[j] = g->info[k].dep ? may_eval (grad_local (x, j)) : MAY_ZERO;
+    }
+    g->info[i].local = local;
+  }
+  return g->info[i].local;
+}
+
+/* Return the evaluated sum of the n first terms of tab */
+static may_t
+grad_sum (unsigned long n, may_t *tab)
+{
+  return n == 0 ? MAY_ZERO : n == 1 ? may_eval (tab[0])
+    : may_eval (may_add_vc (n, tab));
+}
+
+/* Forward mode: compute the partials of all the nodes up to the i-th */
+static void
+grad_forward (grad_t *g, may_size_t last)
+{
+  may_size_t i, j, k, n;
+  unsigned long v, m;
+
+  for (i = 0; i <= last; i++) {
+    may_t x = may_hset_at (g->node, i);
+    may_t *fwd;
+
+    if (g->info[i].fwd != NULL || !g->info[i].dep)
+      continue;
+    fwd = may_alloc (g->n * sizeof (may_t));
+    if (MAY_TYPE (x) == MAY_STRING_T) {
+      may_hset_find (&k, g->var, x);
+      for (v = 0; v < g->n; v++)
+        fwd[v] = v == k ? MAY_ONE : MAY_ZERO;
+    } else if (grad_decompose_p (x)) {
+      may_t *local = grad_get_local (g, i);
+      n = MAY_NODE_SIZE (x);
+      may_t tab[n];
+      for (v = 0; v < g->n; v++) {
+        for (j = 0, m = 0; j < n; j++) {
+          may_hset_find (&k, g->node, MAY_AT (x, j));
+          if (g->info[k].dep && !may_zero_fastp (g->info[k].fwd[v]))
+            tab[m++] = may_mul_c (local[j], g->info[k].fwd[v]);
+        }
+        fwd[v] = grad_sum (m, tab);
+      }
+    } else {
+      for (v = 0; v < g->n; v++)
+        fwd[v] = may_eval (may_diff_recur (x, may_hset_at (g->var, v)));
+    }
+    g->info[i].fwd = fwd;
+  }
+}
+
+/* Reverse mode: set grad[] to the partials of the i-th node */
+static void
+grad_reverse (grad_t *g, may_size_t root, may_t *grad)
+{
+  may_size_t i, j, k, n;
+  unsigned long v;
+
+  for (v = 0; v < g->n; v++)
+    grad[v] = MAY_ZERO;
+  for (i = 0; i <= root; i++)
+    g->info[i].adj = NULL;
+  g->info[root].adj = MAY_ONE;
+
+  for (i = root + 1; i-- > 0; ) {
+    may_t x = may_hset_at (g->node, i);
+    may_t adj = g->info[i].adj;
+
+    if (adj == NULL || !g->info[i].dep)
+      continue;
+    adj = may_eval (adj);
+    if (may_zero_fastp (adj))
+      continue;
+    if (MAY_TYPE (x) == MAY_STRING_T) {
+      may_hset_find (&k, g->var, x);
+      grad[k] = may_add_c (grad[k], adj);
+    } else if (grad_decompose_p (x)) {
+      may_t *local = grad_get_local (g, i);
+      n = MAY_NODE_SIZE (x);
+      for (j = 0; j < n; j++) {
+        may_hset_find (&k, g->node, MAY_AT (x, j));
+        if (!g->info[k].dep)
+          continue;
+        may_t t = may_mul_c (adj, local[j]);
+        g->info[k].adj = g->info[k].adj == NULL ? t
+          : may_add_c (g->info[k].adj, t);
+      }
+    } else {
+      for (v = 0; v < g->n; v++)
+        grad[v] = may_add_c (grad[v],
+                             may_mul_c (adj,
+                                        may_diff_recur (x, may_hset_at (g->var, v))));
+    }
+  }
+  for (v = 0; v < g->n; v++)
+    grad[v] = may_eval (grad[v]);
+}
+
+static void
+grad_init (grad_t *g, unsigned long n, const may_t var[])
+{
+  unsigned long i;
+
+  may_hset_init (g->node, 0);
+  may_hset_init (g->var, n);
+  g->info = NULL;
+  g->alloc = 0;
+  g->n = n;
+  for (i = 0; i < n; i++) {
+    MAY_ASSERT (MAY_TYPE (var[i]) == MAY_STRING_T);
+    may_hset_push_back (g->var, var[i]);
+  }
+  /* Duplicate variables are not supported */
+  MAY_ASSERT (may_hset_get_size (g->var) == n);
+}
+
+may_t
+may_jacobian (unsigned long m, const may_t f[], unsigned long n, const may_t var[])
+{
+  grad_t g;
+  may_t row[m], grad[n];
+  may_size_t root[m];
+  unsigned long i, v;
+
+  MAY_LOG_FUNC (("m=%lu n=%lu", m, n));
+
+  may_mark ();
+  grad_init (&g, n, var);
+  for (i = 0; i < m; i++) {
+    MAY_ASSERT (MAY_EVAL_P (f[i]));
+    root[i] = grad_visit (&g, f[i]);
+  }
+
+  for (i = 0; i < m; i++) {
+    if (!g.info[root[i]].dep) {
+      for (v = 0; v < n; v++)
+        grad[v] = MAY_ZERO;
+    } else if (m < n) {
+      /* Fewer outputs than variables: reverse mode */
+      grad_reverse (&g, root[i], grad);
+    } else {
+      grad_forward (&g, root[i]);
+      for (v = 0; v < n; v++)
+        grad[v] = g.info[root[i]].fwd[v];
+    }
+    row[i] = may_list_vc (n, grad);
+  }
+  return may_keep (may_eval (may_list_vc (m, row)));
+}
+
+may_t
+may_gradient (may_t f, unsigned long n, const may_t var[])
+{
+  grad_t g;
+  may_t grad[n];
+  may_size_t root;
+
+  MAY_ASSERT (MAY_EVAL_P (f));
+  MAY_LOG_FUNC (("f='%Y' n=%lu", f, n));
+
+  may_mark ();
+  grad_init (&g, n, var);
+  root = grad_visit (&g, f);
+  if (!g.info[root].dep) {
+    for (unsigned long v = 0; v < n; v++)
+      grad[v] = MAY_ZERO;
+  } else if (n > 1)
+    grad_reverse (&g, root, grad);
+  else {
+    grad_forward (&g, root);
+    grad[0] = g.info[root].fwd[0];
+  }
+  return may_keep (may_eval (may_list_vc (n, grad)));
+}
@@ -121,6 +121,7 @@ may_div_qr_one (may_t *q, may_t *r, may_t a, may_t b, may_t var)
 
   /* Main loop */
   while (d >= db) {
+    MAY_BUDGET_CHECK ();
     if (!MAY_ZERO_P(a_tab[d])) {
       may_t tmp = may_divexact (a_tab[d], cb);
       if (MAY_UNLIKELY (tmp == NULL))
@@ -32,7 +32,8 @@ may_dump_rec (FILE *f, const may_t x, int p)
   size_t l = 0;
 
 #ifndef MAY_WANT_THREAD
-  if ((char*)x < may_g.Heap.base || (char*) x >= may_g.Heap.top) {
+  if (((char*)x < may_g.Heap.base || (char*) x >= may_g.Heap.top)
+      && !may_symbol_interned_p (x)) {
     return fprintf (f, "@@INVALID ADDRESS@@(%p)", x);
   }
 #endif
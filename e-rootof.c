@@ -67,11 +67,64 @@ rootof_eval (may_t l)
   return rootof_c (n, p, x);
 }
 
+/* Set K to the field Q[X]/(X^N-POLY) of the root s.
+   Return 0 if POLY is not a polynomial in X of degree < N
+   with rational coefficients */
+static int
+rootof_field (may_nf_t K, may_t s)
+{
+  may_t n = ROOTOF_N (s);
+  if (!mpz_fits_slong_p (MAY_INT (n)) || mpz_sgn (MAY_INT (n)) <= 0)
+    return 0;
+  unsigned long i, size, degree = mpz_get_ui (MAY_INT (n));
+  may_t *tab;
+  if (!may_upol2array (&size, &tab, ROOTOF_P (s), ROOTOF_X (s), true)
+      || size > degree)
+    return 0;
+  mpq_t *m = may_alloc ((degree + 1) * sizeof *m);
+  for (i = 0; i <= degree; i++) {
+    may_t c = i < size ? tab[i] : MAY_ZERO;
+    mpq_init (m[i]);
+    if (MAY_TYPE (c) == MAY_INT_T)
+      mpq_set_z (m[i], MAY_INT (c));
+    else if (MAY_TYPE (c) == MAY_RAT_T)
+      mpq_set (m[i], MAY_RAT (c));
+    else
+      return 0;
+    mpq_neg (m[i], m[i]);
+  }
+  mpq_set_ui (m[degree], 1, 1);
+  may_nf_init (K, degree, m);
+  return 1;
+}
+
 static may_t
 rootof_pow (may_t base, may_t power)
 {
   if (may_ext_p (base) == may_rootof_ext
       && may_get_name (power) == may_integer_name) {
+    /* Reduce the power in the number field of the root:
+       base^power = (X^power mod (X^N-POLY)) (X=base).
+       Below 2*N, a single step of the division is enough */
+    if ((mpz_sgn (MAY_INT (power)) < 0
+         || may_num_cmp (power, may_mul (MAY_TWO, ROOTOF_N (base))) >= 0)
+        && mpz_fits_slong_p (MAY_INT (power))) {
+      may_nf_t K;
+      MAY_RECORD ();
+      if (rootof_field (K, base)) {
+        long e = mpz_get_si (MAY_INT (power));
+        mpq_t *x = may_nf_new (K);
+        may_nf_set_upol (K, x, ROOTOF_X (base), ROOTOF_X (base));
+        if (e > 0 || may_nf_inv (K, x, x)) {
+          /* -e overflows for LONG_MIN, not its unsigned negation */
+          may_nf_pow_ui (K, x, x, e > 0 ? (unsigned long) e
+                         : - (unsigned long) e);
+          MAY_RET (may_nf_get_upol (K, x, base));
+        }
+      }
+      MAY_CLEANUP ();
+    }
+    /* Otherwise, use the remainder of the division by X^N-POLY */
     if (may_num_cmp (power, ROOTOF_N (base)) >= 0) {
       may_t num = may_pow (ROOTOF_X (base), power);
       may_t pol = may_sub(may_pow(ROOTOF_X (base), ROOTOF_N (base)),
@@ -85,7 +138,6 @@ rootof_pow (may_t base, may_t power)
   return may_hold (may_pow_c (base, power));
 }
 
-
 static const may_extdef_t rootof_cb = {
   .name = "ROOTOF",
   .priority = 10,
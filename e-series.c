@@ -194,6 +194,7 @@ series_mul (unsigned long start, unsigned long end, may_pair_t *tab)
   may_t n = may_set_zz (n1);
 
   /* Second pass: compute it */
+  MAY_BUDGET_CHECK ();
   may_t expr = may_eval (may_mulpow_vc (end, temp));
   may_div_qr_xexp (NULL, &expr, expr, x, n);
   tab[0].first  = MAY_ONE;
@@ -207,7 +208,6 @@ series_mul (unsigned long start, unsigned long end, may_pair_t *tab)
    ldeg1 = Valuation of serie1 without taking into account the constant term >=1 (usually 1 or 2)
    serie1 = an array of n elements defining the terms of the serie
    serie2 = the serie
-   WARNING: serie1 storage is reuse and is destroyed.
    TODO: Add a flag for optimizing the case where only one per two element of serie1
    it not null (<= Use a precomputed serie2*serie2)
  */
@@ -237,18 +237,8 @@ series_compo (may_size_t n, may_size_t ldeg1, may_t serie1[n], may_series_t seri
   may_t order = may_set_zz (n1);
 
   /* Compute the composition while keeping 'order' terms maximum */
-  may_t rp = may_set_ui (1);
-  for (may_size_t i = 1; i < n ; i++) {
-    rp = may_mul (rp, SERIES_DL (serie2));
-    may_div_qr_xexp (NULL, &rp, rp, x, order);
-    if (may_zero_p (rp)) {
-      n = i;
-      break;
-    }
-    serie1[i] = may_mulinc_c (serie1[i], rp);
-  }
-  rp = may_eval (may_add_vc (n, serie1));
-  MAY_RET (series_c (may_expand (rp), x, order));
+  may_t rp = may_compose_upol (n, serie1, SERIES_DL (serie2), x, order);
+  MAY_RET (series_c (rp, x, order));
 }
 
 /* Compute exp(series) */
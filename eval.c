@@ -1032,6 +1032,7 @@ may_eval_sum (may_t x)
   y = x;
   MAY_ASSERT (nsymb >= 2);
   for (i = 0; i < nsymb; i++) {
+    MAY_BUDGET_CHECK ();
     may_t arg = may_eval (MAY_AT (x, i));
     may_type_t targ = MAY_TYPE (arg);
 
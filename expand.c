@@ -19,7 +19,7 @@ MA 02110-1301, USA. */
 
 #include "may-impl.h"
 
-#define MAY_EXPAND_BASECASE_THRESHOLD 100
+#define MAY_EXPAND_TERMHASH_MAX_INIT (1UL<<16)
 
 /* Returns the size of an expanded multinom (sum(a[i],i=1..n)^e)*/
 static MAY_REGPARM unsigned long
@@ -74,6 +74,7 @@ expand_mul_basecase (const may_t arg[], may_size_t n, may_size_t final)
 
   y = MAY_NODE_C (MAY_SUM_T, final);
   for (i = 0 ; MAY_LIKELY (i < final); i++) {
+    MAY_BUDGET_CHECK ();
     MAY_RECORD ();
     may_size_t cumul = i;
     may_t z = MAY_NODE_C (MAY_PRODUCT_T, n);
@@ -110,14 +111,14 @@ expand_mul_basecase (const may_t arg[], may_size_t n, may_size_t final)
   return y;
 }
 
-/* Compute the expanded multinomial of 2 sums using a bintree
+/* Compute the expanded multinomial of 2 sums using a hash table
    to accumulate the result. Faster when there is overlap but sparse. */
 static may_t
 expand_mul_two_sum (may_t a, may_t b)
 {
   may_size_t i, j, j_start, na, nb;
   may_t num, sumnum;
-  may_bintree_t tree = NULL;
+  may_termhash_t terms;
 
   MAY_ASSERT (MAY_TYPE (a) == MAY_SUM_T);
   MAY_ASSERT (MAY_TYPE (b) == MAY_SUM_T);
@@ -127,6 +128,10 @@ expand_mul_two_sum (may_t a, may_t b)
   na = MAY_NODE_SIZE(a);
   nb = MAY_NODE_SIZE(b);
 
+  /* There are at most na*nb different terms */
+  may_termhash_init (terms, (na > MAY_EXPAND_TERMHASH_MAX_INIT / nb)
+                     ? MAY_EXPAND_TERMHASH_MAX_INIT : na*nb);
+
   /* num is an accumulator used to compute everything */
   num = MAY_DUMMY;
   /* sumnum is the pure numerical term of the expanded product */
@@ -145,9 +150,9 @@ expand_mul_two_sum (may_t a, may_t b)
       may_t y = MAY_AT (b, j);
       if (MAY_TYPE (y) == MAY_FACTOR_T) {
         num = may_num_mul (num, a_num, MAY_AT (y, 0));
-        tree = may_bintree_insert (tree, num, MAY_AT (y, 1));
+        may_termhash_add (terms, num, MAY_AT (y, 1));
       } else {
-        tree = may_bintree_insert (tree, a_num, y);
+        may_termhash_add (terms, a_num, y);
       }
     }
     i = 1;
@@ -159,9 +164,9 @@ expand_mul_two_sum (may_t a, may_t b)
       may_t y = MAY_AT (a, j);
       if (MAY_TYPE (y) == MAY_FACTOR_T) {
         num = may_num_mul (num, b_num, MAY_AT (y, 0));
-        tree = may_bintree_insert (tree, num, MAY_AT (y, 1));
+        may_termhash_add (terms, num, MAY_AT (y, 1));
       } else {
-        tree = may_bintree_insert (tree, b_num, y);
+        may_termhash_add (terms, b_num, y);
       }
     }
     j_start = 1;
@@ -178,6 +183,8 @@ expand_mul_two_sum (may_t a, may_t b)
       may_size_t pas, pbs, pzs;
       int reexpand_product = 0;
 
+      MAY_BUDGET_CHECK ();
+
       aa = MAY_AT (a, i);
       bb = MAY_AT (b, j);
       MAY_ASSERT (!MAY_PURENUM_P (aa));
@@ -261,9 +268,11 @@ expand_mul_two_sum (may_t a, may_t b)
           may_t dest = may_num_add (MAY_DUMMY, expo_a, expo_b);
           if (MAY_UNLIKELY (may_num_zero_p (dest)))
             /* Nothing to do */ ;
-          else if (MAY_UNLIKELY (may_num_one_p (dest)))
+          else if (MAY_UNLIKELY (may_num_one_p (dest))) {
+            /* (1-x)^(1/3)*(1-x)^(2/3) --> 1-x --> To further expand */
+            reexpand_product |= (MAY_TYPE (base_a) == MAY_SUM_T);
             MAY_SET_AT (z, pzs++, base_a);
-          else {
+          } else {
             /* FIXME: inline it ? */
             may_g.frame.intmod = NULL;
             expo_a = may_num_simplify (dest);
@@ -273,7 +282,7 @@ expand_mul_two_sum (may_t a, may_t b)
             if (MAY_UNLIKELY (MAY_TYPE (base_a) == MAY_SUM_T
                               && MAY_TYPE (expo_a) == MAY_INT_T)) {
               /* To reperform an expand before adding the term
-                 into the bintree -*/
+                 into the table -*/
               reexpand_product = 1;
             }
             may_t w = MAY_NODE_C (MAY_POW_T, 2);
@@ -319,14 +328,14 @@ expand_mul_two_sum (may_t a, may_t b)
           for(num2 = may_sum_iterator_init (it, z);
               may_sum_iterator_end (&num3, &z, it) ;
               may_sum_iterator_next(it)) {
-            /* Insert (num,z) into the tree */
-            tree = may_bintree_insert (tree, num3, z);
+            /* Insert (num,z) into the table */
+            may_termhash_add (terms, num3, z);
           }
           sumnum = may_num_add (sumnum, sumnum, num2);
         } else {
           void *top_position = may_g.Heap.top;
-          /* Insert (num,z) into the tree */
-          tree = may_bintree_insert (tree, num, z);
+          /* Insert (num,z) into the table */
+          may_termhash_add (terms, num, z);
           /* If no allocation were done, we can clean everything,
              since it has succesfully reused previous memory */
           if (top_position == may_g.Heap.top)
@@ -341,7 +350,7 @@ expand_mul_two_sum (may_t a, may_t b)
     } /* for j */
   /* Compute constant term */
   sumnum = may_num_simplify (sumnum);
-  sumnum = may_bintree_get_sum (sumnum, tree);
+  sumnum = may_termhash_get_sum (sumnum, terms);
   MAY_ASSERT (MAY_EVAL_P (sumnum));
   MAY_ASSERT (may_recompute_hash (sumnum) == MAY_HASH (sumnum));
   return sumnum;
@@ -481,7 +490,10 @@ expand_univariate_poly (may_t a, may_t b, may_t v)
     MAY_SET_AT (y, i, term);
     mpz_fdiv_q_2exp (za, za, n);
   }
-  MAY_RET_EVAL (y);
+  /* The result may be multiplied again by Karatsuba */
+  y = may_eval (y);
+  MAY_SET_FLAG (y, MAY_EXPAND_F);
+  MAY_RET (y);
 }
 
 /* Return TRUE if there is only Pure INTEGER inside an univariate polynomial.
@@ -566,6 +578,8 @@ convert_poly_over_Q_to_Z (may_t *n, may_t *d, may_t p)
     n1 = may_addinc_c (n1, may_mul_c (d1, may_sum_iterator_ref (it)));
   n1 = may_addinc_c (n1, may_mul_c (d1, num));
   n1 = may_eval (n1);
+  /* An integer multiple of an expanded polynomial is still expanded */
+  MAY_SET_FLAG (n1, MAY_EXPAND_F);
 
   MAY_COMPACT_2 (n1, d1);
   *n = n1;
@@ -674,7 +688,8 @@ expand_mul_heavy (const may_t arg[], may_size_t n)
       /* Univariate case: try Kronecker tip */
       if (MAY_NODE_SIZE(var) == 1
           && tab[i].pureint && tab[i+1].pureint
-          && MAY_TYPE (MAY_AT (var, 0)) == MAY_STRING_T)
+          && MAY_TYPE (MAY_AT (var, 0)) == MAY_STRING_T
+          && MIN (tab[i].size, tab[i+1].size) >= MAY_EXPAND_KRONECKER_THRESHOLD)
         result = expand_univariate_poly (tab[i].arg, tab[i+1].arg, MAY_AT (var, 0));
       /* If failed to multiply them using Kronecker tip for univariate, use Karatsuba */
       if (MAY_UNLIKELY (result == NULL))
@@ -750,8 +765,7 @@ test_algebra_dependency_p (may_t sum)
             && MAY_TYPE (MAY_AT (term, 1)) == MAY_RAT_T))
       s +=1;
   }
-  /* FIXME: Need test to compute threshold*/
-  return 4*(n-s) < n;
+  return MAY_EXPAND_ALGEBRAIC_RATIO*(n-s) < n;
 }
 
 /* Compute x^n using 'fast exponent' trick.
@@ -792,6 +806,235 @@ expand_pow_binary (may_t x, long n)
   return r;
 }
 
+/* Extract the coefficients of 'a', an univariate polynomial over Q
+   (test_pureint (a) != 0), as integers over a common denominator 'den'.
+   Return the coefficients shifted by the valuation '*val' (so that
+   the first one is not zero), their number in '*deg' + 1
+   and the variable in '*var', or NULL if 'a' is not univariate. */
+static mpz_t *
+pow_get_coeff (unsigned long *val, unsigned long *deg, may_t *var,
+               mpz_ptr den, may_t a)
+{
+  may_size_t i, n = MAY_NODE_SIZE (a);
+  unsigned long k, lo, hi;
+  may_t v = NULL;
+  mpz_t *c;
+
+  MAY_ASSERT (MAY_TYPE (a) == MAY_SUM_T);
+  /* Get the variable, the valuation, the degree and the denominator */
+  mpz_set_ui (den, 1);
+  lo = ULONG_MAX;
+  hi = 0;
+  for (i = 0; i < n; i++) {
+    may_t term = MAY_AT (a, i), coeff = MAY_ONE;
+    k = 0;
+    if (MAY_PURENUM_P (term))
+      coeff = term;
+    else {
+      if (MAY_TYPE (term) == MAY_FACTOR_T) {
+        coeff = MAY_AT (term, 0);
+        term = MAY_AT (term, 1);
+      }
+      k = 1;
+      if (MAY_TYPE (term) == MAY_POW_T) {
+        k = mpz_get_ui (MAY_INT (MAY_AT (term, 1)));
+        term = MAY_AT (term, 0);
+      }
+      if (v == NULL)
+        v = term;
+      else if (may_identical (v, term) != 0)
+        return NULL;
+    }
+    if (MAY_TYPE (coeff) == MAY_RAT_T)
+      mpz_lcm (den, den, mpq_denref (MAY_RAT (coeff)));
+    lo = MIN (lo, k);
+    hi = MAX (hi, k);
+  }
+  MAY_ASSERT (v != NULL && hi > lo);
+
+  /* Fill the coefficients */
+  c = may_alloc ((hi - lo + 1) * sizeof (mpz_t));
+  for (k = 0; k <= hi - lo; k++)
+    mpz_init (c[k]);
+  for (i = 0; i < n; i++) {
+    may_t term = MAY_AT (a, i), coeff = MAY_ONE;
+    k = 0;
+    if (MAY_PURENUM_P (term))
+      coeff = term;
+    else {
+      if (MAY_TYPE (term) == MAY_FACTOR_T) {
+        coeff = MAY_AT (term, 0);
+        term = MAY_AT (term, 1);
+      }
+      k = MAY_TYPE (term) == MAY_POW_T
+        ? mpz_get_ui (MAY_INT (MAY_AT (term, 1))) : 1;
+    }
+    mpz_ptr z = c[k - lo];
+    if (MAY_TYPE (coeff) == MAY_RAT_T) {
+      mpz_divexact (z, den, mpq_denref (MAY_RAT (coeff)));
+      mpz_mul (z, z, mpq_numref (MAY_RAT (coeff)));
+    } else
+      mpz_mul (z, den, MAY_INT (coeff));
+  }
+  *val = lo;
+  *deg = hi - lo;
+  *var = v;
+  return c;
+}
+
+/* Compute the coefficients of P^e in 'c' (which has e*d+1 entries)
+   from the coefficients a[0..d] of P (with a[0] != 0)
+   using the J.C.P. Miller recurrence:
+     c[0] = a[0]^e
+     c[k] = 1/(k*a[0]) * sum(((e+1)*j-k)*a[j]*c[k-j], j=1..min(k,d))
+   Each coefficient costs O(d) products of a small integer by a big one. */
+static void
+pow_miller (mpz_t *c, mpz_t *a, unsigned long d, unsigned long e)
+{
+  unsigned long k, j, m, nz, *idx;
+  mpz_t t;
+
+  MAY_ASSERT (mpz_sgn (a[0]) != 0);
+  /* Only iterate over the non zero coefficients of P */
+  idx = may_alloc (d * sizeof *idx);
+  for (j = 1, nz = 0; j <= d; j++)
+    if (mpz_sgn (a[j]) != 0)
+      idx[nz++] = j;
+
+  mpz_init (t);
+  mpz_pow_ui (c[0], a[0], e);
+  for (k = 1; k <= e*d; k++) {
+    mpz_set_ui (c[k], 0);
+    for (m = 0; m < nz && idx[m] <= k; m++) {
+      j = idx[m];
+      if (mpz_sgn (c[k-j]) == 0)
+        continue;
+      mpz_mul (t, a[j], c[k-j]);
+      /* (e+1)*j-k fits in a long since e and d fit in an unsigned short */
+      long s = (long) ((e+1)*j) - (long) k;
+      if (s >= 0)
+        mpz_addmul_ui (c[k], t, s);
+      else
+        mpz_submul_ui (c[k], t, -s);
+    }
+    if (mpz_sgn (c[k]) != 0) {
+      mpz_divexact_ui (c[k], c[k], k);
+      mpz_divexact (c[k], c[k], a[0]);
+    }
+  }
+}
+
+/* Split 'z' = sum(c[i]*2^(b*i), i=0..n-1) with abs(c[i]) < 2^(b-1)
+   in its n coefficients, using a divide and conquer approach */
+static void
+pow_kronecker_unpack (mpz_t *c, mpz_ptr z, unsigned long n, unsigned long b)
+{
+  if (n == 1) {
+    mpz_swap (c[0], z);
+    return;
+  }
+  unsigned long h = n / 2;
+  mpz_t low;
+  mpz_init (low);
+  mpz_fdiv_r_2exp (low, z, b*h);
+  mpz_fdiv_q_2exp (z, z, b*h);
+  if (mpz_sizeinbase (low, 2) >= b*h) {
+    /* The low part is negative: borrow from the high part */
+    mpz_t t;
+    mpz_init_set_ui (t, 1);
+    mpz_mul_2exp (t, t, b*h);
+    mpz_sub (low, low, t);
+    mpz_add_ui (z, z, 1);
+  }
+  pow_kronecker_unpack (c, low, h, b);
+  pow_kronecker_unpack (c + h, z, n - h, b);
+}
+
+/* Compute the coefficients of P^e in 'c' (which has e*d+1 entries)
+   from the coefficients a[0..d] of P using Kronecker substitution:
+   P is evaluated at 2^b, powered, and the result is split back.
+   It is faster than the recurrence for dense polynomials. */
+static void
+pow_kronecker (mpz_t *c, mpz_t *a, unsigned long d, unsigned long e)
+{
+  unsigned long j, b;
+  mpz_t z;
+
+  /* The coefficients of P^e are bounded by sum(abs(a[j]))^e */
+  mpz_init_set_ui (z, 0);
+  for (j = 0; j <= d; j++)
+    if (mpz_sgn (a[j]) >= 0)
+      mpz_add (z, z, a[j]);
+    else
+      mpz_sub (z, z, a[j]);
+  b = e * mpz_sizeinbase (z, 2) + 1;
+  /* Evaluate at 2^b (Horner), power, and unpack */
+  mpz_set (z, a[d]);
+  for (j = d; j-- > 0; ) {
+    mpz_mul_2exp (z, z, b);
+    mpz_add (z, z, a[j]);
+  }
+  mpz_pow_ui (z, z, e);
+  pow_kronecker_unpack (c, z, e*d+1, b);
+}
+
+/* Compute x^e if x is an univariate polynomial over Q,
+   without building the multinomial expansion.
+   Return NULL if it is not such a polynomial. */
+static may_t
+expand_pow_univariate (may_t x, unsigned long e)
+{
+  unsigned long val, d, k, m, nz;
+  may_t v, inv, y;
+  mpz_t den, *a, *c;
+
+  MAY_ASSERT (MAY_TYPE (x) == MAY_SUM_T);
+  if (test_pureint (x) == 0)
+    return NULL;
+
+  MAY_LOG_FUNC (("%Y^%lu", x, e));
+
+  MAY_RECORD ();
+  mpz_init (den);
+  a = pow_get_coeff (&val, &d, &v, den, x);
+  if (a == NULL) {
+    MAY_CLEANUP ();
+    return NULL;
+  }
+
+  c = may_alloc ((e*d+1) * sizeof (mpz_t));
+  for (k = 0; k <= e*d; k++)
+    mpz_init (c[k]);
+  for (k = 1, nz = 0; k <= d; k++)
+    nz += mpz_sgn (a[k]) != 0;
+  /* The recurrence is linear in the number of terms of x:
+     Kronecker substitution is only a win for large dense polynomials */
+  if (nz <= MAY_EXPAND_POW_MILLER_THRESHOLD || nz * nz <= d)
+    pow_miller (c, a, d, e);
+  else
+    pow_kronecker (c, a, d, e);
+
+  /* Build the result */
+  inv = NULL;
+  if (mpz_cmp_ui (den, 1) != 0) {
+    mpz_pow_ui (den, den, e);
+    inv = may_div_c (MAY_ONE, may_set_z (den));
+  }
+  for (k = 0, m = 0; k <= e*d; k++)
+    m += mpz_sgn (c[k]) != 0;
+  y = MAY_NODE_C (MAY_SUM_T, m);
+  for (k = 0, m = 0; k <= e*d; k++) {
+    if (mpz_sgn (c[k]) == 0)
+      continue;
+    may_t term = may_mul_c (may_set_z (c[k]),
+                            may_pow_c (v, MAY_ULONG_C (k + e*val)));
+    if (inv != NULL)
+      term = may_mul_c (inv, term);
+    MAY_SET_AT (y, m++, term);
+  }
+  MAY_RET_EVAL (y);
+}
+
 static MAY_REGPARM may_t
 may_expand_recur (may_t x)
 {
@@ -881,6 +1124,9 @@ may_expand_recur (may_t x)
               }
             }
             MAY_ASSERT (pos == finalsize);
+            /* Univariate polynomial over Q: (1+3*x+2*x^2)^1000 */
+          } else if ((y = expand_pow_univariate (base, expo)) != NULL) {
+            /* Done by a coefficient recurrence */
             /* Special case: (1+sqrt(5))^1000 */
           } else if (test_algebra_dependency_p (base)) {
             y = expand_pow_binary (base, expo);
@@ -905,6 +1151,7 @@ may_expand_recur (may_t x)
             /* Start Sum */
             while (1) {
 	    begin_loop:
+              MAY_BUDGET_CHECK ();
 	      /* Compute Product( ai! ) */
 	      mpz_set (temp, fact[a[0]]);
 	      for ( i = 1 ; MAY_LIKELY (i < (int) n); i++)
@@ -0,0 +1,193 @@
+/* This file is part of the MAYLIB libray.
+   Copyright 2007-2018 Patrick Pelissier
+
+This Library is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This Library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with th Library; see the file COPYING.LESSER.txt.
+If not, write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston,
+MA 02110-1301, USA. */
+
+#include "may-impl.h"
+
+/* Return the number of entries of the table for n terms:
+   a power of 2 with a load factor of at most 1/2 */
+static MAY_REGPARM may_size_t
+termhash_table_size (may_size_t n)
+{
+  may_size_t s = 16;
+  while (s < 2*n)
+    s <<= 1;
+  return s;
+}
+
+/* The hash of an expression is only 16 bits in the common models,
+   which is far too narrow for a table of millions of terms:
+   widen it with the hashes of its operands and of theirs */
+#define TERMHASH_UP(h, x) ((h) = (h) * UINT64_C (0x100000001B3) ^ MAY_HASH (x))
+static MAY_REGPARM uint64_t
+termhash_hash (may_t key)
+{
+  uint64_t h = MAY_HASH (key);
+  may_size_t i, j, n, m;
+
+  if (MAY_NODE_P (key))
+    for (i = 0, n = MAY_NODE_SIZE(key); i < n; i++) {
+      may_t y = MAY_AT (key, i);
+      TERMHASH_UP (h, y);
+      if (MAY_NODE_P (y))
+        for (j = 0, m = MAY_NODE_SIZE(y); j < m; j++)
+          TERMHASH_UP (h, MAY_AT (y, j));
+    }
+  return h;
+}
+
+/* Return the first entry to probe for a term of hash 'hash':
+   the upper bits of a multiplicative hashing */
+#define TERMHASH_SLOT(h, hash)                                          \
+  ((may_size_t) (((hash) * UINT64_C (0x9E3779B97F4A7C15)) >> (h)->shift))
+
+/* Allocate an empty table of s entries (s being a power of 2) */
+static void
+termhash_alloc (may_termhash_t h, may_size_t s)
+{
+  int bits = 0;
+  while ((1UL << bits) < s)
+    bits++;
+  h->shift = 64 - bits;
+  h->mask = s - 1;
+  h->tab  = may_alloc (s * sizeof *h->tab);
+  memset (h->tab, 0, s * sizeof *h->tab);
+}
+
+/* Double the size of the table and move the terms in it.
+   The previous table is lost in the heap */
+static void
+termhash_grow (may_termhash_t h)
+{
+  may_termhash_entry_t *old = h->tab;
+  may_size_t i, j, s = h->mask + 1;
+
+  MAY_LOG_FUNC (("size=%lu", (unsigned long) h->size));
+
+  termhash_alloc (h, 2*s);
+  for (i = 0; i < s; i++)
+    if (old[i].key != NULL) {
+      for (j = TERMHASH_SLOT (h, old[i].hash);
+           h->tab[j].key != NULL;
+           j = (j+1) & h->mask);
+      h->tab[j] = old[i];
+    }
+}
+
+/* Initialize the accumulator for about n different terms */
+void
+may_termhash_init (may_termhash_t h, may_size_t n)
+{
+  MAY_LOG_FUNC (("n=%lu", (unsigned long) n));
+  h->size = 0;
+  termhash_alloc (h, termhash_table_size (n));
+}
+
+/* Add num*key to the accumulator.
+   The term is found by its hash and checked by may_identical:
+   if it is already in the table, num is added in place to its coefficient */
+void
+may_termhash_add (may_termhash_t h, may_t num, may_t key)
+{
+  uint64_t hash = termhash_hash (key);
+  may_size_t j;
+
+  MAY_ASSERT (MAY_PURENUM_P (num));
+  MAY_ASSERT (MAY_TYPE (key) != MAY_SUM_T && MAY_TYPE (key) != MAY_FACTOR_T);
+  MAY_ASSERT (may_recompute_hash (key) == MAY_HASH (key));
+
+  for (j = TERMHASH_SLOT (h, hash); h->tab[j].key != NULL; j = (j+1) & h->mask)
+    if (h->tab[j].hash == hash && may_identical (h->tab[j].key, key) == 0) {
+      may_t n = h->tab[j].num;
+      h->tab[j].num = may_num_add (n, n, num);
+      return;
+    }
+
+  /* New key: num shall be rewritable, so create a new one */
+  h->tab[j].hash = hash;
+  h->tab[j].num  = may_num_set (MAY_DUMMY, num);
+  h->tab[j].key  = key;
+  if (MAY_UNLIKELY (2 * ++h->size > h->mask + 1))
+    termhash_grow (h);
+}
+
+static int
+termhash_cmp (const void *a, const void *b)
+{
+  const may_termhash_entry_t *pa = a, *pb = b;
+  return may_identical (pa->key, pb->key);
+}
+
+/* Return the sum of num and of all the terms of the accumulator.
+   The terms are moved at the beginning of the table and sorted
+   once in the order of an evaluated sum.
+   The accumulator can't be used after */
+may_t
+may_termhash_get_sum (may_t num, may_termhash_t h)
+{
+  may_termhash_entry_t *tab = h->tab;
+  may_size_t i, n;
+
+  MAY_ASSERT (MAY_PURENUM_P (num) && MAY_EVAL_P (num));
+  MAY_LOG_FUNC (("size=%lu", (unsigned long) h->size));
+
+  /* Pack the terms */
+  for (i = n = 0; n < h->size; i++)
+    if (tab[i].key != NULL)
+      tab[n++] = tab[i];
+  if (MAY_UNLIKELY (n == 0))
+    return num;
+  qsort (tab, n, sizeof *tab, termhash_cmp);
+
+  int not_zero_p = !MAY_ZERO_P (num);
+  may_t z = MAY_NODE_C (MAY_SUM_T, n + not_zero_p);
+  may_t *a = MAY_AT_PTR (z, 0);
+
+  if (not_zero_p)
+    *a++ = num;
+  for (i = 0; i < n; i++) {
+    may_t c = tab[i].num;
+    if (may_num_one_p (c)) {
+      *a++ = tab[i].key;
+    } else if (may_num_zero_p (c)) {
+      /* Nothing to do */
+    } else {
+      /* TODO: Don't use this low level construction.
+         Use may_mul: optimize may_mul construction? */
+      may_t y = MAY_NODE_C (MAY_FACTOR_T, 2);
+      MAY_SET_AT (y, 0, may_num_simplify (c));
+      MAY_ASSERT (MAY_PURENUM_P (MAY_AT (y, 0)));
+      MAY_SET_AT (y, 1, tab[i].key);
+      MAY_CLOSE_C (y, MAY_FLAGS (tab[i].key),
+                   MAY_NEW_HASH2 (MAY_AT (y, 0), MAY_AT (y, 1)));
+      *a++ = y;
+    }
+  }
+
+  /* Due to the potential '0' in the coefficients, fix 'n' */
+  n = a - MAY_AT_PTR (z, 0);
+
+  /* TODO: Too low level construction.
+     Use may_addinc_c instead ? */
+  /* FIXME: hash computation is wrong, no? */
+  MAY_NODE_SIZE(z) = n;
+  MAY_CLOSE_C (z, MAY_EVAL_F|MAY_EXPAND_F,
+               may_node_hash (MAY_AT_PTR (z, 0), n));
+
+  return z;
+}
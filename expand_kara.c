@@ -474,6 +474,7 @@ basecase (may_linked_term_t a2, may_linked_term_t b2, int n)
   may_linked_term_t product = NULL;
 
   while (a2 != NULL) {
+    MAY_BUDGET_CHECK ();
     /* Multiply A2[] by B2 and add it in product */
     /* Try to reuse memory if possible for a but not for b */
     may_linked_term_t *sp;
@@ -560,6 +561,8 @@ karatsuba (may_linked_term_t a, may_linked_term_t b, int i, int n, may_mark_t ma
   may_linked_term_t a1, a2, b1, b2;
   may_linked_term_t  a1pa2,b1pb2,a1pa2fb1pb2,a1fb1,a2fb2;
 
+  MAY_BUDGET_CHECK ();
+
   /* If a or b is too small, use basecase */
   if (size_smaller_than_p (a, may_g.kara.threshold)
       || size_smaller_than_p (b, may_g.kara.threshold))
@@ -609,7 +612,7 @@ may_karatsuba (may_t a, may_t b, may_t varlist)
   /* Define the threshold for which below we call the basecase.
      It is a dynamic threshold and may be increase if the function failed for some
      part of the input */
-  may_g.kara.threshold = 10;
+  may_g.kara.threshold = MAY_KARA_THRESHOLD;
   /* Define the cache used by the base case */
   may_g.kara.tmpnum = MAY_DUMMY;
   /* Define the list of free terms */
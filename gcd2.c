@@ -293,6 +293,7 @@ may_heur_gcd (may_t a, may_t b, may_t x)
   */
   for (int try = 0; try < MAY_MAX_TRY_HEUGCD; try++) {
     may_t temp[2];
+    MAY_BUDGET_CHECK ();
     /* Heuristic GCD needs to compute with very HUGE integer. Remove any limits */
     unsigned long p  = may_kernel_intmaxsize (-1UL);
     /* Compute the exponential tower of the evaluation point */
@@ -432,6 +433,149 @@ check_for_sum_of_product_of_sum_in_tab (unsigned long n, const may_t tab[])
   return 0;
 }
 
+/* Return true if x is a product or an integer power of a sum,
+   ie an expression whose GCD can be computed on its structure */
+static int
+gcd_struct_p (may_t x)
+{
+  return MAY_TYPE (x) == MAY_FACTOR_T || MAY_TYPE (x) == MAY_PRODUCT_T
+    || (MAY_TYPE (x) == MAY_POW_T && MAY_TYPE (MAY_AT (x, 0)) == MAY_SUM_T
+        && MAY_TYPE (MAY_AT (x, 1)) == MAY_INT_T
+        && mpz_sgn (MAY_INT (MAY_AT (x, 1))) > 0
+        && mpz_fits_ulong_p (MAY_INT (MAY_AT (x, 1))));
+}
+
+/* Split x in its factors (including the numerical one) */
+static may_size_t
+gcd_struct_split (may_t **tab, may_t x)
+{
+  may_iterator_t it;
+  may_t num, base, power;
+  may_size_t n = 0;
+
+  num = may_product_iterator_init (it, x);
+  x = MAY_TYPE (x) == MAY_FACTOR_T ? MAY_AT (x, 1) : x;
+  *tab = may_alloc ((MAY_TYPE (x) == MAY_PRODUCT_T ? MAY_NODE_SIZE (x) + 1 : 2)
+                    * sizeof (may_t));
+  if (num != MAY_ONE)
+    (*tab)[n++] = num;
+  for ( ; may_product_iterator_end (&power, &base, it);
+        may_product_iterator_next (it))
+    (*tab)[n++] = may_product_iterator_ref (it);
+  if (n == 0)
+    (*tab)[n++] = num;
+  return n;
+}
+
+/* Return the exponent of x seen as base^exponent,
+   with a positive integer exponent */
+static unsigned long
+gcd_struct_pow (may_t *base, may_t x)
+{
+  if (MAY_TYPE (x) == MAY_POW_T && MAY_TYPE (MAY_AT (x, 1)) == MAY_INT_T
+      && mpz_sgn (MAY_INT (MAY_AT (x, 1))) > 0
+      && mpz_fits_ulong_p (MAY_INT (MAY_AT (x, 1)))) {
+    *base = MAY_AT (x, 0);
+    return mpz_get_ui (MAY_INT (MAY_AT (x, 1)));
+  }
+  *base = x;
+  return 1;
+}
+
+/* Compute the GCD g of a and b working on their product / power structure,
+   and the cofactors a/g and b/g in *ca and *cb.
+   Only the bases of the powers are expanded (by may_gcd).
+   For a product, use gcd(a1*a2,b) = g1*gcd(a2,b/g1) with g1=gcd(a1,b).
+   For powers, gcd(p^n,q^m) is reduced to gcd of the bases:
+         . g = 1
+         . h = gcd(p,q), p = h*p1, q = h*q1
+         . while h != 1
+                if n < m: g=g*h^n, p=p1, q=h, m=m-n (q1^m is coprime with p1)
+                if n > m: g=g*h^m, q=q1, p=h, n=n-m
+                if n = m: g=g*h^n and stop
+                h = gcd (p,q) */
+static may_t
+gcd_struct (may_t *ca, may_t *cb, may_t a, may_t b)
+{
+  may_t *ta, *tb, g, ra, rb, tab[2];
+  may_size_t na, nb, i, j;
+
+  MAY_LOG_FUNC (("a='%Y' b='%Y'", a, b));
+
+  MAY_RECORD ();
+  na = gcd_struct_split (&ta, a);
+  nb = gcd_struct_split (&tb, b);
+
+  if (na == 1 && nb == 1) {
+    may_t p, q, p1, q1, h;
+    unsigned long n = gcd_struct_pow (&p, a);
+    unsigned long m = gcd_struct_pow (&q, b);
+    if (n == 1 && m == 1) {
+      /* Nothing to do on the structure */
+      tab[0] = a;
+      tab[1] = b;
+      g = may_gcd (2, tab);
+      ra = may_divexact (a, g);
+      rb = may_divexact (b, g);
+      MAY_ASSERT (ra != NULL && rb != NULL);
+    } else {
+      int divides = 0;
+      g = ra = rb = MAY_ONE;
+      while (1) {
+        /* If q divided p at the previous step, it likely divides it again:
+           a division is cheaper than a gcd */
+        if (divides && n == 1 && (p1 = may_divexact (p, q)) != NULL) {
+          h = q;
+          q1 = MAY_ONE;
+        } else
+          h = gcd_struct (&p1, &q1, p, q);
+        divides = may_one_p (q1);
+        if (MAY_PURENUM_P (h)) {
+          ra = may_mul_c (ra, may_pow_c (p, may_set_ui (n)));
+          rb = may_mul_c (rb, may_pow_c (q, may_set_ui (m)));
+          break;
+        } else if (n < m) {
+          g = may_mul_c (g, may_pow_c (h, may_set_ui (n)));
+          rb = may_mul_c (rb, may_pow_c (q1, may_set_ui (m)));
+          p = p1;
+          q = h;
+          m -= n;
+        } else if (n > m) {
+          g = may_mul_c (g, may_pow_c (h, may_set_ui (m)));
+          ra = may_mul_c (ra, may_pow_c (p1, may_set_ui (n)));
+          q = q1;
+          p = h;
+          n -= m;
+        } else {
+          g = may_mul_c (g, may_pow_c (h, may_set_ui (n)));
+          ra = may_mul_c (ra, may_pow_c (p1, may_set_ui (n)));
+          rb = may_mul_c (rb, may_pow_c (q1, may_set_ui (m)));
+          break;
+        }
+      }
+    }
+  } else {
+    /* Product: compute the GCD factor by factor,
+       removing each partial GCD from both sides */
+    g = MAY_ONE;
+    for (i = 0; i < na; i++)
+      for (j = 0; j < nb; j++) {
+        may_t h = gcd_struct (&ta[i], &tb[j], ta[i], tb[j]);
+        if (h != MAY_ONE)
+          g = may_mul_c (g, h);
+      }
+    ra = may_mul_vc (na, ta);
+    rb = may_mul_vc (nb, tb);
+  }
+  g = may_eval (g);
+  ra = may_eval (ra);
+  rb = may_eval (rb);
+  may_compact_va (may_record, &g, &ra, &rb, NULL);
+  *ca = ra;
+  *cb = rb;
+  return g;
+}
+
 may_t
 may_gcd (unsigned long n, const may_t tab[])
 {
@@ -543,51 +687,22 @@ may_gcd (unsigned long n, const may_t tab[])
      They may appear due to the previous expansion due to unused variable.
      But they are usually handled quite efficiently by the sr_gcd, no? */
 
-  /* Check if one term of the list is a product,
-     in which case it is usually faster to return the product of the
-     gcd which each terms (and avoids expanding it)
+  /* Check if one term of the list is a product or a power of a sum,
+     in which case it is usually faster to compute the gcd on the
+     structure of the terms (and avoids expanding them).
      Otherwise expands it */
-  for (i = 0; i < n ; i++) {
-    /* TODO: Support POW ? */
-    if (MAY_TYPE (expandtab[i]) == MAY_FACTOR_T || MAY_TYPE (expandtab[i]) == MAY_PRODUCT_T) {
-      may_size_t j, m;
+  for (i = 0; i < n ; i++)
+    if (gcd_struct_p (expandtab[i])) {
       MAY_LOG_MSG(("Found product in expression: compute GCD of products\n"));
-      /* Found it! Compute each partial gcd */
-      may_t *temp = may_alloc (n * sizeof (may_t));
-      memcpy (temp, expandtab, n*sizeof (may_t));
-      m = may_nops (expandtab[i]);
-      may_t *result = may_alloc ((m+1) * sizeof (may_t));
-      for (j = 0; j < m ; j ++) {
-        temp[i] = MAY_AT (expandtab[i], j);
-        /* We have remove one product over a finite set of terms. It won't loop forever */
-        result[j] = may_gcd (n, temp);
-        /* If a partial GCD is found, remove it from every other term*/
-        if (result[j] != MAY_ONE) {
-          bool cont = true;
-          /* Remove the partial GCD from every one */
-          for (may_size_t k = 0; k < n; k++) {
-            if (i == k)
-              continue;
-            temp[k] = may_divexact (temp[k], result[j]);
-            MAY_ASSERT (temp[k] != NULL);
-            /* If what remains is a pure numerical, we have reached the GCD */
-            if (MAY_PURENUM_P (temp[k]))
-              cont = false;
-          }
-          /* If some terms reduced to numerical, stop the computation */
-          if (cont == false)
-            for (++j ; j < m ; j++)
-            result[j] = MAY_ONE;
-        }
-      }
+      may_t ca, cb;
+      gcd = expandtab[0];
+      for (i = 1; i < n && gcd != MAY_ONE; i++)
+        gcd = gcd_struct (&ca, &cb, gcd, expandtab[i]);
       /* Don't forget the previously computed naivegcd */
-      result[m] = naivegcd;
-      gcd = may_mul_vc (m+1, result);
-      MAY_RET_EVAL (gcd);
+      MAY_RET_EVAL (may_mul_c (gcd, naivegcd));
     }
-    /* Not a product, so expands the expression */
+  for (i = 0; i < n ; i++)
     expandtab[i] = may_expand (expandtab[i]);
-  }
 
   /* Extract a commun var (bis)
      Because removing the naive GCD may remove the previously computed common var,
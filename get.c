@@ -213,3 +213,61 @@ may_map2 (may_t x, may_t (*func)(may_t, void*), void *data)
 {
   return may_eval (may_map2_c (x, func, data));
 }
+
+/* Parallel version of may_map_c (if func1 is not NULL) or may_map2_c.
+   The children of x are distributed over the worker threads, each one
+   using its own heap and a copy of the current frame.
+   The result is compacted in the heap of the caller, freeing the heaps
+   of the workers. If eval is set, the children are evaluated by
+   the workers and the result is evaluated. */
+static may_t
+pmap_c (may_t x, may_t (*func1)(may_t), may_t (*func2)(may_t,void*),
+        void *data, int eval)
+{
+#ifdef MAY_WANT_THREAD
+  if (MAY_LIKELY (!MAY_ATOMIC_P (x)
+                  && MAY_NODE_SIZE (x) > MAY_SPAWN_FOR_TH)) {
+    may_size_t n = MAY_NODE_SIZE (x);
+    may_mark_t mark;
+    may_mark (mark);
+    may_t y = MAY_NODE_C (MAY_TYPE (x), n);
+    may_t *dest = MAY_AT_PTR (y, 0);
+    const may_t *src = MAY_AT_PTR (x, 0);
+    MAY_SPAWN_FOR (mark, i, 0, (may_int_t) n,
+                   (dest, src, func1, func2, data, eval), {
+        may_t z = func1 != NULL ? (*func1) (src[i]) : (*func2) (src[i], data);
+        dest[i] = eval ? may_eval (z) : z;
+      });
+    return may_compact (mark, eval ? may_eval (y) : y);
+  }
+#endif
+  /* Not worth spawning */
+  if (func1 != NULL)
+    return eval ? may_map (x, func1) : may_map_c (x, func1);
+  else
+    return eval ? may_map2 (x, func2, data) : may_map2_c (x, func2, data);
+}
+
+may_t
+may_pmap_c (may_t x, may_t (*func)(may_t))
+{
+  return pmap_c (x, func, NULL, NULL, 0);
+}
+
+may_t
+may_pmap (may_t x, may_t (*func)(may_t))
+{
+  return pmap_c (x, func, NULL, NULL, 1);
+}
+
+may_t
+may_pmap2_c (may_t x, may_t (*func)(may_t,void*), void *data)
+{
+  return pmap_c (x, NULL, func, data, 0);
+}
+
+may_t
+may_pmap2 (may_t x, may_t (*func)(may_t, void*), void *data)
+{
+  return pmap_c (x, NULL, func, data, 1);
+}
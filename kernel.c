@@ -128,6 +128,26 @@ init_q (long n, long d)
   MAY_RET (y);
 }
 
+/* Set the default values of the kernel of the current thread */
+static void
+kernel_set_default (void)
+{
+  /* Set MPFR exponents to their maximum: no need to save them */
+  mpfr_set_emin (mpfr_get_emin_min ());
+  mpfr_set_emax (mpfr_get_emax_max ());
+
+  /* Set default values */
+  may_kernel_prec (113);
+  may_kernel_base (10);
+  may_kernel_rnd (GMP_RNDN);
+  may_kernel_zero_cb (may_zero_fastp);
+  may_kernel_sort_cb (may_identical);
+  may_kernel_num_presimplify (1);
+  may_kernel_intmod (NULL);
+  may_kernel_intmaxsize (65536);
+  may_kernel_domain (MAY_COMPLEX_D);
+}
+
 void
 may_kernel_start (size_t n, int allow_extend)
 {
@@ -162,20 +182,7 @@ may_kernel_start (size_t n, int allow_extend)
   may_heap_init (&may_g.Heap, n, n-n/4, allow_extend);
   /* Set GMP to the allocated heap */
   may_kernel_restart ();
-  /* Set MPFR exponents to their maximum: no need to save them */
-  mpfr_set_emin (mpfr_get_emin_min ());
-  mpfr_set_emax (mpfr_get_emax_max ());
-
-  /* Set default values */
-  may_kernel_prec (113);
-  may_kernel_base (10);
-  may_kernel_rnd (GMP_RNDN);
-  may_kernel_zero_cb (may_zero_fastp);
-  may_kernel_sort_cb (may_identical);
-  may_kernel_num_presimplify (1);
-  may_kernel_intmod (NULL);
-  may_kernel_intmaxsize (65536);
-  may_kernel_domain (MAY_COMPLEX_D);
+  kernel_set_default ();
 
   /* Some default symbolic numbers (296 bytes used) */
   for(int i = 0; i < MAY_MAX_MPZ_CONSTANT; i++) {
@@ -206,14 +213,70 @@ may_kernel_start (size_t n, int allow_extend)
   MAY_LOG_MSG(("Starting MAYLIB with size=%ul and options=%d\n", (unsigned long) n, allow_extend));
 }
 
+/* Remove the budget of the current thread */
+static void
+budget_clear (void)
+{
+  if (may_g.budget.limit != NULL)
+    may_g.Heap.limit = may_g.budget.limit;
+  may_g.budget.active = 0;
+  may_g.budget.count = 0;
+  may_g.budget.timeout = 0;
+  may_g.budget.deadline = 0;
+  may_g.budget.memlimit = 0;
+  may_g.budget.limit = NULL;
+  may_g.budget.cancel = NULL;
+}
+
 void
 may_kernel_end (void)
 {
   MAY_DEF_IF_THREAD (may_thread_quit();)
+  budget_clear ();
+  may_symbol_clear ();
+  may_antidiff_clear ();
   may_heap_clear (&may_g.Heap);
   MAY_LOG_MSG(("Ending MAYLIB (Used:%lu MaxUsed:%lu)\n", (unsigned long) (may_g.Heap.top-may_g.Heap.base), (unsigned long) (may_g.Heap.max_top-may_g.Heap.base)));
 }
 
+/* Start an independent session of the kernel in the current thread.
+   It has its own heap and frame, but it shares the constants and the
+   extensions of the kernel, which shall be started (and not ended
+   before the end of the session). */
+int
+may_session_start (size_t n)
+{
+#ifdef MAY_WANT_THREAD
+  if (MAY_UNLIKELY (may_c.Pi == NULL))
+    return -1;
+  if (n == 0)
+    n = may_mt_g.stack_size;
+  n = MAX (512, n);
+  memset (&may_g, 0, sizeof may_g);
+  may_heap_init (&may_g.Heap, n, n-n/4, 0);
+  kernel_set_default ();
+  MAY_LOG_MSG(("Starting MAYLIB session with size=%lu\n", (unsigned long) n));
+  return 0;
+#else
+  UNUSED (n);
+  return -1;
+#endif
+}
+
+/* End the session of the current thread */
+void
+may_session_end (void)
+{
+#ifdef MAY_WANT_THREAD
+  MAY_ASSERT (may_g.Heap.base != NULL);
+  /* The MPFR cache of this thread is allocated in the heap */
+  mpfr_free_cache ();
+  budget_clear ();
+  may_heap_clear (&may_g.Heap);
+  memset (&may_g, 0, sizeof may_g);
+#endif
+}
+
 /* Set the current rounding mode */
 mp_rnd_t
 may_kernel_rnd (mp_rnd_t rnd)
@@ -313,6 +376,81 @@ may_kernel_intmaxsize (unsigned long n)
   return old;
 }
 
+/* Set the timeout in ms of the computations of the current thread
+   from now (0 to remove it) */
+unsigned long
+may_kernel_timeout (unsigned long n)
+{
+  MAY_LOG_MSG (("New timeout= %lu\n", n));
+  unsigned long old = may_g.budget.timeout;
+  may_g.budget.timeout = n;
+  may_g.budget.deadline = n == 0 ? 0 : may_get_time_ms () + n;
+  may_g.budget.count = 0;
+  may_g.budget.active = (n != 0 || may_g.budget.cancel != NULL);
+  return old;
+}
+
+/* Set the memory budget in bytes of the computations of the current
+   thread from the current top of the heap (0 to remove it).
+   The budget is enforced by lowering the limit of the heap,
+   so that it doesn't cost anything to the fast path of MAY_ALLOC */
+size_t
+may_kernel_memlimit (size_t n)
+{
+  MAY_LOG_MSG (("New memlimit= %lu\n", (unsigned long) n));
+  size_t old = may_g.budget.memlimit;
+  if (may_g.budget.limit != NULL) {
+    may_g.Heap.limit = may_g.budget.limit;
+    may_g.budget.limit = NULL;
+  }
+  may_g.budget.memlimit = n;
+  if (n != 0 && n < (size_t) (may_g.Heap.limit - may_g.Heap.top)) {
+    may_g.budget.limit = may_g.Heap.limit;
+    may_g.Heap.limit = may_g.Heap.top + n;
+  }
+  return old;
+}
+
+/* Set the cancel flag of the computations of the current thread
+   (NULL to remove it). The computation is interrupted as soon as
+   possible once the flag becomes not zero (It may be set by another
+   thread or by a signal handler) */
+const volatile int *
+may_kernel_cancel (const volatile int *flag)
+{
+  MAY_LOG_MSG (("New cancel flag= %p\n", (const void *) flag));
+  const volatile int *old = may_g.budget.cancel;
+  may_g.budget.cancel = flag;
+  may_g.budget.active = (flag != NULL || may_g.budget.deadline != 0);
+  return old;
+}
+
+/* Throw MAY_INTERRUPT_ERR after removing the budget,
+   so that the error handler can compute again */
+void
+may_budget_throw (const char what[])
+{
+  budget_clear ();
+  may_error_throw (MAY_INTERRUPT_ERR, what);
+  abort ();
+}
+
+/* Check the cancel flag and the timeout.
+   The clock is only read once every MAY_BUDGET_CLOCK_PERIOD checks */
+#define MAY_BUDGET_CLOCK_PERIOD 16
+void
+may_budget_check (void)
+{
+  if (may_g.budget.cancel != NULL && *may_g.budget.cancel != 0)
+    may_budget_throw ("cancel");
+  if (may_g.budget.deadline != 0
+      && ++may_g.budget.count >= MAY_BUDGET_CLOCK_PERIOD) {
+    may_g.budget.count = 0;
+    if (may_get_time_ms () >= may_g.budget.deadline)
+      may_budget_throw ("timeout");
+  }
+}
+
 /* Stop the MAY kernel */
 void
 may_kernel_stop (void)
@@ -30,6 +30,8 @@ may_error_catch (void (*handler)(may_error_e,const char [],const void*),
   /* Save the frame */
   ef  = may_alloc (sizeof *ef);
   *ef = may_g.frame;
+  ef->budget_disabled = may_g.budget.disabled;
+  MAY_DEF_IF_THREAD (ef->spawn_seq = may_g.budget.spawn_seq;)
   /* Register the handler */
   may_g.frame.next = ef;
   may_g.frame.error_handler = handler;
@@ -65,8 +67,11 @@ may_error_throw   (may_error_e error, const char description[])
   handler = may_g.frame.error_handler;
   if (handler) {
     const void *data = may_g.frame.error_handler_data;
+    /* Wait for the jobs of the worker threads which are left */
+    MAY_DEF_IF_THREAD (may_spawn_unwind (may_g.frame.next->spawn_seq);)
     /* Restore globals and remove handler */
     may_g.frame = *(may_g.frame.next);
+    may_g.budget.disabled = may_g.frame.budget_disabled;
     /* Save new errors */
     may_g.last_error = error;
     may_g.last_error_str = description;
@@ -105,6 +110,8 @@ may_error_what (may_error_e error)
       return "Singular Matrix";
     case MAY_VALUATION_NOT_POS_ERR:
       return "Valuation is not strictly positive.";
+    case MAY_INTERRUPT_ERR:
+      return "Interrupted";
     default:
       return "Unkwnow";
     }
@@ -53,9 +53,6 @@ finish_compact (void *mark)
     if (MAY_UNLIKELY (may_g.Heap.comp_mark <= (void*)may_g.frame.intmod && (void*)may_g.frame.intmod < may_g.Heap.comp_limit))
 #endif
       may_g.frame.intmod = NULL;
-  
-  /* Free the set_str cache */
-  may_g.frame.cache_set_str_i = may_g.frame.cache_set_str_n = 0;
 
   /* Free the MPFR cache */
   mpfr_free_cache ();
@@ -72,145 +69,290 @@ finish_compact (void *mark)
     may_g.Heap.next_heap_to_free = NULL;)
 }
 
-/* This MACRO returns TRUE if the may_t input variable has to be compacted */
-/* If MT mode, TO_COMPACT is more complicated since there are multiple heaps */
-static MAY_REGPARM may_t compact_recur1 (may_t);
-
+/* Return TRUE if the may_t input variable has to be moved by the compact.
+   If MT mode, it is more complicated since there are multiple heaps:
+   the heaps of the worker threads which shall be freed after the compact
+   have to be moved too */
 #ifndef MAY_WANT_THREAD
-MAY_INLINE may_t compact_if_needed(may_t x)
+MAY_INLINE int compact_p (may_t x)
 {
-  return (may_g.Heap.comp_mark<=(void*)x) ? compact_recur1(x) : x;
+  /* The interned symbols are outside of the heap */
+  return may_g.Heap.comp_mark <= (void*) x && (void*) x < may_g.Heap.comp_limit;
 }
 #else
-MAY_INLINE may_t compact_if_needed(may_t x)
+MAY_INLINE int compact_p (may_t x)
 {
   void *xv = x;
   /* Check if x is within the data to move (very likely) */
   if (MAY_LIKELY (may_g.Heap.comp_mark <= xv && xv < may_g.Heap.comp_limit))
-    return compact_recur1(x);
+    return 1;
   /* Check if x shall not be moved (likely) */
   if (MAY_LIKELY (may_g.Heap.comp_base <= xv && xv < may_g.Heap.comp_mark))
-    return x;
-
-  /* Check if x is within an heap which shall be freed after the compact
-     in which case, we have to compact it now */
-  /* We need to start from may_g.Heap since we may have scanned from
-     may_g to another heap, then rego to the original one. Quite unlikely
-     but possible. */
-  struct may_heap_s *heap = &may_g.Heap;
-  do {
-    if (MAY_UNLIKELY (heap->base <= (char*)x && (char*)x < heap->limit)) {
-      /* Future compact(s) are likely within this new heap.
-         Temporary Change of the current heap for performance */
-      void *comp_mark  = may_g.Heap.comp_mark;
-      void *comp_base  = may_g.Heap.comp_base;
-      void *comp_limit = may_g.Heap.comp_limit;
-      may_g.Heap.comp_mark = heap->base;
-      may_g.Heap.comp_base = heap->base;
-      may_g.Heap.comp_limit = heap->limit;
-      may_t z = compact_recur1 (x);
-      may_g.Heap.comp_mark = comp_mark;
-      may_g.Heap.comp_base = comp_base;
-      may_g.Heap.comp_limit = comp_limit;
-      return z;
-    }
+    return 0;
+  /* Check if x is within an heap which shall be freed after the compact */
+  struct may_heap_s *heap = may_g.Heap.next_heap_to_free;
+  while (MAY_UNLIKELY (heap != NULL)) {
+    if (heap->base <= (char*)x && (char*)x < heap->limit)
+      return 1;
     heap = heap->next_heap_to_free;
-  } while (MAY_UNLIKELY(heap != NULL));
-  return x; /* Not found ==> No compact (likely in another heap) */
+  }
+  return 0; /* Not found ==> No compact (likely in another heap) */
 }
 #endif
 
-/* This functions hacks inside the "hidden" struct of GMP
-   in order to move them (including their mantissa).
-   It usually costs around 10% of a MAY program */
-static MAY_REGPARM may_t
-compact_recur1 (may_t x)
+/* The work stack of the compact: the nodes whose arguments are not
+   moved yet, their copies, and the number of their arguments still to move.
+   It is allocated outside the heap (it can't be below its limit since the
+   heap may be extended), and kept by the heap for the next compacts. */
+struct compact_frame_s {
+  may_t x, y;
+  may_size_t i;
+};
+
+static struct compact_frame_s *
+compact_stack_grow (struct compact_frame_s *sp)
+{
+  size_t used = sp - (struct compact_frame_s *) may_g.Heap.comp_stack;
+  size_t size = MAX (2 * may_g.Heap.comp_stack_size, 256);
+  void *p = realloc (may_g.Heap.comp_stack, size * sizeof *sp);
+  if (MAY_UNLIKELY (p == NULL))
+    may_throw_memory ();
+  may_g.Heap.comp_stack = p;
+  may_g.Heap.comp_stack_size = size;
+  return (struct compact_frame_s *) p + used;
+}
+
+/* Move an atomic object.
+   This functions hacks inside the "hidden" struct of GMP
+   in order to move them (including their mantissa). */
+static may_t
+compact_atomic (may_t x)
 {
   may_t y;
-  may_type_t t = MAY_TYPE (x);
   size_t s;
 
+  switch (MAY_TYPE (x)) {
+  case MAY_INT_T:
+    s = mpz_size (MAY_INT (x)) * sizeof (mp_limb_t);
+    y = MAY_ALLOC (MAY_INT_SIZE + s);
+    memcpy ((char*)y, x, MAY_INT_SIZE);
+    memcpy ((char*)y+MAY_INT_SIZE, MAY_INT(x)->_mp_d, s);
+    MAY_INT (y)->_mp_d = (void*) ((char*)y + MAY_INT_SIZE - may_g.Heap.compdiff);
+    break;
+  case MAY_RAT_T:
+    {
+      size_t s2;
+      s2 = mpz_size (mpq_denref (MAY_RAT (x))) * sizeof (mp_limb_t);
+      s  = mpz_size (mpq_numref (MAY_RAT (x))) * sizeof (mp_limb_t);
+      y = MAY_ALLOC (MAY_RAT_SIZE + s + s2);
+      memcpy ((char*)y, x, MAY_RAT_SIZE);
+      memcpy ((char*)y+MAY_RAT_SIZE  , mpq_numref (MAY_RAT (x))->_mp_d,  s);
+      memcpy ((char*)y+MAY_RAT_SIZE+s, mpq_denref (MAY_RAT (x))->_mp_d, s2);
+      mpq_numref(MAY_RAT(y))->_mp_d = (void*)((char*)y + MAY_RAT_SIZE
+                                              - may_g.Heap.compdiff);
+      mpq_denref(MAY_RAT(y))->_mp_d = (void*)((char*)y + MAY_RAT_SIZE + s
+                                              - may_g.Heap.compdiff);
+    }
+    break;
+  case MAY_FLOAT_T:
+    s = mpfr_custom_get_size(mpfr_get_prec(MAY_FLOAT(x)));
+    y = MAY_ALLOC (MAY_FLOAT_SIZE + s);
+    memcpy (y, x, MAY_FLOAT_SIZE);
+    memcpy ((char*)y+MAY_FLOAT_SIZE,mpfr_custom_get_mantissa(MAY_FLOAT(x)),s);
+    mpfr_custom_move(MAY_FLOAT (y), ((char*)y + MAY_FLOAT_SIZE - may_g.Heap.compdiff));
+    break;
+  case MAY_STRING_T:
+    s = MAY_NAME_SIZE (MAY_SYMBOL_SIZE(x));
+    y = MAY_ALLOC (s);
+    memcpy (y, x, s);
+    break;
+  default:
+    MAY_ASSERT (MAY_TYPE (x) == MAY_DATA_T);
+    s = MAY_DATA_SIZE (MAY_DATA(x).size);
+    y = MAY_ALLOC (s);
+    memcpy (y, x, s);
+    break;
+  }
+  y = (may_t) ((char*) y - may_g.Heap.compdiff);
+  MAY_SET_INDIRECT (x, y);
+  return y;
+}
+
+/* Return the new address of the atomic part of a moved complex */
+static may_t
+compact_move_atomic (may_t x)
+{
+  if (!compact_p (x))
+    return x;
+  if (MAY_TYPE (x) == MAY_INDIRECT_T)
+    return MAY_INDIRECT (x);
+  return compact_atomic (x);
+}
+
+/* Return the new address of the atomic object x to move
+   (an already moved object, a number, a symbol, a data or a complex) */
+MAY_INLINE may_t
+compact_leaf (may_t x)
+{
+  may_t y;
+  may_type_t t = MAY_TYPE (x);
+
+  if (t == MAY_INDIRECT_T)
+    return MAY_INDIRECT (x);
+  if (t != MAY_COMPLEX_T)
+    return compact_atomic (x);
+  /* Complex: its real and imaginary parts are atomic */
+  may_t r = compact_move_atomic (MAY_RE (x));
+  may_t i = compact_move_atomic (MAY_IM (x));
+  y = MAY_ALLOC (MAY_COMPLEX_SIZE);
+  memcpy (y, x, sizeof (struct may_s) + sizeof (struct may_node_s) );
+  MAY_SET_RE (y, r);
+  MAY_SET_IM (y, i);
+  y = (may_t) ((char*) y - may_g.Heap.compdiff);
+  MAY_SET_INDIRECT (x, y);
+  return y;
+}
+
+/* Return the new address of the argument x of a moved node.
+   A node is written before its arguments, which are moved from the last
+   one to the first one (as the recursive compact does).
+   The moved node is pushed in the work stack to move its arguments. */
+MAY_INLINE may_t
+compact_move (may_t x, struct compact_frame_s **sp)
+{
+  may_t y;
+  may_type_t t;
+
   MAY_ASSERT (x != NULL);
-  MAY_ASSERT (MAY_TYPE (x) < MAY_END_LIMIT || MAY_EXT_P (x));
+  if (!compact_p (x))
+    return x;
+  t = MAY_TYPE (x);
+  MAY_ASSERT (t < MAY_END_LIMIT || MAY_EXT_P (x));
+  if (MAY_UNLIKELY (t < MAY_ATOMIC_LIMIT))
+    return compact_leaf (x);
+  /* Non atomic */
+  may_size_t n = MAY_NODE_SIZE(x);
+  MAY_ASSERT (n > 0);
+  y = MAY_ALLOC (MAY_NODE_ALLOC_SIZE (n));
+  memcpy ((void*)y, x, sizeof (may_header_t));
+  MAY_NODE_SIZE(y) = n;
+  /* Push the node to move its arguments. It is marked as moved
+     once done, since it can't be reached from its arguments */
+  struct compact_frame_s *f = *sp;
+  if (MAY_UNLIKELY (f == (struct compact_frame_s *) may_g.Heap.comp_stack
+                    + may_g.Heap.comp_stack_size))
+    f = compact_stack_grow (f);
+  f->x = x;
+  f->y = y;
+  f->i = n;
+  *sp = f + 1;
+  return (may_t) ((char*) y - may_g.Heap.compdiff);
+}
 
-  /* Hard code the copy of MPZ/MPQ/MPFR */
-  if (MAY_UNLIKELY (t < MAY_ATOMIC_LIMIT)) {
-    switch (t) {
-    case MAY_INT_T:
-      s = mpz_size (MAY_INT (x)) * sizeof (mp_limb_t);
-      y = MAY_ALLOC (MAY_INT_SIZE + s);
-      memcpy ((char*)y, x, MAY_INT_SIZE);
-      memcpy ((char*)y+MAY_INT_SIZE, MAY_INT(x)->_mp_d, s);
-      MAY_INT (y)->_mp_d = (void*) ((char*)y + MAY_INT_SIZE - may_g.Heap.compdiff);
-      break;
-    case MAY_RAT_T:
-      {
-	size_t s2;
-	s2 = mpz_size (mpq_denref (MAY_RAT (x))) * sizeof (mp_limb_t);
-	s  = mpz_size (mpq_numref (MAY_RAT (x))) * sizeof (mp_limb_t);
-	y = MAY_ALLOC (MAY_RAT_SIZE + s + s2);
-	memcpy ((char*)y, x, MAY_RAT_SIZE);
-	memcpy ((char*)y+MAY_RAT_SIZE  , mpq_numref (MAY_RAT (x))->_mp_d,  s);
-	memcpy ((char*)y+MAY_RAT_SIZE+s, mpq_denref (MAY_RAT (x))->_mp_d, s2);
-	mpq_numref(MAY_RAT(y))->_mp_d = (void*)((char*)y + MAY_RAT_SIZE
-                                                - may_g.Heap.compdiff);
-	mpq_denref(MAY_RAT(y))->_mp_d = (void*)((char*)y + MAY_RAT_SIZE + s
-                                                - may_g.Heap.compdiff);
-      }
-      break;
-    case MAY_FLOAT_T:
-      s = mpfr_custom_get_size(mpfr_get_prec(MAY_FLOAT(x)));
-      y = MAY_ALLOC (MAY_FLOAT_SIZE + s);
-      memcpy (y, x, MAY_FLOAT_SIZE);
-      memcpy ((char*)y+MAY_FLOAT_SIZE,mpfr_custom_get_mantissa(MAY_FLOAT(x)),s);
-      mpfr_custom_move(MAY_FLOAT (y), ((char*)y + MAY_FLOAT_SIZE - may_g.Heap.compdiff));
-      break;
-    case MAY_COMPLEX_T:
-      {
-	may_t r = MAY_RE (x), i = MAY_IM (x);
-	r = compact_if_needed(r);
-	i = compact_if_needed(i);
-	y = MAY_ALLOC (MAY_COMPLEX_SIZE);
-	memcpy (y, x, sizeof (struct may_s) + sizeof (struct may_node_s) );
-	MAY_SET_RE (y, r);
-	MAY_SET_IM (y, i);
+/* Move the expression x and all its arguments to the top of the heap
+   with an explicit work stack, so that the depth of the expression
+   is not limited by the C stack (See compact_recur) */
+static may_t
+compact_stack (may_t x)
+{
+  struct compact_frame_s *sp = may_g.Heap.comp_stack;
+
+  x = compact_move (x, &sp);
+  /* The stack may be reallocated by compact_move: only sp is kept */
+  while (sp != may_g.Heap.comp_stack) {
+    struct compact_frame_s *f = sp - 1;
+    may_t x = f->x, y = f->y;
+    may_size_t i;
+    for (i = f->i; i != 0; i--) {
+      may_t z = MAY_AT (x, i-1);
+      if (compact_p (z)) {
+        z = compact_move (z, &sp);
+        /* If a node has been pushed, move its arguments first.
+           The node is now the previous frame (f may have been reallocated) */
+        if (MAY_UNLIKELY (sp != f + 1)) {
+          MAY_SET_AT (y, i-1, z);
+          sp[-2].i = i - 1;
+          goto next;
+        }
       }
-      break;
-    case MAY_STRING_T:
-      s = MAY_NAME_SIZE (MAY_SYMBOL_SIZE(x));
-      y = MAY_ALLOC (s);
-      memcpy (y, x, s);
-      break;
-    case MAY_DATA_T:
-      s = MAY_DATA(x).size;
-      y = MAY_ALLOC (MAY_DATA_SIZE (s));
-      memcpy (y, x, s);
-      break;
-    default:
-      MAY_ASSERT (MAY_TYPE (x) == MAY_INDIRECT_T);
-      return MAY_INDIRECT (x);
+      MAY_SET_AT (y, i-1, z);
     }
+    MAY_SET_INDIRECT (x, (may_t) ((char*) y - may_g.Heap.compdiff));
+    sp = f;
+  next:
+    ;
   }
-  else /* Non atomic */
-    {
-      may_size_t n = MAY_NODE_SIZE(x);
-      y = MAY_ALLOC (MAY_NODE_ALLOC_SIZE (n));
-      memcpy ((void*)y, x, sizeof (may_header_t));
-      MAY_NODE_SIZE(y) = n;
-      MAY_ASSERT (n > 0);
-      /* TODO: Analyse cache coherency for copying backward? */
-      do {
-	may_t z = MAY_AT(x, n-1);
-	MAY_SET_AT (y, n-1, compact_if_needed(z) );
-      } while (--n != 0);
-    }
+  return x;
+}
+
+/* Maximum depth of the recursive compact: the deeper arguments
+   are moved with the work stack (See compact_stack) */
+#define COMPACT_RECURSION_MAX 1024
+
+/* Move the expression x (which has to be moved) and all its arguments
+   to the top of the heap. It recurses over the arguments of x, since it
+   is faster than the work stack, as long as depth isn't exhausted.
+   It usually costs around 10% of a MAY program */
+static may_t
+compact_recur (may_t x, unsigned int depth)
+{
+  may_t y;
+  may_size_t n;
+
+  MAY_ASSERT (x != NULL && compact_p (x));
+  MAY_ASSERT (MAY_TYPE (x) < MAY_END_LIMIT || MAY_EXT_P (x));
+  if (MAY_UNLIKELY (MAY_TYPE (x) < MAY_ATOMIC_LIMIT))
+    return compact_leaf (x);
+  if (MAY_UNLIKELY (depth == 0))
+    return compact_stack (x);
+  n = MAY_NODE_SIZE(x);
+  MAY_ASSERT (n > 0);
+  y = MAY_ALLOC (MAY_NODE_ALLOC_SIZE (n));
+  memcpy ((void*)y, x, sizeof (may_header_t));
+  MAY_NODE_SIZE(y) = n;
+  do {
+    may_t z = MAY_AT (x, n-1);
+    if (compact_p (z))
+      z = MAY_TYPE (z) < MAY_ATOMIC_LIMIT ? compact_leaf (z)
+        : compact_recur (z, depth - 1);
+    MAY_SET_AT (y, n-1, z);
+  } while (--n != 0);
   y = (may_t) ((char*) y - may_g.Heap.compdiff);
   /* Even if x==y, this is still valid since y is not yet in the place of x */
   MAY_SET_INDIRECT (x, y);
-
   return y;
 }
 
+/* Move the expression x and all its arguments to the top of the heap */
+MAY_INLINE may_t
+compact_expr (may_t x)
+{
+  return compact_p (x) ? compact_recur (x, COMPACT_RECURSION_MAX) : x;
+}
+
+/* Begin a compact: it can't be interrupted by the budget of the
+   computation. Return the limit of the heap to restore at the end */
+MAY_INLINE char *
+compact_begin (void *mark)
+{
+  char *limit = may_g.Heap.limit;
+  may_g.budget.disabled ++;
+  if (MAY_UNLIKELY (may_g.budget.limit != NULL))
+    may_g.Heap.limit = may_g.budget.limit;
+  may_g.Heap.comp_mark = mark;
+  may_g.Heap.comp_limit = may_g.Heap.limit;
+  MAY_DEF_IF_THREAD (may_g.Heap.comp_base = may_g.Heap.base);
+  return limit;
+}
+
+MAY_INLINE void
+compact_end (char *limit)
+{
+  may_g.budget.disabled --;
+  if (MAY_UNLIKELY (may_g.budget.limit != NULL))
+    may_g.Heap.limit = limit;
+}
+
 /* Compact an expression from Heap.top to limit */
 MAY_REGPARM may_t
 may_compact_internal (may_t x, void *mark)
@@ -219,27 +361,21 @@ may_compact_internal (may_t x, void *mark)
   char *oldtop = may_g.Heap.top;
 #endif
   /* Update heap variables for compact */
-  may_g.Heap.comp_mark = mark;
-  MAY_DEF_IF_THREAD (may_g.Heap.comp_base = may_g.Heap.base);
-  MAY_DEF_IF_THREAD (may_g.Heap.comp_limit = may_g.Heap.limit);
-#ifndef MAY_WANT_THREAD
-  if (MAY_LIKELY (mark <= (void*)x)) {
-#else
+  char *limit = compact_begin (mark);
   if (MAY_LIKELY (mark <= (void*)x && (void*)x < may_g.Heap.comp_limit)) {
-#endif
     unsigned long length;
     update_max_top ();
     may_g.Heap.compdiff = ((char*) may_g.Heap.top) - (char*) mark;
     /* Compact */
-    x = compact_recur1 (x);
+    x = compact_expr (x);
     /* Compute the length of the expression */
     length = (char*) may_g.Heap.top - (char*)mark - may_g.Heap.compdiff;
-    /* FIXME: memmove ? */
-    memcpy (mark, (char*)mark + may_g.Heap.compdiff, length);
+    memmove (mark, (char*)mark + may_g.Heap.compdiff, length);
     may_g.Heap.top = (char*)mark + length;
   }
   else
     may_g.Heap.top = mark;
+  compact_end (limit);
   finish_compact (mark);
 #ifdef MAY_WANT_ASSERT
   /* Cleanup the recuperated memory */
@@ -260,9 +396,7 @@ may_compact_vector (may_t *x, may_size_t num, void *mark)
   /* Update the maximum TOP reached */
   update_max_top ();
   /* Compute the SIZE to compact */
-  may_g.Heap.comp_mark = mark;
-  MAY_DEF_IF_THREAD (may_g.Heap.comp_base = may_g.Heap.base);
-  MAY_DEF_IF_THREAD (may_g.Heap.comp_limit = may_g.Heap.limit);
+  char *limit = compact_begin (mark);
   may_g.Heap.compdiff = (char*) may_g.Heap.top - (char*) mark;
 
   /* If the array has to be collected too (Warning it may be outside the HEAP too!) */
@@ -275,7 +409,7 @@ may_compact_vector (may_t *x, may_size_t num, void *mark)
   /* Compact each element of x */
   for ( ; num != 0; num--, x++, x_w++) {
     if (MAY_LIKELY (*x != NULL))
-      *x_w = compact_if_needed (*x);
+      *x_w = compact_expr (*x);
     else
       *x_w = NULL;
   }
@@ -284,6 +418,7 @@ may_compact_vector (may_t *x, may_size_t num, void *mark)
   /* Free memory */
   memmove (mark, (char*) mark + may_g.Heap.compdiff, length);
   may_g.Heap.top = (char*) mark + length;
+  compact_end (limit);
   finish_compact (mark);
 
   /* Return new pointer to the array x if any */
@@ -293,6 +428,9 @@ may_compact_vector (may_t *x, may_size_t num, void *mark)
 MAY_NORETURN void
 may_throw_memory (void)
 {
+  /* The heap is exhausted by the memory budget, not by its real size */
+  if (MAY_UNLIKELY (may_g.budget.limit != NULL))
+    may_budget_throw ("memory");
   MAY_THROW (MAY_MEMORY_ERR);
 }
 
@@ -352,12 +490,17 @@ may_heap_init (struct may_heap_s *heap, unsigned long size, unsigned long low, i
   heap->num_resize = 0;
   heap->allow_extend = allow_extend;
   heap->compact_func_disable = 0;
+  heap->comp_stack = NULL;
+  heap->comp_stack_size = 0;
   MAY_DEF_IF_THREAD (heap->next_heap_to_free = NULL; )
 }
 
 void
 may_heap_clear (struct may_heap_s *heap)
 {
+  free (heap->comp_stack);
+  heap->comp_stack = NULL;
+  heap->comp_stack_size = 0;
 #ifdef WANT_MMAP
   munmap (heap->base, (char*)heap->limit-(char*)heap->base);
 #elif !defined(WANT_SBRK)
@@ -370,6 +513,10 @@ may_heap_extend (unsigned long n)
 {
   MAY_LOG_MSG(("Request for an extension to alloc %ul bytes\n", n));
   may_g.Heap.num_resize ++;
+  /* Slow path of MAY_ALLOC: check the budget of the computation */
+  MAY_BUDGET_CHECK ();
+  if (MAY_UNLIKELY (may_g.budget.limit != NULL))
+    may_budget_throw ("memory");
   /* Test if we are allowed to extend the Heap */
   if (!may_g.Heap.allow_extend)
     MAY_THROW (MAY_MEMORY_ERR);
@@ -51,9 +51,10 @@ may_vcb_printf (FILE *stream, const struct printf_info *info,
 
   w = *((may_t *) (arg[0]));
   /* Compute the size of w while being protective about invalid data */
-  size = MAY_UNLIKELY ((char*)w < may_g.Heap.base
-                       || (char*) w >= may_g.Heap.top
-                       || (((unsigned long)w) % sizeof(long)) != 0) ? 0
+  size = MAY_UNLIKELY (((char*)w < may_g.Heap.base
+                        || (char*) w >= may_g.Heap.top)
+                       && !may_symbol_interned_p (w)) ? 0
+    : MAY_UNLIKELY ((((unsigned long)w) % sizeof(long)) != 0) ? 0
     : may_length (w);
   if (size >= may_log_size) {
     const char * type = may_get_name (w);
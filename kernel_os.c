@@ -30,6 +30,10 @@ MA 02110-1301, USA. */
 #else
 # include <unistd.h>
 #endif
+#if !defined(_WIN32)
+# include <time.h>
+# include <sys/time.h>
+#endif
 
 /* Return the number of CPU of the system */
 int may_get_cpu_count(void)
@@ -54,3 +58,19 @@ int may_get_cpu_count(void)
 }
 
 
+
+/* Return a monotonic time in ms */
+unsigned long long may_get_time_ms(void)
+{
+#if defined(_WIN32)
+  return GetTickCount64();
+#elif defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (unsigned long long) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#endif
+}
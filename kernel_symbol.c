@@ -0,0 +1,224 @@
+/* This file is part of the MAYLIB libray.
+   Copyright 2007-2018 Patrick Pelissier
+
+This Library is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This Library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with th Library; see the file COPYING.LESSER.txt.
+If not, write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston,
+MA 02110-1301, USA. */
+
+#include "may-impl.h"
+
+/* The interned symbol table.
+   Each (name, domain) is mapped to a single symbol which is allocated
+   outside of the heaps, in blocks owned by the table. It is never moved
+   by a compact nor freed until the end of the kernel, so that it can be
+   shared by all the threads and two interned symbols are identical if
+   and only if they have the same address.
+   The table is shared by all the threads and is protected by a mutex.
+   Each thread keeps a cache of the symbols it has found (may_g.symbols),
+   which remains valid until the end of the kernel.
+   The table holds at most MAY_SYMBOL_TABLE_MAX symbols: the next ones are
+   allocated in the heap like the local variables, so that a long running
+   process creating new names doesn't grow the table without bound.
+   The blocks double in size and are published with an atomic counter,
+   so that may_symbol_interned_p checks a few address ranges without
+   taking the mutex. */
+
+/* A block of memory of the interned symbols */
+struct symbol_block_s {
+  char *top, *limit;
+  long data[];
+};
+
+/* An entry of the table: the symbol and the hash of (name, domain) */
+struct symbol_entry_s {
+  size_t hash;
+  may_t symbol;
+};
+
+#define SYMBOL_BLOCK_SIZE 16384
+#define SYMBOL_BLOCK_MAX 32
+#define SYMBOL_TABLE_MIN_SIZE 256
+
+#ifdef MAY_WANT_THREAD
+# define SYMBOL_ATOMIC MAY_ATOMIC_ATTR
+#else
+# define SYMBOL_ATOMIC
+#endif
+
+static struct {
+  struct symbol_entry_s *tab;
+  size_t size, num;
+  struct symbol_block_s *block[SYMBOL_BLOCK_MAX];
+  SYMBOL_ATOMIC unsigned int nblock;
+  MAY_DEF_IF_THREAD (pthread_mutex_t mutex;)
+} symbol_table = { NULL, 0, 0, {NULL}, 0
+                   MAY_DEF_IF_THREAD (, PTHREAD_MUTEX_INITIALIZER) };
+
+/* Hash of (name, domain) for the table (FNV-1a) */
+static size_t
+symbol_hash (const char str[], may_domain_e domain)
+{
+  size_t h = (size_t) 2166136261UL ^ (size_t) domain;
+  for ( ; *str != 0; str++)
+    h = (h ^ (unsigned char) *str) * 16777619UL;
+  return h;
+}
+
+MAY_INLINE int
+symbol_equal_p (may_t y, const char str[], may_domain_e domain)
+{
+  return MAY_SYMBOL (y).domain == domain && strcmp (MAY_NAME (y), str) == 0;
+}
+
+/* Allocate n bytes in the blocks of the table (with the mutex).
+   Return NULL on failure */
+static void *
+symbol_alloc (size_t n)
+{
+  unsigned int k = symbol_table.nblock;
+  struct symbol_block_s *b = k == 0 ? NULL : symbol_table.block[k-1];
+  /* MAY_STRING_SET_C may clear one word after the symbol */
+  n = MAY_ALIGNED_SIZE (n);
+  if (b == NULL || (size_t) (b->limit - b->top) < n + sizeof (long)) {
+    if (MAY_UNLIKELY (k == SYMBOL_BLOCK_MAX))
+      return NULL;
+    size_t size = MAX ((size_t) SYMBOL_BLOCK_SIZE << k, n + sizeof (long));
+    b = malloc (sizeof *b + size);
+    if (MAY_UNLIKELY (b == NULL))
+      return NULL;
+    b->top = (char*) b->data;
+    b->limit = b->top + size;
+    /* Publish the block once it is filled */
+    symbol_table.block[k] = b;
+    symbol_table.nblock = k + 1;
+  }
+  b->top += n;
+  return b->top - n;
+}
+
+/* Insert an entry in the table (which has a free slot) */
+static void
+symbol_insert (struct symbol_entry_s *tab, size_t size,
+               size_t hash, may_t symbol)
+{
+  size_t i = hash & (size-1);
+  while (tab[i].symbol != NULL)
+    i = (i+1) & (size-1);
+  tab[i].hash = hash;
+  tab[i].symbol = symbol;
+}
+
+/* Grow the table so that it is at most half full. Return 0 on failure */
+static int
+symbol_grow (void)
+{
+  size_t size = MAX (2*symbol_table.size, SYMBOL_TABLE_MIN_SIZE);
+  struct symbol_entry_s *tab = calloc (size, sizeof *tab);
+  if (MAY_UNLIKELY (tab == NULL))
+    return 0;
+  for (size_t i = 0; i < symbol_table.size; i++)
+    if (symbol_table.tab[i].symbol != NULL)
+      symbol_insert (tab, size, symbol_table.tab[i].hash,
+                     symbol_table.tab[i].symbol);
+  free (symbol_table.tab);
+  symbol_table.tab = tab;
+  symbol_table.size = size;
+  return 1;
+}
+
+/* Find or create the symbol (name, domain) in the table.
+   Return NULL if it can't be added to the table */
+static may_t
+symbol_lookup (const char str[], may_domain_e domain, size_t hash)
+{
+  may_t y = NULL;
+
+  MAY_DEF_IF_THREAD (pthread_mutex_lock (&symbol_table.mutex);)
+  if (MAY_LIKELY (symbol_table.size != 0)) {
+    size_t mask = symbol_table.size - 1;
+    for (size_t i = hash & mask; symbol_table.tab[i].symbol != NULL;
+         i = (i+1) & mask)
+      if (symbol_table.tab[i].hash == hash
+          && symbol_equal_p (symbol_table.tab[i].symbol, str, domain)) {
+        y = symbol_table.tab[i].symbol;
+        goto unlock;
+      }
+  }
+  if (MAY_UNLIKELY (symbol_table.num >= MAY_SYMBOL_TABLE_MAX)
+      || (2*(symbol_table.num+1) > symbol_table.size && !symbol_grow ()))
+    goto unlock;
+  may_size_t s = strlen (str) + 1;
+  y = symbol_alloc (MAY_NAME_SIZE (s));
+  if (MAY_UNLIKELY (y == NULL))
+    goto unlock;
+  MAY_STRING_SET_C (y, str, s, domain);
+  symbol_insert (symbol_table.tab, symbol_table.size, hash, y);
+  symbol_table.num ++;
+ unlock:
+  MAY_DEF_IF_THREAD (pthread_mutex_unlock (&symbol_table.mutex);)
+  return y;
+}
+
+/* Return the interned symbol (name, domain) */
+may_t
+may_symbol_intern (const char str[], may_domain_e domain)
+{
+  size_t hash = symbol_hash (str, domain);
+  may_t *cache = &may_g.symbols[hash % MAY_SYMBOL_CACHE_SIZE];
+  may_t y = *cache;
+
+  if (MAY_LIKELY (y != NULL && symbol_equal_p (y, str, domain)))
+    return y;
+  y = symbol_lookup (str, domain, hash);
+  /* The table is full: the symbol lives in the heap (and isn't cached) */
+  if (MAY_UNLIKELY (y == NULL))
+    return MAY_STRING_C (str, domain);
+  *cache = y;
+  return y;
+}
+
+/* Return TRUE if p is within the memory of the interned symbols.
+   The blocks are never freed nor changed before the end of the kernel,
+   so that they are read without the mutex */
+int
+may_symbol_interned_p (const void *p)
+{
+  unsigned int n = symbol_table.nblock;
+  for (unsigned int i = 0; i < n; i++) {
+    const struct symbol_block_s *b = symbol_table.block[i];
+    if ((const char*) b->data <= (const char*) p
+        && (const char*) p < b->limit)
+      return 1;
+  }
+  return 0;
+}
+
+/* Free the interned symbols (at the end of the kernel) */
+void
+may_symbol_clear (void)
+{
+  MAY_DEF_IF_THREAD (pthread_mutex_lock (&symbol_table.mutex);)
+  unsigned int n = symbol_table.nblock;
+  symbol_table.nblock = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    free (symbol_table.block[i]);
+    symbol_table.block[i] = NULL;
+  }
+  free (symbol_table.tab);
+  symbol_table.tab = NULL;
+  symbol_table.size = symbol_table.num = 0;
+  MAY_DEF_IF_THREAD (pthread_mutex_unlock (&symbol_table.mutex);)
+  memset (may_g.symbols, 0, sizeof may_g.symbols);
+}
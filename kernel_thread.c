@@ -32,7 +32,7 @@ static void reset_may_global(void)
   memset (&may_g, 0, sizeof (may_g));
   may_heap_init(&may_g.Heap, may_mt_g.stack_size, 0, 0);
   /* FIXME: How to design this properly? */
-  may_g.kara.threshold = 10;
+  may_g.kara.threshold = MAY_KARA_THRESHOLD;
   may_g.kara.tmpnum = MAY_DUMMY;
 }
 
@@ -63,18 +63,31 @@ static void *may_mt_thread_main (void *arg)
     }
     pthread_mutex_unlock(&mc->mutex);
 
-    /* Disable error handling and string cache ***after*** master thread
+    /* Disable error handling ***after*** master thread
        set may_g.frame with its own may_g.frame */
     may_g.frame.next = NULL;
     may_g.frame.error_handler = NULL;
-    may_g.frame.cache_set_str_i = 0;
-    may_g.frame.cache_set_str_n = 0;
 
-    /* Execute thread */
-    (*mc->func) (mc->data);
+    /* Allocate the copy of the MAY stack thread before the job
+       (which may exhaust it), and set the memory budget of the job */
+    struct may_heap_s *heap = may_alloc(sizeof ( struct may_heap_s));
+    size_t memlimit = may_g.budget.memlimit;
+    may_g.budget.memlimit = 0;
+    if (memlimit != 0)
+      may_kernel_memlimit (memlimit);
+
+    /* Execute thread: its error is thrown again by the synchronization */
+    volatile int error = 0;
+    const char *error_str = NULL;
+    MAY_TRY {
+      (*mc->func) (mc->data);
+    } MAY_CATCH {
+      error = MAY_ERROR;
+      may_error_get (NULL, &error_str);
+    } MAY_ENDTRY;
+    may_kernel_memlimit (0);
 
     /* Save MAY stack thread within the heap */
-    struct may_heap_s *heap = may_alloc(sizeof ( struct may_heap_s));
     memcpy (heap, &may_g.Heap, sizeof ( struct may_heap_s));
 
     /* Unwork thread */
@@ -84,11 +97,15 @@ static void *may_mt_thread_main (void *arg)
     /* Enter Signal terminaison block */
     pthread_mutex_lock (&may_mt_g.master_mutex);
 
-    /* Chain the heap of this Thread into the list of the threads
-       to be free after the compact operation of the master thread */
-    struct may_heap_s *previous =  MAY_MARK_HEAP_TO_FREE(mc->mark);
-    MAY_MARK_HEAP_TO_FREE(mc->mark) = heap;
-    heap->next_heap_to_free = previous;
+    /* Chain the heap of this Thread into its block: they are given
+       to the mark of the block by the synchronization, to be free
+       after the compact operation of the master thread */
+    heap->next_heap_to_free = mc->block->heap;
+    mc->block->heap = heap;
+    if (error != 0 && mc->block->error == 0) {
+      mc->block->error = error;
+      mc->block->error_str = error_str;
+    }
 
     /* Signal terminaison */
     *mc->num_spawn_ptr += 1;
@@ -202,6 +219,33 @@ void may_spawn_start(may_spawn_block_t block, may_mark_t mark)
   block->num_spawn = 0;
   block->num_terminated_spawn = 0;
   block->mark = &mark[0];
+  block->heap = NULL;
+  block->next = NULL;
+  block->error = 0;
+  block->error_str = NULL;
+}
+
+/* Register a job of the block given to the worker thread mc:
+   it gets the budget of the computation of the current thread */
+static void
+spawn_register (may_mt_comm_t *mc, struct may_spawn_block_s *block)
+{
+  struct may_budget_s *b = &mc->may_g_ref->budget;
+
+  if (block->num_spawn++ == 0) {
+    block->seq = ++may_g.budget.spawn_seq;
+    block->next = may_g.budget.spawn;
+    may_g.budget.spawn = block;
+  }
+  mc->num_spawn_ptr = &block->num_terminated_spawn;
+  mc->block = block;
+  b->active = may_g.budget.active;
+  b->timeout = may_g.budget.timeout;
+  b->deadline = may_g.budget.deadline;
+  b->cancel = may_g.budget.cancel;
+  /* What remains of the memory budget of the current thread */
+  b->memlimit = may_g.budget.limit == NULL ? 0
+    : MAX ((size_t) (may_g.Heap.limit - may_g.Heap.top), (size_t) 1);
 }
 
 /* Launch (or not) a new parallel job to compute func(data) */
@@ -223,9 +267,7 @@ void may_spawn (may_spawn_block_t block, void (*func)(void *), void *data)
       mc->working = THREAD_RUNNING;
       mc->func = func;
       mc->data = data;
-      mc->num_spawn_ptr = &block->num_terminated_spawn;
-      mc->mark   = block->mark;
-      block->num_spawn +=1;
+      spawn_register (mc, block);
 
       /* Setup frame of the thread:
          intmaxsize, prec, rnd_mode, etc... */
@@ -243,8 +285,13 @@ void may_spawn (may_spawn_block_t block, void (*func)(void *), void *data)
   (*func) (data);
 }
 
-void may_spawn_sync(may_spawn_block_t block)
+/* Wait for the jobs of the block, and remove it from the spawn blocks
+   of the thread */
+static void
+spawn_wait (struct may_spawn_block_s *block)
 {
+  struct may_spawn_block_s **p;
+
   /* If the number of spawns is greated than the number
      of terminated spawns, some spawns are still working.
      So wait for terminaison */
@@ -257,6 +304,53 @@ void may_spawn_sync(may_spawn_block_t block)
     }
     pthread_mutex_unlock (&may_mt_g.master_mutex);
   }
+  if (block->num_spawn != 0) {
+    for (p = &may_g.budget.spawn; *p != block; p = &(*p)->next)
+      MAY_ASSERT (*p != NULL);
+    *p = block->next;
+  }
+  block->num_spawn = 0;
+  block->num_terminated_spawn = 0;
+}
+
+void may_spawn_sync(may_spawn_block_t block)
+{
+  spawn_wait (block);
+
+  /* Give the heaps of the jobs to the mark */
+  if (block->heap != NULL) {
+    struct may_heap_s *last = block->heap;
+    while (last->next_heap_to_free != NULL)
+      last = last->next_heap_to_free;
+    last->next_heap_to_free = MAY_MARK_HEAP_TO_FREE (block->mark);
+    MAY_MARK_HEAP_TO_FREE (block->mark) = block->heap;
+    block->heap = NULL;
+  }
+
+  /* Throw again the error of a job */
+  if (MAY_UNLIKELY (block->error != 0)) {
+    int error = block->error;
+    block->error = 0;
+    if (error == MAY_INTERRUPT_ERR)
+      may_budget_throw (block->error_str);
+    may_error_throw (error, block->error_str);
+  }
+}
+
+/* Wait for the jobs of the spawn blocks of the thread added after
+   the sequence number seq, and free their memory (a throw leaves them) */
+void may_spawn_unwind(unsigned long seq)
+{
+  while (may_g.budget.spawn != NULL && may_g.budget.spawn->seq > seq) {
+    struct may_spawn_block_s *block = may_g.budget.spawn;
+    spawn_wait (block);
+    while (block->heap != NULL) {
+      struct may_heap_s *next = block->heap->next_heap_to_free;
+      may_heap_clear (block->heap);
+      block->heap = next;
+    }
+    block->error = 0;
+  }
 }
 
 void may_spawn_for(may_mark_t mark,
@@ -297,9 +391,7 @@ void may_spawn_for(may_mark_t mark,
       mc->data4for.end   = var + step;
       mc->data4for.data  = data;
       mc->data = &mc->data4for.data;
-      mc->num_spawn_ptr = &block->num_terminated_spawn;
-      mc->mark   = block->mark;
-      block->num_spawn +=1;
+      spawn_register (mc, block);
 
       /* Setup frame of the thread:
          intmaxsize, prec, rnd_mode, etc... */
@@ -378,9 +470,7 @@ may_spawn_for_reduce (may_mark_t mark, may_int_t begin, may_int_t end,
       mc->data4for.thread_reduced_var = thread_reduced_var_tab +
         (real_nb_core++ * size_global_reduced_var);
       mc->data = &mc->data4for.data;
-      mc->num_spawn_ptr = &block->num_terminated_spawn;
-      mc->mark   = block->mark;
-      block->num_spawn +=1;
+      spawn_register (mc, block);
 
       /* Setup frame of the thread:
          intmaxsize, prec, rnd_mode, etc... */
@@ -68,10 +68,15 @@ typedef enum {
 typedef long may_int_t;
 
 /* Define a block of synchro for multiples threads */
-typedef struct {
+typedef struct may_spawn_block_s {
   int num_spawn;            /* Number of spawned threads */
   int num_terminated_spawn; /* Number of terminated threads */
   union may_mark_s *mark;   /* Mark to give the memory after completion*/
+  struct may_heap_s *heap;  /* Heaps of the terminated threads */
+  struct may_spawn_block_s *next; /* Next block with spawned threads */
+  unsigned long seq;        /* Sequence number of the block in the thread */
+  int error;                /* First error thrown by a thread (or 0) */
+  const char *error_str;    /* and its description */
 } may_spawn_block_t[1];
 
 /* Define the data transferred from a thread to another */
@@ -90,7 +95,7 @@ typedef struct {
   pthread_cond_t  cond;
   may_workstate_t working;
   volatile int * num_spawn_ptr;
-  union may_mark_s *mark;
+  struct may_spawn_block_s *block;
   struct may_globals_s *may_g_ref;
   void * data;
   void (*func) (void *data);
@@ -115,6 +120,7 @@ extern may_mt_t may_mt_g;
 extern void may_spawn_start(may_spawn_block_t, may_mark_t);
 extern void may_spawn (may_spawn_block_t, void (*)(void *), void *);
 extern void may_spawn_sync(may_spawn_block_t);
+extern void may_spawn_unwind(unsigned long);
 extern void may_thread_init(int,size_t);
 extern int  may_thread_quit(void);
 extern void may_spawn_for(may_mark_t,
@@ -204,16 +210,14 @@ extern void may_spawn_for_reduce(may_mark_t, may_int_t, may_int_t,
    ownerchip of the memory allocated by the threads after the synchronization point */
 #define MAY_SPAWN_BLOCK(_block, _mark)                              \
   may_spawn_block_t (_block) ;                                      \
-  (_block)[0].num_spawn = 0 ;                                       \
-  (_block)[0].num_terminated_spawn = 0;                             \
-  (_block)[0].mark = &(_mark)[0];
+  may_spawn_start ((_block), (_mark));
 /* NOTE: Can't set HEAP(mark) to NULL. One mark may have multiple block */
 
 /* Synchronize all launched worker threads and continue
-   when all the work of the worker threads is finished */
-#define MAY_SPAWN_SYNC(_block)                                     \
-  if ((_block)[0].num_spawn != (_block)[0].num_terminated_spawn)   \
-    may_spawn_sync(_block)
+   when all the work of the worker threads is finished.
+   The block is reset so that it can be synchronized again.
+   The first error thrown by a worker thread is thrown again */
+#define MAY_SPAWN_SYNC(_block) may_spawn_sync(_block)
 
 /* Perform a for construction of the variable 'var', an integer,
    from 'begin' to 'end' (excluded) with the 'core' block.
@@ -337,7 +341,10 @@ extern void may_spawn_for_reduce(may_mark_t, may_int_t, may_int_t,
 /* Measure:
    REDUCE = + over long long ==> 10000
    REDUCE = GCD over may ==> 300
-   More likely to have may operations with theses macros... */
-#define MAY_SPAWN_FOR_TH 500
+   More likely to have may operations with theses macros...
+   'make tune' measures it on the build machine (See t-tune.c) */
+#ifndef MAY_SPAWN_FOR_TH
+# define MAY_SPAWN_FOR_TH 500
+#endif
 
 #endif
@@ -171,3 +171,143 @@ may_list_sort (may_list_t list, int (*cmp) (const may_t *, const may_t *))
   MAY_LOG_FUNC(("size=%d", (int) list->size));
   qsort (list->base, list->size, sizeof (may_t), (int (*)(const void*, const void*)) cmp);
 }
+
+/***************************************************************************/
+
+/* Return the number of entries of the index table for n elements:
+   a power of 2 with a load factor of at most 1/2 */
+static MAY_REGPARM may_size_t
+hset_table_size (may_size_t n)
+{
+  may_size_t s = 16;
+  while (s < 2*n)
+    s <<= 1;
+  return s;
+}
+
+/* Build a new index table able to store n elements
+   and fill it with the elements of the list */
+static void
+hset_rehash (may_hset_t set, may_size_t n)
+{
+  may_size_t i, j, s;
+
+  MAY_LOG_FUNC(("size=%d n=%d", (int) set->list->size, (int) n));
+
+  s = hset_table_size (n);
+  set->mask  = s - 1;
+  set->index = may_alloc (s * sizeof (may_size_t));
+  memset (set->index, 0, s * sizeof (may_size_t));
+  for (i = 0; i < set->list->size; i++) {
+    for (j = MAY_HASH (set->list->base[i]) & set->mask;
+         set->index[j] != 0;
+         j = (j+1) & set->mask);
+    set->index[j] = i + 1;
+  }
+}
+
+/* Return the entry of the index table associated to x:
+   either the one which references x or the free one where x shall go */
+static MAY_REGPARM may_size_t *
+hset_lookup (may_hset_t set, may_t x)
+{
+  may_size_t j, k;
+
+  for (j = MAY_HASH (x) & set->mask;
+       (k = set->index[j]) != 0;
+       j = (j+1) & set->mask)
+    if (may_identical (x, set->list->base[k-1]) == 0)
+      break;
+  return &set->index[j];
+}
+
+void
+may_hset_init (may_hset_t set, may_size_t size)
+{
+  MAY_LOG_FUNC(("size=%d", (int) size));
+  may_list_init (set->list, 0);
+  hset_rehash (set, size);
+}
+
+may_t
+may_hset_quit (may_hset_t set)
+{
+  return may_list_quit (set->list);
+}
+
+void
+may_hset_reset (may_hset_t set)
+{
+  MAY_LOG_FUNC(("size=%d", (int) set->list->size));
+  may_list_resize (set->list, 0);
+  memset (set->index, 0, (set->mask + 1) * sizeof (may_size_t));
+}
+
+/* Add x in 'set' iff it is not in 'set'.
+   Return the index of x in the set */
+may_size_t
+may_hset_push_back (may_hset_t set, may_t x)
+{
+  may_size_t *p, n;
+
+  MAY_LOG_FUNC(("size=%d x=%Y", (int) set->list->size, x));
+
+  p = hset_lookup (set, x);
+  if (*p != 0)
+    return *p - 1;
+  n = set->list->size;
+  may_list_push_back (set->list, x);
+  if (MAY_UNLIKELY (2*(n+1) > set->mask + 1))
+    hset_rehash (set, n+1);
+  else
+    *p = n + 1;
+  return n;
+}
+
+/* Return true and set *index to the index of x in set if x is in set,
+   false otherwise */
+bool
+may_hset_find (may_size_t *index, may_hset_t set, may_t x)
+{
+  may_size_t k;
+
+  MAY_LOG_FUNC(("size=%d x=%Y", (int) set->list->size, x));
+
+  k = *hset_lookup (set, x);
+  if (k == 0)
+    return false;
+  *index = k - 1;
+  return true;
+}
+
+may_t
+may_hset_at (may_hset_t set, may_size_t i)
+{
+  return may_list_at (set->list, i);
+}
+
+may_size_t
+may_hset_get_size (may_hset_t set)
+{
+  return may_list_get_size (set->list);
+}
+
+/* The hashes of the elements are kept by the compaction,
+   and so are their indexes: only the index table needs to be
+   reallocated above the compacted list */
+void
+may_hset_compact (may_mark_t mark, may_hset_t set)
+{
+  MAY_LOG_FUNC(("size=%d", (int) set->list->size));
+  may_list_compact (mark, set->list);
+  hset_rehash (set, set->list->size);
+}
+
+void
+may_hset_swap (may_hset_t set1, may_hset_t set2)
+{
+  may_hset_t temp;
+  memcpy(temp, set1, sizeof temp);
+  memcpy(set1, set2, sizeof temp);
+  memcpy(set2, temp, sizeof temp);
+}
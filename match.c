@@ -21,21 +21,19 @@ MA 02110-1301, USA. */
 #include "may-impl.h"
 
 /* If p is an identifier, check if p is a wildcard, and return
-   its index if it is */
+   its index if it is (saturated so that index+1 fits in an int) */
 MAY_INLINE int
 get_index_of_wild (may_t p)
 {
   const char *name;
-  char *end;
-  int ret;
+  unsigned long ret;
 
   MAY_ASSERT (MAY_TYPE (p) == MAY_STRING_T);
   name = MAY_NAME (p);
-  if (*name != '$')
+  if (*name++ != '$' || !isdigit ((unsigned char) *name))
     return -1;
-  name ++;
-  ret = strtol (name, &end, 10);
-  return end == name ? -1 : ret;
+  ret = strtoul (name, NULL, 10);
+  return ret < INT_MAX ? (int) ret : INT_MAX - 1;
 }
 
 int
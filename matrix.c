@@ -0,0 +1,923 @@
+/* This file is part of the MAYLIB libray.
+   Copyright 2007-2018 Patrick Pelissier
+
+This Library is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This Library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with th Library; see the file COPYING.LESSER.txt.
+If not, write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston,
+MA 02110-1301, USA. */
+
+#include "may-impl.h"
+
+/* A matrix is stored by rows in a contiguous array of may_t allocated
+   in the heap: the entry (i,j) is data[i*col+j].
+   The eliminations work on a copy of the entries and access the rows
+   through a permutation array so that swapping two rows is cheap.
+   If all the entries are pure numbers, they are performed over
+   arrays of mpz_t (integers and rationals) or mpfr_t (floats). */
+
+/* Domain of the entries of a matrix, used to select the algorithm */
+typedef enum {
+  MAT_SYMBOLIC, MAT_INTEGER, MAT_FLOAT
+} mat_domain_e;
+
+/* Number of elimination steps between two compactions */
+#define MAT_COMPACT_STEP 10
+
+/***************************************************************************/
+/*                         Basic functions                                 */
+/***************************************************************************/
+
+void
+may_mat_init (may_mat_ptr c, unsigned int row, unsigned int col)
+{
+  MAY_LOG_FUNC (("row=%u col=%u", row, col));
+  c->row = c->col = 0;
+  c->alloc = 0;
+  c->data = NULL;
+  may_mat_resize (c, row, col);
+}
+
+/* Change the dimension of the matrix.
+   If the dimension changes, all the entries are set to 0 */
+void
+may_mat_resize (may_mat_ptr c, unsigned int row, unsigned int col)
+{
+  size_t i, n = (size_t) row*col;
+
+  MAY_LOG_FUNC (("row=%u col=%u", row, col));
+
+  if (c->row == row && c->col == col)
+    return;
+  if (c->alloc < n) {
+    c->data = c->data == NULL ? may_alloc (n * sizeof (may_t))
+      : may_realloc (c->data, c->alloc * sizeof (may_t), n * sizeof (may_t));
+    c->alloc = n;
+  }
+  for (i = 0; i < n; i++)
+    c->data[i] = MAY_ZERO;
+  c->row = row;
+  c->col = col;
+}
+
+unsigned int
+(may_mat_row) (may_mat_srcptr c)
+{
+  return c->row;
+}
+
+unsigned int
+(may_mat_col) (may_mat_srcptr c)
+{
+  return c->col;
+}
+
+may_t
+(may_mat_at) (may_mat_srcptr c, unsigned int i, unsigned int j)
+{
+  MAY_ASSERT (i < c->row && j < c->col);
+  return c->data[(size_t) i*c->col+j];
+}
+
+void
+(may_mat_set_at) (may_mat_ptr c, unsigned int i, unsigned int j, may_t x)
+{
+  MAY_ASSERT (i < c->row && j < c->col);
+  c->data[(size_t) i*c->col+j] = x;
+}
+
+void
+may_mat_set (may_mat_ptr c, may_mat_srcptr a)
+{
+  if (c == a)
+    return;
+  may_mat_resize (c, a->row, a->col);
+  memcpy (c->data, a->data, (size_t) a->row*a->col*sizeof (may_t));
+}
+
+void
+may_mat_swap (may_mat_ptr a, may_mat_ptr b)
+{
+  struct may_mat_s temp = *a;
+  *a = *b;
+  *b = temp;
+}
+
+void
+may_mat_compact (may_mark_t mark, may_mat_ptr c)
+{
+  size_t n = (size_t) c->row*c->col;
+  MAY_LOG_FUNC (("row=%u col=%u", c->row, c->col));
+  if (MAY_UNLIKELY (n == 0)) {
+    may_compact (mark, NULL);
+    c->data = NULL;
+    c->alloc = 0;
+    return;
+  }
+  c->data = may_compact_v (mark, n, c->data);
+  c->alloc = n;
+}
+
+/* Set the matrix from a list of rows, each row being a list of the same size */
+void
+may_mat_set_list (may_mat_ptr c, may_t list)
+{
+  may_size_t i, j, row, col;
+
+  list = may_eval (list);
+  if (MAY_TYPE (list) != MAY_LIST_T)
+    MAY_THROW (MAY_INVALID_MAT_SIZE_ERR);
+  row = MAY_NODE_SIZE (list);
+  col = MAY_TYPE (MAY_AT (list, 0)) == MAY_LIST_T ? MAY_NODE_SIZE (MAY_AT (list, 0)) : 0;
+  for (i = 0; i < row; i++)
+    if (MAY_TYPE (MAY_AT (list, i)) != MAY_LIST_T
+        || MAY_NODE_SIZE (MAY_AT (list, i)) != col)
+      MAY_THROW (MAY_INVALID_MAT_SIZE_ERR);
+
+  may_mat_resize (c, row, col);
+  for (i = 0; i < row; i++)
+    for (j = 0; j < col; j++)
+      c->data[i*col+j] = MAY_AT (MAY_AT (list, i), j);
+}
+
+/* Return the matrix as a list of rows */
+may_t
+may_mat_get_list (may_mat_srcptr a)
+{
+  unsigned int i;
+  may_t list;
+
+  if (MAY_UNLIKELY (a->row == 0 || a->col == 0))
+    MAY_THROW (MAY_INVALID_MAT_SIZE_ERR);
+  MAY_RECORD ();
+  list = MAY_NODE_C (MAY_LIST_T, a->row);
+  for (i = 0; i < a->row; i++)
+    MAY_SET_AT (list, i, may_list_vc (a->col, &a->data[(size_t) i*a->col]));
+  MAY_RET_EVAL (list);
+}
+
+void
+may_mat_fill_y (may_mat_ptr c, may_t x)
+{
+  size_t i, n = (size_t) c->row*c->col;
+  for (i = 0; i < n; i++)
+    c->data[i] = x;
+}
+
+void
+may_mat_identity (may_mat_ptr c, unsigned int n, may_t x)
+{
+  may_mat_resize (c, n, n);
+  may_mat_fill_y (c, MAY_ZERO);
+  for (unsigned int i = 0; i < n; i++)
+    c->data[(size_t) i*n+i] = x;
+}
+
+/***************************************************************************/
+/*                         Entrywise functions                             */
+/***************************************************************************/
+
+/* Apply f on each entry of a (and b if not NULL) */
+static void
+mat_apply (may_mat_ptr c, may_mat_srcptr a, may_mat_srcptr b, may_t y,
+           may_t (*f) (may_t, may_t))
+{
+  size_t n = (size_t) a->row*a->col;
+  may_mark_t mark;
+
+  if (b != NULL && (a->row != b->row || a->col != b->col))
+    MAY_THROW (MAY_DIMENSION_ERR);
+  if (MAY_UNLIKELY (n == 0)) {
+    may_mat_resize (c, a->row, a->col);
+    return;
+  }
+
+  may_mark (mark);
+  may_t *tab = may_alloc (n * sizeof (may_t));
+  const may_t *pa = a->data, *pb = b == NULL ? NULL : b->data;
+  MAY_SPAWN_FOR (mark, i, 0, (may_int_t) n, (tab, pa, pb, y, f), {
+      tab[i] = (*f) (pa[i], pb == NULL ? y : pb[i]);
+    });
+  may_mat_resize (c, a->row, a->col);
+  memcpy (c->data, tab, n * sizeof (may_t));
+  may_mat_compact (mark, c);
+}
+
+static may_t
+mat_eval (may_t x, may_t y)
+{
+  UNUSED (y);
+  return may_eval (x);
+}
+
+void
+may_mat_eval (may_mat_ptr c, may_mat_srcptr a)
+{
+  mat_apply (c, a, NULL, NULL, mat_eval);
+}
+
+void
+may_mat_add (may_mat_ptr c, may_mat_srcptr a, may_mat_srcptr b)
+{
+  mat_apply (c, a, b, NULL, may_add);
+}
+
+void
+may_mat_sub (may_mat_ptr c, may_mat_srcptr a, may_mat_srcptr b)
+{
+  mat_apply (c, a, b, NULL, may_sub);
+}
+
+void
+may_mat_mul_y (may_mat_ptr c, may_mat_srcptr a, may_t y)
+{
+  mat_apply (c, a, NULL, may_eval (y), may_mul);
+}
+
+/***************************************************************************/
+/*                         Structural functions                            */
+/***************************************************************************/
+
+void
+may_mat_transpose (may_mat_ptr c, may_mat_srcptr a)
+{
+  unsigned int i, j, row = a->row, col = a->col;
+  may_mark_t mark;
+
+  may_mark (mark);
+  may_t *tab = may_alloc ((size_t) row*col*sizeof (may_t) + 1);
+  for (i = 0; i < row; i++)
+    for (j = 0; j < col; j++)
+      tab[(size_t) j*row+i] = a->data[(size_t) i*col+j];
+  may_mat_resize (c, col, row);
+  memcpy (c->data, tab, (size_t) row*col*sizeof (may_t));
+  may_mat_compact (mark, c);
+}
+
+/* Extract the submatrix [minrow, maxrow] x [mincol, maxcol] (included) of a */
+void
+may_mat_extract (may_mat_ptr c, may_mat_srcptr a,
+                 unsigned int minrow, unsigned int maxrow,
+                 unsigned int mincol, unsigned int maxcol)
+{
+  unsigned int i, row, col;
+  may_mark_t mark;
+
+  if (maxrow >= a->row || maxcol >= a->col || minrow > maxrow || mincol > maxcol)
+    MAY_THROW (MAY_DIMENSION_ERR);
+  row = maxrow-minrow+1;
+  col = maxcol-mincol+1;
+
+  may_mark (mark);
+  may_t *tab = may_alloc ((size_t) row*col*sizeof (may_t));
+  for (i = 0; i < row; i++)
+    memcpy (&tab[(size_t) i*col], &a->data[(size_t) (minrow+i)*a->col+mincol],
+            col * sizeof (may_t));
+  may_mat_resize (c, row, col);
+  memcpy (c->data, tab, (size_t) row*col*sizeof (may_t));
+  may_mat_compact (mark, c);
+}
+
+/* Set c to the matrix [a | b] */
+void
+may_mat_augment (may_mat_ptr c, may_mat_srcptr a, may_mat_srcptr b)
+{
+  unsigned int i, row = a->row, col = a->col+b->col;
+  may_mark_t mark;
+
+  if (a->row != b->row)
+    MAY_THROW (MAY_DIMENSION_ERR);
+
+  may_mark (mark);
+  may_t *tab = may_alloc ((size_t) row*col*sizeof (may_t) + 1);
+  for (i = 0; i < row; i++) {
+    memcpy (&tab[(size_t) i*col], &a->data[(size_t) i*a->col], a->col * sizeof (may_t));
+    memcpy (&tab[(size_t) i*col+a->col], &b->data[(size_t) i*b->col], b->col * sizeof (may_t));
+  }
+  may_mat_resize (c, row, col);
+  memcpy (c->data, tab, (size_t) row*col*sizeof (may_t));
+  may_mat_compact (mark, c);
+}
+
+may_t
+may_mat_trace (may_mat_srcptr a)
+{
+  if (a->row != a->col)
+    MAY_THROW (MAY_DIMENSION_ERR);
+  MAY_RECORD ();
+  may_t s = MAY_ZERO;
+  for (unsigned int i = 0; i < a->row; i++)
+    s = may_addinc_c (s, a->data[(size_t) i*a->col+i]);
+  MAY_RET_EVAL (s);
+}
+
+/***************************************************************************/
+/*                         Numerical fast path                             */
+/***************************************************************************/
+
+/* Return the domain of the n evaluated entries of tab */
+static mat_domain_e
+mat_domain (size_t n, const may_t *tab)
+{
+  mat_domain_e d = MAT_INTEGER;
+
+  /* The integers are computed modulo intmod */
+  if (may_g.frame.intmod != NULL)
+    return MAT_SYMBOLIC;
+  for (size_t i = 0; i < n; i++) {
+    int t = MAY_TYPE (tab[i]);
+    if (t == MAY_FLOAT_T)
+      d = MAT_FLOAT;
+    else if (t != MAY_INT_T && t != MAY_RAT_T)
+      return MAT_SYMBOLIC;
+  }
+  return d;
+}
+
+/* Convert the n x m integer or rational entries of tab into integers:
+   each row is multiplied by the lcm of the denominators of the row,
+   which is stored in scale (if not NULL) */
+static mpz_t *
+mat_get_z (mpz_t *scale, unsigned int n, unsigned int m, const may_t *tab)
+{
+  mpz_t *z = may_alloc ((size_t) n*m*sizeof (mpz_t) + 1);
+  mpz_t l;
+
+  mpz_init (l);
+  for (unsigned int i = 0; i < n; i++) {
+    const may_t *row = &tab[(size_t) i*m];
+    mpz_t *zrow = &z[(size_t) i*m];
+    mpz_set_ui (l, 1);
+    for (unsigned int j = 0; j < m; j++)
+      if (MAY_TYPE (row[j]) == MAY_RAT_T)
+        mpz_lcm (l, l, mpq_denref (MAY_RAT (row[j])));
+    for (unsigned int j = 0; j < m; j++) {
+      mpz_init (zrow[j]);
+      if (MAY_TYPE (row[j]) == MAY_INT_T)
+        mpz_mul (zrow[j], MAY_INT (row[j]), l);
+      else {
+        mpz_divexact (zrow[j], l, mpq_denref (MAY_RAT (row[j])));
+        mpz_mul (zrow[j], zrow[j], mpq_numref (MAY_RAT (row[j])));
+      }
+    }
+    if (scale != NULL)
+      mpz_init_set (scale[i], l);
+  }
+  return z;
+}
+
+/* Return num/den as a rational */
+static may_t
+mat_set_zz (mpz_srcptr num, mpz_srcptr den)
+{
+  mpq_t q;
+  mpq_init (q);
+  mpz_set (mpq_numref (q), num);
+  mpz_set (mpq_denref (q), den);
+  mpq_canonicalize (q);
+  return may_set_q (q);
+}
+
+/* Fraction-free (Bareiss) forward elimination of the n x m integer matrix z
+   (whose rows are accessed through perm) using the first npiv columns as
+   pivot columns. Return the rank and update sign for each row swap */
+static unsigned int
+echelon_z (mpz_t *z, unsigned int *perm, unsigned int n, unsigned int m,
+           unsigned int npiv, int *sign, may_mark_t mark)
+{
+  unsigned int r = 0, c, i, p, prev_col = 0;
+
+  UNUSED (mark);
+  for (c = 0; c < npiv && r < n; c++) {
+    /* Search for the smallest non zero pivot */
+    size_t best = (size_t) -1;
+    for (p = n, i = r; i < n; i++) {
+      mpz_srcptr x = z[(size_t) perm[i]*m+c];
+      if (mpz_sgn (x) != 0 && mpz_size (x) < best) {
+        best = mpz_size (x);
+        p = i;
+      }
+    }
+    if (p == n)
+      continue;
+    if (p != r) {
+      swap (perm[p], perm[r]);
+      *sign = -*sign;
+    }
+    mpz_t *prow = &z[(size_t) perm[r]*m];
+    mpz_t *prev = r == 0 ? NULL : &z[(size_t) perm[r-1]*m+prev_col];
+    may_int_t w = m-c-1, cnt = (may_int_t) (n-r-1) * w;
+    /* Aij = (Aij*Arc - Aic*Arj) / prev */
+    MAY_SPAWN_FOR (mark, t, 0, cnt, (z, perm, prow, prev, r, c, m, w), {
+        mpz_t *ri = &z[(size_t) perm[r+1+t/w]*m];
+        unsigned int j = c+1+t%w;
+        mpz_mul (ri[j], ri[j], prow[c]);
+        mpz_submul (ri[j], ri[c], prow[j]);
+        if (prev != NULL)
+          mpz_divexact (ri[j], ri[j], *prev);
+      });
+    for (i = r+1; i < n; i++)
+      mpz_set_ui (z[(size_t) perm[i]*m+c], 0);
+    prev_col = c;
+    r++;
+  }
+  return r;
+}
+
+/* Gauss elimination with partial pivoting of the n x m float matrix f */
+static unsigned int
+echelon_fr (mpfr_t *f, unsigned int *perm, unsigned int n, unsigned int m,
+            unsigned int npiv, int *sign, may_mark_t mark)
+{
+  unsigned int r = 0, c, i, p;
+  mp_rnd_t rnd = may_g.frame.rnd_mode;
+
+  UNUSED (mark);
+  for (c = 0; c < npiv && r < n; c++) {
+    /* Search for the greatest pivot */
+    for (p = n, i = r; i < n; i++) {
+      mpfr_srcptr x = f[(size_t) perm[i]*m+c];
+      if (!mpfr_zero_p (x)
+          && (p == n || mpfr_cmpabs (x, f[(size_t) perm[p]*m+c]) > 0))
+        p = i;
+    }
+    if (p == n)
+      continue;
+    if (p != r) {
+      swap (perm[p], perm[r]);
+      *sign = -*sign;
+    }
+    mpfr_t *prow = &f[(size_t) perm[r]*m];
+    /* Replace Aic by Aic/Arc */
+    for (i = r+1; i < n; i++)
+      mpfr_div (f[(size_t) perm[i]*m+c], f[(size_t) perm[i]*m+c], prow[c], rnd);
+    may_int_t w = m-c-1, cnt = (may_int_t) (n-r-1) * w;
+    /* Aij = Aij - Aic/Arc * Arj */
+    MAY_SPAWN_FOR (mark, t, 0, cnt, (f, perm, prow, r, c, m, w, rnd), {
+        mpfr_t *ri = &f[(size_t) perm[r+1+t/w]*m];
+        unsigned int j = c+1+t%w;
+        mpfr_fms (ri[j], ri[c], prow[j], ri[j], rnd);
+        mpfr_neg (ri[j], ri[j], rnd);
+      });
+    for (i = r+1; i < n; i++)
+      mpfr_set_ui (f[(size_t) perm[i]*m+c], 0, rnd);
+    r++;
+  }
+  return r;
+}
+
+static mpfr_t *
+mat_get_fr (unsigned int n, unsigned int m, const may_t *tab)
+{
+  mpfr_t *f = may_alloc ((size_t) n*m*sizeof (mpfr_t) + 1);
+  for (size_t i = 0; i < (size_t) n*m; i++) {
+    mpfr_init2 (f[i], may_g.frame.prec);
+    switch (MAY_TYPE (tab[i])) {
+    case MAY_INT_T:
+      mpfr_set_z (f[i], MAY_INT (tab[i]), may_g.frame.rnd_mode);
+      break;
+    case MAY_RAT_T:
+      mpfr_set_q (f[i], MAY_RAT (tab[i]), may_g.frame.rnd_mode);
+      break;
+    default:
+      MAY_ASSERT (MAY_TYPE (tab[i]) == MAY_FLOAT_T);
+      mpfr_set (f[i], MAY_FLOAT (tab[i]), may_g.frame.rnd_mode);
+      break;
+    }
+  }
+  return f;
+}
+
+/***************************************************************************/
+/*                         Symbolic Bareiss                                */
+/***************************************************************************/
+
+/* Return num/den, assuming den divides num.
+   If the exact division fails (den is not a polynomial), return the fraction */
+static may_t
+exact_div (may_t num, may_t den)
+{
+  num = may_expand (may_eval (num));
+  if (MAY_ONE_P (den) || MAY_ZERO_P (num))
+    return num;
+  may_t q = may_divexact (num, den);
+  if (MAY_UNLIKELY (q == NULL))
+    q = may_eval (may_div_c (num, den));
+  return q;
+}
+
+/* Return num/den, reduced by their gcd */
+static may_t
+reduce_div (may_t num, may_t den)
+{
+  if (MAY_ONE_P (den) || MAY_ZERO_P (num))
+    return num;
+  may_t q = may_divexact (num, den);
+  if (q != NULL)
+    return q;
+  may_t g = may_gcd2 (num, den);
+  if (!MAY_ONE_P (g)) {
+    may_t n2 = may_divexact (num, g), d2 = may_divexact (den, g);
+    if (n2 != NULL && d2 != NULL)
+      num = n2, den = d2;
+  }
+  return may_eval (may_div_c (num, den));
+}
+
+/* Return (Aij*Arc - Aic*Arj) / prev */
+static may_t
+bareiss_step (may_t aij, may_t arc, may_t aic, may_t arj, may_t prev)
+{
+  may_t num;
+  if (MAY_ZERO_P (aic)) {
+    if (MAY_ZERO_P (aij))
+      return aij;
+    num = may_mul_c (aij, arc);
+  } else
+    num = may_sub_c (may_mul_c (aij, arc), may_mul_c (aic, arj));
+  return exact_div (num, prev);
+}
+
+/* Convert the n x m evaluated entries of tab into expanded polynomials:
+   each row is multiplied by the lcm of the denominators of the row,
+   which is stored in scale (if not NULL) */
+static may_t *
+mat_get_poly (may_t *scale, unsigned int n, unsigned int m, const may_t *tab)
+{
+  may_t *p = may_alloc ((size_t) n*m*sizeof (may_t) + 1);
+  may_t num[m], den[m];
+
+  for (unsigned int i = 0; i < n; i++) {
+    const may_t *row = &tab[(size_t) i*m];
+    int is_one = 1;
+    for (unsigned int j = 0; j < m; j++) {
+      may_comdenom (&num[j], &den[j], row[j]);
+      is_one &= MAY_ONE_P (den[j]);
+    }
+    may_t l = is_one ? MAY_ONE : may_lcm (m, den);
+    for (unsigned int j = 0; j < m; j++) {
+      may_t f = MAY_ONE_P (den[j]) ? l : exact_div (l, den[j]);
+      p[(size_t) i*m+j] = may_expand (may_eval (may_mul_c (num[j], f)));
+    }
+    if (scale != NULL)
+      scale[i] = l;
+  }
+  return p;
+}
+
+/* Fraction-free (Bareiss) forward elimination of the n x m polynomial matrix
+   data (whose rows are accessed through perm) using the first npiv columns
+   as pivot columns. Return the rank and update sign for each row swap.
+   data shall be allocated before mark (it is compacted in place) */
+static unsigned int
+echelon_y (may_t *data, unsigned int *perm, unsigned int n, unsigned int m,
+           unsigned int npiv, int *sign, may_mark_t mark)
+{
+  unsigned int r = 0, c, i, p, prev_col = 0, counter = 0;
+
+  for (c = 0; c < npiv && r < n; c++) {
+    /* Search for a non zero pivot: a pure number if possible, as small as possible */
+    size_t best = (size_t) -1, len;
+    for (p = n, i = r; i < n && best != 0; i++) {
+      may_t x = data[(size_t) perm[i]*m+c];
+      if (!may_zero_p (x)
+          && (len = MAY_PURENUM_P (x) ? 0 : may_length (x)) < best) {
+        best = len;
+        p = i;
+      }
+    }
+    if (p == n)
+      continue;
+    if (p != r) {
+      swap (perm[p], perm[r]);
+      *sign = -*sign;
+    }
+    may_t *prow = &data[(size_t) perm[r]*m];
+    may_t prev = r == 0 ? MAY_ONE : data[(size_t) perm[r-1]*m+prev_col];
+    may_int_t w = m-c-1, cnt = (may_int_t) (n-r-1) * w;
+    MAY_SPAWN_FOR (mark, t, 0, cnt, (data, perm, prow, prev, r, c, m, w), {
+        may_t *ri = &data[(size_t) perm[r+1+t/w]*m];
+        unsigned int j = c+1+t%w;
+        ri[j] = bareiss_step (ri[j], prow[c], ri[c], prow[j], prev);
+      });
+    for (i = r+1; i < n; i++)
+      data[(size_t) perm[i]*m+c] = MAY_ZERO;
+    prev_col = c;
+    r++;
+    /* Free the intermediate expressions */
+    if (++counter >= MAT_COMPACT_STEP) {
+      may_t *new = may_compact_v (mark, (size_t) n*m, data);
+      MAY_ASSERT (new == data);
+      UNUSED (new);
+      counter = 0;
+    }
+  }
+  return r;
+}
+
+/***************************************************************************/
+/*                         Linear Algebra                                  */
+/***************************************************************************/
+
+/* Return an evaluated copy of the entries of a */
+static may_t *
+mat_get_eval (may_mat_srcptr a)
+{
+  size_t n = (size_t) a->row*a->col;
+  may_t *tab = may_alloc (n * sizeof (may_t) + 1);
+  for (size_t i = 0; i < n; i++)
+    tab[i] = may_eval (a->data[i]);
+  return tab;
+}
+
+static unsigned int *
+mat_get_perm (unsigned int n)
+{
+  unsigned int *perm = may_alloc (n * sizeof (unsigned int) + 1);
+  for (unsigned int i = 0; i < n; i++)
+    perm[i] = i;
+  return perm;
+}
+
+may_t
+may_mat_det (may_mat_srcptr a)
+{
+  unsigned int i, r, n = a->row;
+  int sign = 1;
+  may_t det;
+  may_mark_t mark;
+
+  MAY_LOG_FUNC (("row=%u col=%u", a->row, a->col));
+
+  if (a->row != a->col)
+    MAY_THROW (MAY_DIMENSION_ERR);
+  if (MAY_UNLIKELY (n == 0))
+    return MAY_ONE;
+
+  MAY_RECORD ();
+  may_t *tab = mat_get_eval (a);
+  unsigned int *perm = mat_get_perm (n);
+  switch (mat_domain ((size_t) n*n, tab)) {
+  case MAT_INTEGER:
+    {
+      mpz_t scale[n];
+      mpz_t *z = mat_get_z (scale, n, n, tab);
+      may_mark (mark);
+      r = echelon_z (z, perm, n, n, n, &sign, mark);
+      if (r < n)
+        MAY_RET (MAY_ZERO);
+      for (i = 1; i < n; i++)
+        mpz_mul (scale[0], scale[0], scale[i]);
+      if (sign < 0)
+        mpz_neg (scale[0], scale[0]);
+      det = mat_set_zz (z[(size_t) perm[n-1]*n+n-1], scale[0]);
+      MAY_RET (det);
+    }
+  case MAT_FLOAT:
+    {
+      mpfr_t *f = mat_get_fr (n, n, tab);
+      may_mark (mark);
+      r = echelon_fr (f, perm, n, n, n, &sign, mark);
+      if (r < n)
+        MAY_RET (MAY_ZERO);
+      for (i = 1; i < n; i++)
+        mpfr_mul (f[(size_t) perm[0]*n], f[(size_t) perm[0]*n],
+                  f[(size_t) perm[i]*n+i], may_g.frame.rnd_mode);
+      if (sign < 0)
+        mpfr_neg (f[(size_t) perm[0]*n], f[(size_t) perm[0]*n], may_g.frame.rnd_mode);
+      MAY_RET (may_set_fr (f[(size_t) perm[0]*n]));
+    }
+  default:
+    {
+      may_t scale[n];
+      may_t *p = mat_get_poly (scale, n, n, tab);
+      may_mark (mark);
+      r = echelon_y (p, perm, n, n, n, &sign, mark);
+      if (r < n)
+        MAY_RET (MAY_ZERO);
+      det = p[(size_t) perm[n-1]*n+n-1];
+      if (sign < 0)
+        det = may_eval (may_neg_c (det));
+      MAY_RET (reduce_div (det, may_eval (may_mul_vc (n, scale))));
+    }
+  }
+}
+
+unsigned int
+may_mat_rank (may_mat_srcptr a)
+{
+  unsigned int r, n = a->row, m = a->col;
+  int sign = 1;
+  may_mark_t mark, mark2;
+
+  MAY_LOG_FUNC (("row=%u col=%u", a->row, a->col));
+
+  if (MAY_UNLIKELY (n == 0 || m == 0))
+    return 0;
+
+  may_mark (mark);
+  may_t *tab = mat_get_eval (a);
+  unsigned int *perm = mat_get_perm (n);
+  switch (mat_domain ((size_t) n*m, tab)) {
+  case MAT_INTEGER:
+    {
+      mpz_t *z = mat_get_z (NULL, n, m, tab);
+      may_mark (mark2);
+      r = echelon_z (z, perm, n, m, m, &sign, mark2);
+      break;
+    }
+  case MAT_FLOAT:
+    {
+      mpfr_t *f = mat_get_fr (n, m, tab);
+      may_mark (mark2);
+      r = echelon_fr (f, perm, n, m, m, &sign, mark2);
+      break;
+    }
+  default:
+    {
+      may_t *p = mat_get_poly (NULL, n, m, tab);
+      may_mark (mark2);
+      r = echelon_y (p, perm, n, m, m, &sign, mark2);
+      break;
+    }
+  }
+  may_compact (mark, NULL);
+  return r;
+}
+
+/* Solve a*x = b with a square and invertible */
+void
+may_mat_solve (may_mat_ptr x, may_mat_srcptr a, may_mat_srcptr b)
+{
+  unsigned int i, j, k, n = a->row, nb = b->col, m = n+nb;
+  int sign = 1;
+  may_mat_t ab;
+  may_mark_t mark, mark2;
+
+  MAY_LOG_FUNC (("row=%u col=%u", a->row, a->col));
+
+  if (a->row != a->col || b->row != n)
+    MAY_THROW (MAY_DIMENSION_ERR);
+  if (MAY_UNLIKELY (n == 0 || nb == 0)) {
+    may_mat_resize (x, n, nb);
+    return;
+  }
+
+  may_mark (mark);
+  may_mat_init (ab, 0, 0);
+  may_mat_augment (ab, a, b);
+  may_t *tab = mat_get_eval (ab);
+  unsigned int *perm = mat_get_perm (n);
+  may_t *sol = may_alloc ((size_t) n*nb*sizeof (may_t));
+
+  switch (mat_domain ((size_t) n*m, tab)) {
+  case MAT_INTEGER:
+    {
+      mpz_t *z = mat_get_z (NULL, n, m, tab);
+      may_mark (mark2);
+      if (echelon_z (z, perm, n, m, n, &sign, mark2) < n)
+        MAY_THROW (MAY_SINGULAR_MATRIX_ERR);
+      /* Fraction-free back substitution: X = det*x */
+      mpz_srcptr det = z[(size_t) perm[n-1]*m+n-1];
+      mpz_t s, xz[n];
+      mpz_init (s);
+      for (k = 0; k < nb; k++) {
+        for (i = n; i-- > 0; ) {
+          mpz_t *ri = &z[(size_t) perm[i]*m];
+          mpz_mul (s, det, ri[n+k]);
+          for (j = i+1; j < n; j++)
+            mpz_submul (s, ri[j], xz[j]);
+          mpz_init (xz[i]);
+          mpz_divexact (xz[i], s, ri[i]);
+          sol[(size_t) i*nb+k] = mat_set_zz (xz[i], det);
+        }
+      }
+      break;
+    }
+  case MAT_FLOAT:
+    {
+      mpfr_t *f = mat_get_fr (n, m, tab);
+      mp_rnd_t rnd = may_g.frame.rnd_mode;
+      may_mark (mark2);
+      if (echelon_fr (f, perm, n, m, n, &sign, mark2) < n)
+        MAY_THROW (MAY_SINGULAR_MATRIX_ERR);
+      for (k = 0; k < nb; k++) {
+        for (i = n; i-- > 0; ) {
+          mpfr_t *ri = &f[(size_t) perm[i]*m];
+          for (j = i+1; j < n; j++) {
+            mpfr_fms (ri[n+k], ri[j], f[(size_t) perm[j]*m+n+k], ri[n+k], rnd);
+            mpfr_neg (ri[n+k], ri[n+k], rnd);
+          }
+          mpfr_div (ri[n+k], ri[n+k], ri[i], rnd);
+          sol[(size_t) i*nb+k] = may_set_fr (ri[n+k]);
+        }
+      }
+      break;
+    }
+  default:
+    {
+      may_t *p = mat_get_poly (NULL, n, m, tab);
+      may_mark (mark2);
+      if (echelon_y (p, perm, n, m, n, &sign, mark2) < n)
+        MAY_THROW (MAY_SINGULAR_MATRIX_ERR);
+      /* Fraction-free back substitution: X = det*x */
+      may_t det = p[(size_t) perm[n-1]*m+n-1];
+      may_t xy[n];
+      for (k = 0; k < nb; k++) {
+        for (i = n; i-- > 0; ) {
+          may_t *ri = &p[(size_t) perm[i]*m];
+          may_t s = may_mul_c (det, ri[n+k]);
+          for (j = i+1; j < n; j++)
+            s = may_sub_c (s, may_mul_c (ri[j], xy[j]));
+          xy[i] = exact_div (s, ri[i]);
+          sol[(size_t) i*nb+k] = reduce_div (xy[i], det);
+        }
+      }
+      break;
+    }
+  }
+
+  may_mat_resize (x, n, nb);
+  memcpy (x->data, sol, (size_t) n*nb*sizeof (may_t));
+  may_mat_compact (mark, x);
+}
+
+void
+may_mat_inverse (may_mat_ptr c, may_mat_srcptr a)
+{
+  may_mat_t id;
+  may_mark_t mark;
+
+  may_mark (mark);
+  may_mat_init (id, 0, 0);
+  may_mat_identity (id, a->row, MAY_ONE);
+  may_mat_solve (c, a, id);
+  may_mat_compact (mark, c);
+}
+
+/* Multiply a by b.
+   The entries are computed in parallel, and over integers
+   if all the entries of a and b are integers */
+void
+may_mat_mul (may_mat_ptr c, may_mat_srcptr a, may_mat_srcptr b)
+{
+  unsigned int m = a->row, p = a->col, n = b->col;
+  may_mark_t mark;
+
+  MAY_LOG_FUNC (("row=%u col=%u row=%u col=%u", a->row, a->col, b->row, b->col));
+
+  if (p != b->row)
+    MAY_THROW (MAY_DIMENSION_ERR);
+  if (MAY_UNLIKELY ((size_t) m*n == 0)) {
+    may_mat_resize (c, m, n);
+    return;
+  }
+
+  may_mark (mark);
+  may_t *tab = may_alloc ((size_t) m*n*sizeof (may_t));
+  const may_t *pa = a->data, *pb = b->data;
+  int is_int = may_g.frame.intmod == NULL;
+  for (size_t i = 0; is_int && i < (size_t) m*p; i++)
+    is_int = MAY_TYPE (pa[i]) == MAY_INT_T && MAY_EVAL_P (pa[i]);
+  for (size_t i = 0; is_int && i < (size_t) p*n; i++)
+    is_int = MAY_TYPE (pb[i]) == MAY_INT_T && MAY_EVAL_P (pb[i]);
+
+  if (is_int) {
+    MAY_SPAWN_FOR (mark, t, 0, (may_int_t) m*n, (tab, pa, pb, p, n), {
+        unsigned int i = t / n;
+        unsigned int j = t % n;
+        mpz_t s;
+        mpz_init (s);
+        for (unsigned int k = 0; k < p; k++)
+          mpz_addmul (s, MAY_INT (pa[(size_t) i*p+k]), MAY_INT (pb[(size_t) k*n+j]));
+        tab[t] = may_set_z (s);
+      });
+  } else {
+    MAY_SPAWN_FOR (mark, t, 0, (may_int_t) m*n, (tab, pa, pb, p, n), {
+        unsigned int i = t / n;
+        unsigned int j = t % n;
+        may_t s = MAY_ZERO;
+        for (unsigned int k = 0; k < p; k++) {
+          may_t x = pa[(size_t) i*p+k];
+          may_t y = pb[(size_t) k*n+j];
+          if (!MAY_ZERO_P (x) && !MAY_ZERO_P (y))
+            s = may_addinc_c (s, may_mul_c (x, y));
+        }
+        tab[t] = may_eval (s);
+      });
+  }
+
+  may_mat_resize (c, m, n);
+  memcpy (c->data, tab, (size_t) m*n*sizeof (may_t));
+  may_mat_compact (mark, c);
+}
@@ -29,12 +29,25 @@ MA 02110-1301, USA. */
 #include "may.h"
 #include "macros.h"
 
+/* Thresholds measured on the build machine by 'make tune' (See t-tune.c).
+   They override the default values below. */
+#if defined (__has_include)
+# if __has_include ("may-tuned.h")
+#  include "may-tuned.h"
+# endif
+#endif
+
 #ifndef MAY_MAX_EXTENSION
 # define MAY_MAX_EXTENSION 20
 #endif
 
-#ifndef MAY_MAX_CACHE_SET_STR
-# define MAY_MAX_CACHE_SET_STR 8
+#ifndef MAY_SYMBOL_CACHE_SIZE
+# define MAY_SYMBOL_CACHE_SIZE 256
+#endif
+
+/* Maximum number of symbols of the interned symbol table */
+#ifndef MAY_SYMBOL_TABLE_MAX
+# define MAY_SYMBOL_TABLE_MAX 65536
 #endif
 
 #ifndef MAY_MAX_TRY_HEUGCD
@@ -57,6 +70,62 @@ MA 02110-1301, USA. */
 # define MAY_SORT_THRESHOLD3 79803
 #endif
 
+/* Expected size of an expanded product of sums above which it isn't
+   computed term by term (See may_expand) */
+#ifndef MAY_EXPAND_BASECASE_THRESHOLD
+# define MAY_EXPAND_BASECASE_THRESHOLD 100
+#endif
+
+/* Number of non zero terms of an univariate polynomial up to which its
+   power is computed by a coefficient recurrence rather than by the
+   Kronecker substitution */
+#ifndef MAY_EXPAND_POW_MILLER_THRESHOLD
+# define MAY_EXPAND_POW_MILLER_THRESHOLD 128
+#endif
+
+/* Number of terms of univariate polynomials from which they are
+   multiplied by the Kronecker substitution */
+#ifndef MAY_EXPAND_KRONECKER_THRESHOLD
+# define MAY_EXPAND_KRONECKER_THRESHOLD 1
+#endif
+
+/* A sum is raised to a power by binary exponentiation if less than
+   1/MAY_EXPAND_ALGEBRAIC_RATIO of its terms aren't algebraic numbers */
+#ifndef MAY_EXPAND_ALGEBRAIC_RATIO
+# define MAY_EXPAND_ALGEBRAIC_RATIO 4
+#endif
+
+/* Initial number of terms below which Karatsuba calls the basecase */
+#ifndef MAY_KARA_THRESHOLD
+# define MAY_KARA_THRESHOLD 10
+#endif
+
+/* Sum of the degrees of two polynomials with integer coefficients
+   from which their resultant is computed by the multimodular algorithm
+   rather than by the subresultant PRS */
+#ifndef MAY_RESULTANT_MODULAR_THRESHOLD
+# define MAY_RESULTANT_MODULAR_THRESHOLD 6
+#endif
+
+/* Number of coefficients of a polynomial up to which it is composed
+   by the Horner scheme rather than by divide and conquer */
+#ifndef MAY_COMPOSE_THRESHOLD
+# define MAY_COMPOSE_THRESHOLD 8
+#endif
+
+/* Number of points from which a polynomial is interpolated modulo
+   a word-size prime with a subproduct tree */
+#ifndef MAY_MULTIPOINT_THRESHOLD
+# define MAY_MULTIPOINT_THRESHOLD 64
+#endif
+
+/* Number of points (and of coefficients) from which a polynomial is
+   evaluated modulo a word-size prime with a subproduct tree rather than
+   by the Horner scheme */
+#ifndef MAY_MULTIEVAL_THRESHOLD
+# define MAY_MULTIEVAL_THRESHOLD 4096
+#endif
+
 #ifndef MPFR_VERSION
 # error "MPFR v2.1.0 or above required"
 #endif
@@ -413,13 +482,15 @@ struct may_s {
 struct may_heap_s {
   char *top, *limit;
   char *base;
-  void *comp_mark;
-  MAY_DEF_IF_THREAD (void *comp_base, *comp_limit;)
+  void *comp_mark, *comp_limit;
+  MAY_DEF_IF_THREAD (void *comp_base;)
   unsigned long compdiff;
   char compact_func_disable;
   char allow_extend;
   unsigned int num_resize;
   char *max_top, *current_mark;
+  void *comp_stack;
+  size_t comp_stack_size;
   MAY_DEF_IF_THREAD (struct may_heap_s *next_heap_to_free;)
 };
 
@@ -465,6 +536,46 @@ struct may_karatsuba_s {
   may_t tmpnum;
 };
 
+/* Define the precomputed data of the arithmetic modulo a small intmod.
+   If the current intmod is a positive integer m of at most
+   MAY_INTMOD_SMALL_BITS bits, the integer operations on reduced residues
+   are done on machine words using a Barrett reduction:
+   + m: the modulus of the data (0 if not computed yet)
+   + inv: floor(2^(2*s)/m)
+   + s: the number of bits of m
+   It depends only on the value of intmod, so it doesn't need to be saved
+   in the error frame. See num.c for details and use. */
+#define MAY_INTMOD_SMALL_BITS 62
+struct may_intmod_s {
+  mp_limb_t m, inv;
+  unsigned int s;
+};
+
+/* Define the budget of the computation of the current thread.
+   + active: a timeout or a cancel flag is set (checked by MAY_BUDGET_CHECK)
+   + disabled: the check is suspended (during a compact) if not zero
+   + spawn: the spawn blocks of the thread with jobs given to worker threads
+     and not synchronized yet (they are given the budget of the thread),
+     the last block first
+   + spawn_seq: the sequence number of the last block added to spawn
+   + count: number of checks since the last read of the clock
+   + timeout / deadline: the timeout in ms and its deadline (0 if none)
+   + memlimit: the memory budget in bytes (0 if none)
+   + limit: the real limit of the heap while the memory budget is set
+   + cancel: the cancel flag (NULL if none) */
+struct may_budget_s {
+  int active;
+  unsigned int disabled;
+  MAY_DEF_IF_THREAD (struct may_spawn_block_s *spawn;)
+  MAY_DEF_IF_THREAD (unsigned long spawn_seq;)
+  unsigned int count;
+  unsigned long timeout;
+  unsigned long long deadline;
+  size_t memlimit;
+  char *limit;
+  const volatile int *cancel;
+};
+
 /* Types used by may_antidiff */
 /* Define the different kind of conditions for a parameter
    in a formula. We have 3 parameters A, B & C & D */
@@ -491,7 +602,9 @@ struct may_antidiff_s {
    + base: the base used to convert integer/float for the I/O operations
    + num_presimplify: presimplify the float at parsing times (1) or wait until we know which prec we needs (0)
    + domain: domain of all new variables
-   + cache_set_str_i / cache_set_str_n / cache_set_str : cache used by may_set_str to return a previously created number instead of a new one.
+   + budget_disabled / spawn_seq: the state of the budget when the handler
+     was set, restored by a throw (the spawn blocks added since then are
+     synchronized and the memory of their jobs is freed)
  */
 struct may_error_frame_s {
   may_t intmod;
@@ -506,8 +619,8 @@ struct may_error_frame_s {
   int base;
   int num_presimplify;
   may_domain_e domain;
-  unsigned int cache_set_str_i, cache_set_str_n;
-  may_t cache_set_str[MAY_MAX_CACHE_SET_STR];
+  unsigned int budget_disabled;
+  MAY_DEF_IF_THREAD (unsigned long spawn_seq;)
 };
 
 /* Define globals.
@@ -523,12 +636,18 @@ struct may_error_frame_s {
    + extension_size: size of the extension_tab table
    + series_ext: the ext number of the series extension
    + extension_tab: the extension table
+   + intmod: the precomputed data for the arithmetic modulo a small intmod
+   + budget: the time / memory budget and the cancel flag of the computation
+   + symbols: cache of the symbols of the interned symbol table used by may_set_str
  */
 struct may_globals_s{
   struct may_heap_s Heap;
   struct may_error_frame_s frame;
   struct may_karatsuba_s kara;
   struct may_antidiff_s  antidiff;
+  struct may_intmod_s    intmod;
+  struct may_budget_s    budget;
+  may_t symbols[MAY_SYMBOL_CACHE_SIZE];
   const char *last_error_str;
   may_error_e last_error;
 };
@@ -559,6 +678,11 @@ void               may_heap_init  (struct may_heap_s *heap, unsigned long size,
                                    unsigned long low, int allow_extend);
 void               may_heap_clear (struct may_heap_s *heap);
 
+/******* Define Symbol Table Functions ********/
+may_t              may_symbol_intern (const char [], may_domain_e);
+int                may_symbol_interned_p (const void *);
+void               may_symbol_clear (void);
+
 #define MAY_ALLOC_FAILED(_m) may_heap_extend (_m)
 #define MAY_ALIGNED_SIZE(_n) ((size_t) ((_n)+sizeof(long)-1)& ~(size_t)(sizeof(long)-1))
 #define MAY_ALLOC(_m) ({unsigned long _n = MAY_ALIGNED_SIZE(_m); (MAY_UNLIKELY (may_g.Heap.top + (_n) >= may_g.Heap.limit) ? MAY_ALLOC_FAILED(_n) : (may_g.Heap.top += (_n), may_g.Heap.top - (_n))); })
@@ -676,7 +800,8 @@ void               may_heap_clear (struct may_heap_s *heap);
 
 
 /********* Define string constructors ******/
-#define MAY_STRING_C(_x,_d) ({may_size_t _s = strlen(_x)+1; may_t _y = MAY_ALLOC(MAY_NAME_SIZE(_s)); MAY_SYMBOL_2 (_y).domain = (_d); memcpy (MAY_NAME_2(_y), _x, _s); memset (MAY_NAME_2(_y)+_s, 0, (sizeof (long) - _s % sizeof (long)) ); MAY_OPEN_C (_y, MAY_STRING_T); MAY_SYMBOL_SIZE(_y) = MAY_ALIGNED_SIZE(_s);  MAY_CLOSE_C (_y, MAY_EVAL_F, may_string_hash(MAY_NAME_2(_y))); MAY_SET_FLAG (_y, MAY_EXPAND_F); _y; })
+#define MAY_STRING_SET_C(_y,_x,_s,_d) (MAY_SYMBOL_2 (_y).domain = (_d), memcpy (MAY_NAME_2(_y), _x, _s), memset (MAY_NAME_2(_y)+_s, 0, (sizeof (long) - _s % sizeof (long)) ), MAY_OPEN_C (_y, MAY_STRING_T), MAY_SYMBOL_SIZE(_y) = MAY_ALIGNED_SIZE(_s),  MAY_CLOSE_C (_y, MAY_EVAL_F, may_string_hash(MAY_NAME_2(_y))), MAY_SET_FLAG (_y, MAY_EXPAND_F))
+#define MAY_STRING_C(_x,_d) ({may_size_t _s = strlen(_x)+1; may_t _y = MAY_ALLOC(MAY_NAME_SIZE(_s)); MAY_STRING_SET_C (_y, _x, _s, _d); _y; })
 
 
 /********* Define complex constructors ******/
@@ -710,6 +835,17 @@ void may_error_setjmp_handler (may_error_e, const char *, const void *);
 #define MAY_ERROR (_error_code+0)
 #define MAY_ENDTRY }
 
+/* Check the timeout and the cancel flag of the computation.
+   It shall be called at the head of the long loops
+   (also within the jobs run by the worker threads) */
+void may_budget_check (void);
+void may_budget_throw (const char []) MAY_NORETURN;
+#define MAY_BUDGET_CHECK()                                              \
+  do {                                                                  \
+    if (MAY_UNLIKELY (may_g.budget.active) && may_g.budget.disabled == 0) \
+      may_budget_check ();                                              \
+  } while (0)
+
 
 /********* Define fast predicate macros ********/
 #define MAY_ZERO_P(_x) ((_x) == MAY_ZERO || (MAY_TYPE(_x)==MAY_FLOAT_T && mpfr_zero_p(MAY_FLOAT(_x))))
@@ -733,6 +869,7 @@ extern const char may_ceil_name[];
 MAY_REGPARM size_t   may_length (may_t);
 MAY_REGPARM int      may_size_in_bits(unsigned long);
 int                  may_get_cpu_count(void);
+unsigned long long   may_get_time_ms(void);
 
 /* Define Hash functions */
 MAY_REGPARM may_hash_t may_mpz_hash (mpz_t);
@@ -827,6 +964,52 @@ may_t may_find_unused_polvar (unsigned long, const may_t []);
 may_t may_trig2exp2 (may_t);
 may_t may_karatsuba (may_t, may_t, may_t);
 
+/* Define Algebraic Number Field: K = Q[y]/(m(y)) with m monic of degree n,
+   and the indices of the nsupport non zero coefficients of m below y^n */
+typedef struct {
+  unsigned long n;
+  mpq_t *m;
+  unsigned long *support, nsupport;
+} may_nf_s;
+typedef may_nf_s may_nf_t[1];
+void    may_nf_init     (may_nf_t, unsigned long, mpq_t []);
+mpq_t  *may_nf_new      (const may_nf_t);
+void    may_nf_set      (const may_nf_t, mpq_t [], mpq_t []);
+void    may_nf_set_ui   (const may_nf_t, mpq_t [], unsigned long);
+int     may_nf_equal_p  (const may_nf_t, mpq_t [], mpq_t []);
+void    may_nf_mul      (const may_nf_t, mpq_t [], mpq_t [], mpq_t []);
+void    may_nf_pow_ui   (const may_nf_t, mpq_t [], mpq_t [], unsigned long);
+int     may_nf_inv      (const may_nf_t, mpq_t [], mpq_t []);
+void    may_nf_norm     (mpq_t, const may_nf_t, mpq_t []);
+int     may_nf_set_upol (const may_nf_t, mpq_t [], may_t, may_t);
+may_t   may_nf_get_upol (const may_nf_t, mpq_t [], may_t);
+
+may_t   may_compose_upol (unsigned long, may_t [], may_t, may_t, may_t);
+
+/* Arithmetic modulo a word-size prime p < 2^32 */
+MAY_INLINE unsigned long
+may_mulmod_ui (unsigned long a, unsigned long b, unsigned long p)
+{
+  return (unsigned long) (((unsigned long long) a * b) % p);
+}
+MAY_INLINE unsigned long
+may_addmod_ui (unsigned long a, unsigned long b, unsigned long p)
+{
+  unsigned long r = a + b;
+  return r >= p ? r - p : r;
+}
+MAY_INLINE unsigned long
+may_submod_ui (unsigned long a, unsigned long b, unsigned long p)
+{
+  return a >= b ? a - b : a + p - b;
+}
+unsigned long may_powmod_ui (unsigned long, unsigned long, unsigned long);
+unsigned long may_invmod_ui (unsigned long, unsigned long);
+void    may_multieval_ui (unsigned long [], unsigned long, const unsigned long [],
+                          unsigned long, const unsigned long [], unsigned long);
+void    may_interpolate_ui (unsigned long [], unsigned long, const unsigned long [],
+                            unsigned long, const unsigned long [], unsigned long);
+
 /* Define extended Eval Functions */
 MAY_REGPARM may_t may_eval_sin (may_t z, may_t x);
 MAY_REGPARM may_t may_eval_cos (may_t z, may_t x);
@@ -864,6 +1047,8 @@ may_t may_addmul_vc (size_t size, const may_pair_t *tab);
 may_t may_mulpow_vc (size_t size, const may_pair_t *tab);
 
 void may_elist_init (void);
+void may_antidiff_clear (void);
+may_t may_rewrite_instantiate (may_t, const may_t [], int);
 
 MAY_REGPARM unsigned long may_test_overflow_pow_ui (mpz_srcptr a, mpz_srcptr b);
 
@@ -922,22 +1107,61 @@ void       may_list_swap (may_list_t, may_list_t);
 # define may_list_get_size(l) ((l)->size)
 #endif
 
+/*********************** Matrix functions ************************************/
+/* Entries are stored by rows: (i,j) is data[i*col+j] */
+#ifndef MAY_WANT_ASSERT
+# define may_mat_row(c) ((c)->row)
+# define may_mat_col(c) ((c)->col)
+# define may_mat_at(c,i,j) ((c)->data[(size_t) (i)*(c)->col+(j)])
+# define may_mat_set_at(c,i,j,x) ((c)->data[(size_t) (i)*(c)->col+(j)] = (x))
+#endif
 
 
-
-/*************************** BINTREE Functions *******************************/
-typedef struct node_s {
+/*********************** Dynamic 'Set' functions *****************************/
+/* Implemented as a list of the elements (in insertion order) and an
+   open addressing hash table of the indexes in this list (+1, 0 being
+   a free entry) keyed on the hash of the element and checked with
+   may_identical.
+   The index table is a raw area of the heap: may_hset_compact rebuilds it. */
+typedef struct {
+  may_list_t  list;
+  may_size_t  mask;
+  may_size_t *index;
+} may_hset_t[1];
+
+void       may_hset_init (may_hset_t, may_size_t);
+may_t      may_hset_quit (may_hset_t);
+void       may_hset_reset (may_hset_t);
+may_size_t may_hset_push_back (may_hset_t, may_t);
+bool       may_hset_find (may_size_t *, may_hset_t, may_t);
+may_t      may_hset_at (may_hset_t, may_size_t);
+may_size_t may_hset_get_size (may_hset_t);
+void       may_hset_compact (may_mark_t, may_hset_t);
+void       may_hset_swap (may_hset_t, may_hset_t);
+
+
+
+
+/************************ Term accumulator functions *************************/
+/* Open addressing hash table of the terms of a sum being built,
+   keyed on the hash of the term widened with the hashes of its operands
+   and checked with may_identical.
+   Each term has a rewritable coefficient where the like terms are added.
+   The table is a raw area of the heap. */
+typedef struct {
+  uint64_t hash;
   may_t num;
   may_t key;
-  struct node_s *child[2];
-} *may_bintree_t;
-may_bintree_t may_bintree_insert (may_bintree_t tree, may_t num, may_t key);
-may_t  may_bintree_get_sum (may_t, may_bintree_t tree);
-unsigned long may_bintree_size (may_bintree_t tree);
-
-may_bintree_t may_genbintree_insert (may_bintree_t tree, may_t num, may_t key);
-may_t  may_genbintree_get_sum (may_t, may_bintree_t tree);
-unsigned long may_genbintree_size (may_bintree_t tree);
+} may_termhash_entry_t;
+typedef struct {
+  may_size_t size;
+  may_size_t mask;
+  int shift;
+  may_termhash_entry_t *tab;
+} may_termhash_t[1];
+void  may_termhash_init (may_termhash_t, may_size_t);
+void  may_termhash_add (may_termhash_t, may_t num, may_t key);
+may_t may_termhash_get_sum (may_t, may_termhash_t);
 
 
 
@@ -0,0 +1,431 @@
+/* This file is part of the MAYLIB libray.
+   Copyright 2007-2018 Patrick Pelissier
+
+This Library is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This Library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with th Library; see the file COPYING.LESSER.txt.
+If not, write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston,
+MA 02110-1301, USA. */
+
+/* Batch evaluation server:
+     may-serve [-threads N] [-batch N] [-timeout MS] [-socket PATH [-once]]
+   It reads jobs from the standard input (or from the connections
+   to the Unix socket PATH), evaluates them and writes their results.
+   A job is either a line, or '#N' followed by a line and N bytes:
+     EXPRESSION [OPERATION...]
+   with the same operations as t-eval. Words are separated by blanks,
+   and a word may be quoted with '"' to contain blanks.
+   Each result is written on one line:
+     ID ok TIMEms RESULT
+     ID error TIMEms MESSAGE
+   with ID the number of the job (from 1) and TIME its wall time.
+   A result is written as soon as its job is finished, so that the
+   results of the jobs evaluated together may be written out of order.
+   A job running for more than MS ms is interrupted (error Interrupted).
+   The jobs available at once are evaluated together on the worker
+   threads, each one within its own mark of the heap of its thread.
+   The worker threads need a kernel built with MAY_WANT_THREAD
+   ('make serve-mt'): otherwise the jobs are evaluated one by one. */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "may-impl.h"
+#ifdef MAY_WANT_THREAD
+# include <pthread.h>
+#endif
+#include "t-eval.h"
+
+/* Timeout of a job in ms (0 if none) */
+static unsigned long job_timeout = 0;
+
+/* A job and its result */
+typedef struct {
+  int fd;
+  unsigned long id;
+  int argc;
+  char **argv;
+  int error;
+  double time;
+  char *result;
+} job_t;
+
+/* A buffered reader of jobs over a file descriptor */
+typedef struct {
+  int fd, eof;
+  size_t size, begin, end;
+  char *buffer;
+} reader_t;
+
+static void *
+xmalloc (size_t n)
+{
+  void *p = malloc (n);
+  if (p == NULL) {
+    fprintf (stderr, "may-serve: out of memory\n");
+    exit (2);
+  }
+  return p;
+}
+
+static char *
+xstrdup (const char s[])
+{
+  char *p = xmalloc (strlen (s) + 1);
+  return strcpy (p, s);
+}
+
+static double
+walltime (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/* Split the text of a job into words */
+static void
+job_split (job_t *job, char *text)
+{
+  size_t n = 0, alloc = 8;
+  char **argv = xmalloc (alloc * sizeof *argv);
+
+  for (char *s = text; ; ) {
+    while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')
+      s++;
+    if (*s == 0)
+      break;
+    if (n + 2 > alloc)
+      argv = realloc (argv, (alloc *= 2) * sizeof *argv);
+    if (argv == NULL)
+      xmalloc ((size_t) -1);
+    char *d = s;
+    argv[n++] = d;
+    int quoted = 0;
+    for ( ; *s != 0; s++) {
+      if (*s == '"')
+        quoted = !quoted;
+      else if (!quoted && (*s == ' ' || *s == '\t'
+                           || *s == '\n' || *s == '\r'))
+        break;
+      else
+        *d++ = *s;
+    }
+    if (*s != 0)
+      s++;
+    *d = 0;
+  }
+  argv[n] = NULL;
+  job->argc = n;
+  job->argv = argv;
+}
+
+/* Extract the next complete job of the buffer.
+   Return NULL if more data is needed */
+static char *
+reader_next (reader_t *r)
+{
+  char *begin = r->buffer + r->begin;
+  char *nl = memchr (begin, '\n', r->end - r->begin);
+  size_t length;
+
+  if (nl == NULL) {
+    /* A last job without newline */
+    if (!r->eof || r->begin == r->end)
+      return NULL;
+    nl = r->buffer + r->end;
+  }
+  if (*begin == '#') {
+    /* Length prefixed job */
+    length = strtoul (begin + 1, NULL, 10);
+    begin = nl + (nl != r->buffer + r->end);
+    if ((size_t) (r->buffer + r->end - begin) < length)
+      return NULL;
+    nl = begin + length;
+  }
+  length = nl - begin;
+  char *text = xmalloc (length + 1);
+  memcpy (text, begin, length);
+  text[length] = 0;
+  r->begin = MIN ((size_t) (nl + 1 - r->buffer), r->end);
+  return text;
+}
+
+/* Read more data in the buffer (blocking) */
+static void
+reader_fill (reader_t *r)
+{
+  if (r->begin > 0) {
+    memmove (r->buffer, r->buffer + r->begin, r->end - r->begin);
+    r->end -= r->begin;
+    r->begin = 0;
+  }
+  if (r->end == r->size) {
+    r->size *= 2;
+    r->buffer = realloc (r->buffer, r->size);
+    if (r->buffer == NULL)
+      xmalloc ((size_t) -1);
+  }
+  ssize_t n;
+  do
+    n = read (r->fd, r->buffer + r->end, r->size - r->end);
+  while (n < 0 && errno == EINTR);
+  if (n <= 0)
+    r->eof = 1;
+  else
+    r->end += n;
+}
+
+static void
+write_all (int fd, const char *s, size_t n)
+{
+  while (n > 0) {
+    ssize_t k = write (fd, s, n);
+    if (k < 0 && errno == EINTR)
+      continue;
+    if (k <= 0)
+      return;
+    s += k, n -= k;
+  }
+}
+
+/* Write the result of a job */
+static void
+job_write (const job_t *job)
+{
+#ifdef MAY_WANT_THREAD
+  static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+  size_t size = strlen (job->result) + 100;
+  char *s = xmalloc (size);
+  int k = snprintf (s, size, "%lu %s %.3fms %s\n", job->id,
+                    job->error ? "error" : "ok", job->time, job->result);
+#ifdef MAY_WANT_THREAD
+  pthread_mutex_lock (&mutex);
+#endif
+  write_all (job->fd, s, k);
+#ifdef MAY_WANT_THREAD
+  pthread_mutex_unlock (&mutex);
+#endif
+  free (s);
+}
+
+/* Evaluate a job (in a worker thread or in the main thread)
+   and write its result.
+   The kernel options set by the job are restored afterwards. */
+static void
+job_run (void *data)
+{
+  job_t *job = data;
+  double t = walltime ();
+  /* Save the kernel options */
+  mp_prec_t prec = may_kernel_prec (0);
+  may_t intmod = may_kernel_intmod (NULL);
+  may_kernel_intmod (intmod);
+  int presimplify = may_kernel_num_presimplify (1);
+  may_kernel_num_presimplify (presimplify);
+  may_mark_t mark;
+
+  may_mark (mark);
+  may_kernel_timeout (job_timeout);
+  MAY_TRY
+    {
+      may_t r;
+      int recur = 0;
+
+      eval_setup (job->argc, job->argv, 1);
+      char *end = may_parse_c (&r, job->argv[0]);
+      if (*end != 0)
+        may_error_throw (MAY_INVALID_TOKEN_ERR, end);
+      r = may_eval (r);
+      for (int i = 1; i < job->argc; i++) {
+        may_t s = eval_operation (r, job->argc, job->argv, &i, &recur);
+        if (s == NULL)
+          may_error_throw (MAY_INVALID_TOKEN_ERR, job->argv[i]);
+        /* The modulus set by the job (if any) is in the heap too */
+        may_t tab[2] = {s, may_kernel_intmod (NULL)};
+        may_compact_v (mark, 2, tab);
+        may_kernel_intmod (tab[1]);
+        r = tab[0];
+      }
+      job->result = xstrdup (may_get_string (NULL, 0, r));
+      job->error = 0;
+    }
+  MAY_CATCH
+    {
+      const char *what;
+      may_error_get (NULL, &what);
+      if (what == NULL)
+        what = "";
+      size_t n = strlen (may_error_what (MAY_ERROR)) + strlen (what) + 4;
+      job->result = xmalloc (n);
+      snprintf (job->result, n, "%s (%s)", may_error_what (MAY_ERROR), what);
+      job->error = 1;
+    }
+  MAY_ENDTRY;
+  may_kernel_timeout (0);
+  may_compact (mark, NULL);
+  job->time = walltime () - t;
+
+  may_kernel_prec (prec);
+  may_kernel_intmod (intmod);
+  may_kernel_num_presimplify (presimplify);
+  job_write (job);
+}
+
+/* Evaluate the jobs on the worker threads */
+static void
+serve_batch (int n, job_t jobs[])
+{
+  may_mark_t mark;
+
+  may_mark (mark);
+#ifdef MAY_WANT_THREAD
+  MAY_SPAWN_BLOCK (block, mark);
+  for (int i = 0; i < n; i++)
+    may_spawn (block, job_run, &jobs[i]);
+  MAY_SPAWN_SYNC (block);
+#else
+  for (int i = 0; i < n; i++)
+    job_run (&jobs[i]);
+#endif
+  may_compact (mark, NULL);
+}
+
+/* Serve the jobs read from fd_in, writing the results to fd_out */
+static void
+serve (int fd_in, int fd_out, int batch)
+{
+  reader_t r[1] = {{fd_in, 0, 4096, 0, 0, NULL}};
+  job_t *jobs = xmalloc (batch * sizeof *jobs);
+  char **text = xmalloc (batch * sizeof *text);
+  unsigned long id = 0;
+
+  r->buffer = xmalloc (r->size);
+  for (;;) {
+    /* Get the jobs which are available without waiting */
+    int n = 0;
+    while (n < batch && (text[n] = reader_next (r)) != NULL) {
+      job_split (&jobs[n], text[n]);
+      if (jobs[n].argc == 0) {
+        /* Skip empty jobs */
+        free (jobs[n].argv);
+        free (text[n]);
+        continue;
+      }
+      jobs[n].fd = fd_out;
+      jobs[n].id = ++id;
+      n++;
+    }
+    if (n == 0) {
+      if (r->eof)
+        break;
+      reader_fill (r);
+      continue;
+    }
+    serve_batch (n, jobs);
+    for (int i = 0; i < n; i++) {
+      free (jobs[i].argv);
+      free (jobs[i].result);
+      free (text[i]);
+    }
+  }
+  free (r->buffer);
+  free (text);
+  free (jobs);
+}
+
+/* Serve the connections to the Unix socket 'path' */
+static int
+serve_socket (const char path[], int batch, int once)
+{
+  struct sockaddr_un addr;
+  int fd = socket (AF_UNIX, SOCK_STREAM, 0);
+
+  memset (&addr, 0, sizeof addr);
+  addr.sun_family = AF_UNIX;
+  if (fd < 0 || strlen (path) >= sizeof addr.sun_path) {
+    fprintf (stderr, "may-serve: can't create socket %s\n", path);
+    return 1;
+  }
+  strcpy (addr.sun_path, path);
+  unlink (path);
+  if (bind (fd, (struct sockaddr *) &addr, sizeof addr) < 0
+      || listen (fd, 16) < 0) {
+    fprintf (stderr, "may-serve: can't listen to %s: %s\n",
+             path, strerror (errno));
+    close (fd);
+    return 1;
+  }
+  do {
+    int c = accept (fd, NULL, NULL);
+    if (c < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    serve (c, c, batch);
+    close (c);
+  } while (!once);
+  close (fd);
+  unlink (path);
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *path = NULL;
+  int threads = 0, batch = 64, once = 0, ret = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp (argv[i], "-threads") == 0 && i + 1 < argc)
+      threads = atoi (argv[++i]);
+    else if (strcmp (argv[i], "-batch") == 0 && i + 1 < argc)
+      batch = MAX (1, atoi (argv[++i]));
+    else if (strcmp (argv[i], "-timeout") == 0 && i + 1 < argc)
+      job_timeout = strtoul (argv[++i], NULL, 10);
+    else if (strcmp (argv[i], "-socket") == 0 && i + 1 < argc)
+      path = argv[++i];
+    else if (strcmp (argv[i], "-once") == 0)
+      once = 1;
+    else {
+      printf ("Using %s\n", may_get_version ());
+      printf ("%s [-threads N] [-batch N] [-timeout MS] [-socket PATH [-once]]\n"
+              "Read the jobs 'EXPRESSION [OPERATION...]' (See t-eval)\n"
+              "one per line or prefixed by '#LENGTH' line.\n", argv[0]);
+      return 0;
+    }
+  }
+
+  may_kernel_start (0, 0);
+  may_rootof_ext_init ();
+  if (threads > 0) {
+#ifndef MAY_WANT_THREAD
+    fprintf (stderr, "may-serve: built without MAY_WANT_THREAD, "
+             "-threads is ignored (use 'make serve-mt')\n");
+#endif
+    may_kernel_worker (threads, 0);
+  }
+
+  if (path == NULL)
+    serve (STDIN_FILENO, STDOUT_FILENO, batch);
+  else
+    ret = serve_socket (path, batch, once);
+
+  may_kernel_end ();
+  return ret;
+}
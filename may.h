@@ -125,7 +125,8 @@ extern "C" {
     MAY_DIMENSION_ERR,
     MAY_SINGULAR_MATRIX_ERR,
     MAY_INVALID_MAT_SIZE_ERR,
-    MAY_VALUATION_NOT_POS_ERR
+    MAY_VALUATION_NOT_POS_ERR,
+    MAY_INTERRUPT_ERR
   } may_error_e;
 
   typedef union {long l; unsigned long ul; size_t s; may_t m; may_t *pm; char *c; void *v; int b;} may_iterator_t[4];
@@ -133,6 +134,29 @@ extern "C" {
 
   typedef enum {MAY_COMBINE_NORMAL=0, MAY_COMBINE_FORCE=1} may_combine_flags_e;
 
+  typedef enum {MAY_REWRITE_ONCE=0, MAY_REWRITE_REPEAT=1, MAY_REWRITE_MEMO=2
+  } may_rewrite_flags_e;
+
+  typedef struct {
+    may_t pattern, replacement;
+    int size;
+    int (**funcp)(may_t);
+  } may_rule_t;
+
+  typedef struct {
+    const char *name;
+    may_t value;
+    may_t (*func)(may_t);
+  } may_binding_t;
+
+  typedef struct may_mat_s {
+    unsigned int row, col;
+    size_t alloc;
+    may_t *data;
+  } may_mat_t[1];
+  typedef struct may_mat_s *may_mat_ptr;
+  typedef const struct may_mat_s *may_mat_srcptr;
+
   /* Define Kernel Functions */
   const char*may_get_version (void);
 
@@ -147,10 +171,15 @@ extern "C" {
   may_domain_e may_kernel_domain   (may_domain_e );
   may_t     may_kernel_intmod (may_t);
   unsigned long may_kernel_intmaxsize (unsigned long);
+  unsigned long may_kernel_timeout (unsigned long);
+  size_t    may_kernel_memlimit (size_t);
+  const volatile int *may_kernel_cancel (const volatile int *);
   int     (*may_kernel_sort_cb (int (*n)(may_t, may_t)))(may_t, may_t);
   int     (*may_kernel_zero_cb (int (*n)(may_t)))(may_t);
   int       may_kernel_num_presimplify (int);
   int       may_kernel_worker(int,size_t);
+  int       may_session_start (size_t);
+  void      may_session_end  (void);
 
   void      may_kernel_info  (FILE *, const char []);
 
@@ -285,6 +314,9 @@ extern "C" {
   void      may_content      (may_t *, may_t *, may_t, may_t);
   may_t     may_sqrfree      (may_t, may_t);
   may_t     may_ratfactor    (may_t, may_t);
+  may_t     may_resultant    (may_t, may_t, may_t);
+  may_t     may_discriminant (may_t, may_t);
+  may_t     may_compose      (may_t, may_t, may_t);
 
   /* Define get functions */
   int       may_get_ui        (unsigned long *, may_t);
@@ -304,6 +336,13 @@ extern "C" {
   int       may_match_p       (may_t *, may_t, may_t, int, int (**)(may_t));
   may_t     may_rewrite       (may_t, may_t, may_t);
   may_t     may_rewrite2      (may_t, may_t, may_t, int, int (**)(may_t));
+  may_t     may_rewrite_compile (size_t, const may_rule_t []);
+  may_t     may_rewrite_rules (may_t, may_t, may_rewrite_flags_e);
+  may_t     may_subs_compile  (size_t, const may_binding_t []);
+  may_t     may_subs_apply_c  (may_t, unsigned long, may_t);
+  may_t     may_subs_apply    (may_t, unsigned long, may_t);
+  void      may_subs_papply   (size_t, may_t [], const may_t [],
+                               unsigned long, may_t);
 
   /* Define traversal functions */
   const char *may_get_name    (may_t);
@@ -313,6 +352,10 @@ extern "C" {
   may_t     may_map           (may_t, may_t (*)(may_t));
   may_t     may_map2_c        (may_t, may_t (*)(may_t,void*),void*);
   may_t     may_map2          (may_t, may_t (*)(may_t,void*),void*);
+  may_t     may_pmap_c        (may_t, may_t (*)(may_t));
+  may_t     may_pmap          (may_t, may_t (*)(may_t));
+  may_t     may_pmap2_c       (may_t, may_t (*)(may_t,void*),void*);
+  may_t     may_pmap2         (may_t, may_t (*)(may_t,void*),void*);
 
   /* Define evaluators */
   may_t     may_eval          (may_t);
@@ -380,6 +423,7 @@ extern "C" {
   /* Define comparison functions */
   int       may_identical     (may_t, may_t); /* FAST */
   int       may_cmp           (may_t, may_t); /* LEXICOGRAPHIC ORDER */
+  int       may_equal_p       (may_t, may_t);
 
   /* Define basic operators */
   int       may_degree        (may_t *, mpz_srcptr [], may_t *,
@@ -413,6 +457,8 @@ extern "C" {
   may_t     may_expand        (may_t);
   may_t     may_collect       (may_t, may_t);
   may_t     may_diff          (may_t, may_t);
+  may_t     may_gradient      (may_t, unsigned long, const may_t []);
+  may_t     may_jacobian      (unsigned long, const may_t [], unsigned long, const may_t []);
   may_t     may_antidiff      (may_t, may_t);
   may_t     may_sqrtsimp      (may_t);
   void      may_rectform      (may_t *, may_t *, may_t);
@@ -422,6 +468,7 @@ extern "C" {
   may_t     may_series        (may_t, may_t, unsigned long);
   may_t     may_texpand       (may_t);
   may_t     may_rationalize   (may_t);
+  may_t     may_normal        (may_t);
   may_t     may_eexpand       (may_t);
   may_t     may_recursive     (may_t, may_t (*) (may_t), unsigned long);
   may_t     may_smod          (may_t, may_t);
@@ -454,6 +501,35 @@ extern "C" {
   /* Some extensions */
   void      may_rootof_ext_init (void);
 
+  /* Matrix functions */
+  void      may_mat_init      (may_mat_ptr, unsigned int, unsigned int);
+  void      may_mat_resize    (may_mat_ptr, unsigned int, unsigned int);
+  unsigned int may_mat_row    (may_mat_srcptr);
+  unsigned int may_mat_col    (may_mat_srcptr);
+  may_t     may_mat_at        (may_mat_srcptr, unsigned int, unsigned int);
+  void      may_mat_set_at    (may_mat_ptr, unsigned int, unsigned int, may_t);
+  void      may_mat_set       (may_mat_ptr, may_mat_srcptr);
+  void      may_mat_swap      (may_mat_ptr, may_mat_ptr);
+  void      may_mat_compact   (may_mark_t, may_mat_ptr);
+  void      may_mat_set_list  (may_mat_ptr, may_t);
+  may_t     may_mat_get_list  (may_mat_srcptr);
+  void      may_mat_fill_y    (may_mat_ptr, may_t);
+  void      may_mat_identity  (may_mat_ptr, unsigned int, may_t);
+  void      may_mat_eval      (may_mat_ptr, may_mat_srcptr);
+  void      may_mat_add       (may_mat_ptr, may_mat_srcptr, may_mat_srcptr);
+  void      may_mat_sub       (may_mat_ptr, may_mat_srcptr, may_mat_srcptr);
+  void      may_mat_mul_y     (may_mat_ptr, may_mat_srcptr, may_t);
+  void      may_mat_mul       (may_mat_ptr, may_mat_srcptr, may_mat_srcptr);
+  void      may_mat_transpose (may_mat_ptr, may_mat_srcptr);
+  void      may_mat_extract   (may_mat_ptr, may_mat_srcptr, unsigned int,
+                               unsigned int, unsigned int, unsigned int);
+  void      may_mat_augment   (may_mat_ptr, may_mat_srcptr, may_mat_srcptr);
+  may_t     may_mat_trace     (may_mat_srcptr);
+  may_t     may_mat_det       (may_mat_srcptr);
+  unsigned int may_mat_rank   (may_mat_srcptr);
+  void      may_mat_solve     (may_mat_ptr, may_mat_srcptr, may_mat_srcptr);
+  void      may_mat_inverse   (may_mat_ptr, may_mat_srcptr);
+
   /* Define name of internal functions and variables */
   extern const char may_sqrt_name[];
   extern const char may_exp_name[];
@@ -0,0 +1,447 @@
+/* This file is part of the MAYLIB libray.
+   Copyright 2007-2018 Patrick Pelissier
+
+This Library is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This Library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with th Library; see the file COPYING.LESSER.txt.
+If not, write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston,
+MA 02110-1301, USA. */
+
+#include "may-impl.h"
+
+/* Multipoint evaluation and interpolation of univariate polynomials
+   modulo a word-size prime p < 2^32.
+   A polynomial of size n is the contiguous array of its n coefficients
+   f[0] + f[1]*x + ... + f[n-1]*x^(n-1), reduced modulo p.
+   Below MAY_MULTIEVAL_THRESHOLD points, the polynomial is evaluated by
+   the Horner scheme on all the points at once (the inner loop runs over
+   the contiguous array of the points). Below MAY_MULTIPOINT_THRESHOLD
+   points, it is interpolated by the Lagrange formula.
+   Otherwise the subproduct tree of the points is built: the node j of
+   the level k is the product of the (x-pts[i]) for the 2^k points
+   i of [j*2^k, (j+1)*2^k[. The polynomial is reduced down the tree to
+   its values (evaluation), or the values are combined up the tree
+   (interpolation).
+   The temporary memory is allocated in the heap of the kernel. */
+
+unsigned long
+may_powmod_ui (unsigned long a, unsigned long e, unsigned long p)
+{
+  unsigned long r = 1;
+  while (e != 0) {
+    if (e & 1)
+      r = may_mulmod_ui (r, a, p);
+    a = may_mulmod_ui (a, a, p);
+    e >>= 1;
+  }
+  return r;
+}
+
+unsigned long
+may_invmod_ui (unsigned long a, unsigned long p)
+{
+  MAY_ASSERT (a % p != 0);
+  return may_powmod_ui (a, p - 2, p);
+}
+
+/* r[j] = f(pts[j]) for j in [0, npts[ by the Horner scheme */
+static void
+multieval_horner (unsigned long r[], unsigned long n, const unsigned long f[],
+                  unsigned long npts, const unsigned long pts[],
+                  unsigned long p)
+{
+  unsigned long i, j;
+
+  for (j = 0; j < npts; j++)
+    r[j] = n == 0 ? 0 : f[n-1];
+  if (n == 0)
+    return;
+  for (i = n - 1; i-- > 0; )
+    for (j = 0; j < npts; j++)
+      r[j] = may_addmod_ui (may_mulmod_ui (r[j], pts[j], p), f[i], p);
+}
+
+/* Size from which the products are computed by Karatsuba, and the
+   remainders by the Newton inverse */
+#define MULTIPOINT_KARA_THRESHOLD 32
+
+/* r = a * b with a of size na and b of size nb (r of size na+nb-1).
+   r must not overlap a or b */
+static void
+multipoint_mul (unsigned long r[], unsigned long na, const unsigned long a[],
+                unsigned long nb, const unsigned long b[], unsigned long p)
+{
+  unsigned long i, j, h;
+
+  if (na < nb) {
+    swap (na, nb);
+    swap (a, b);
+  }
+  for (i = 0; i < na + nb - 1; i++)
+    r[i] = 0;
+  if (nb < MULTIPOINT_KARA_THRESHOLD) {
+    for (i = 0; i < na; i++)
+      if (a[i] != 0)
+        for (j = 0; j < nb; j++)
+          r[i+j] = may_addmod_ui (r[i+j], may_mulmod_ui (a[i], b[j], p), p);
+    return;
+  }
+
+  may_mark ();
+  h = (na + 1) / 2;
+  if (nb <= h) {
+    /* Unbalanced: multiply b by the slices of a of size nb */
+    unsigned long *t = may_alloc (2 * nb * sizeof *t);
+    for (i = 0; i < na; i += nb) {
+      unsigned long n = MIN (nb, na - i);
+      multipoint_mul (t, n, a + i, nb, b, p);
+      for (j = 0; j < n + nb - 1; j++)
+        r[i+j] = may_addmod_ui (r[i+j], t[j], p);
+    }
+    may_keep (NULL);
+    return;
+  }
+  /* Karatsuba: a = a0 + x^h*a1 and b = b0 + x^h*b1 with
+     a*b = z0 + x^h*((a0+a1)*(b0+b1)-z0-z2) + x^(2h)*z2 */
+  unsigned long n2 = na + nb - 2*h - 1;
+  unsigned long *sa = may_alloc (h * sizeof *sa);
+  unsigned long *sb = may_alloc (h * sizeof *sb);
+  unsigned long *z = may_alloc ((2*h - 1) * sizeof *z);
+  for (i = 0; i < h; i++) {
+    sa[i] = i < na - h ? may_addmod_ui (a[i], a[h+i], p) : a[i];
+    sb[i] = i < nb - h ? may_addmod_ui (b[i], b[h+i], p) : b[i];
+  }
+  multipoint_mul (z, h, sa, h, sb, p);
+  for (i = 0; i < 2*h - 1; i++)
+    r[h+i] = z[i];
+  multipoint_mul (z, h, a, h, b, p);
+  for (i = 0; i < 2*h - 1; i++) {
+    r[i] = may_addmod_ui (r[i], z[i], p);
+    r[h+i] = may_submod_ui (r[h+i], z[i], p);
+  }
+  multipoint_mul (z, na - h, a + h, nb - h, b + h, p);
+  for (i = 0; i < n2; i++) {
+    r[2*h+i] = may_addmod_ui (r[2*h+i], z[i], p);
+    r[h+i] = may_submod_ui (r[h+i], z[i], p);
+  }
+  may_keep (NULL);
+}
+
+/* g = 1/h mod x^n with h of size nh and h[0] = 1 (Newton iteration:
+   g = g + g*(1-h*g) doubles the precision) */
+static void
+multipoint_inv (unsigned long g[], unsigned long n,
+                unsigned long nh, const unsigned long h[], unsigned long p)
+{
+  unsigned long prec, next, i, *t, *u;
+
+  MAY_ASSERT (h[0] == 1);
+  may_mark ();
+  t = may_alloc (2 * n * sizeof *t);
+  u = may_alloc (2 * n * sizeof *u);
+  g[0] = 1;
+  for (prec = 1; prec < n; prec = next) {
+    next = MIN (2 * prec, n);
+    /* t = 1 - h*g mod x^next: its prec first coefficients are 0 */
+    multipoint_mul (t, MIN (nh, next), h, prec, g, p);
+    for (i = MIN (nh, next) + prec - 1; i < next; i++)
+      t[i] = 0;
+    for (i = prec; i < next; i++)
+      t[i] = may_submod_ui (0, t[i], p);
+    multipoint_mul (u, next - prec, t + prec, prec, g, p);
+    for (i = prec; i < next; i++)
+      g[i] = u[i - prec];
+  }
+  may_keep (NULL);
+}
+
+/* Replace a of size na by its remainder by the monic polynomial m
+   of degree d (of size d+1) */
+static void
+multipoint_rem (unsigned long na, unsigned long a[],
+                unsigned long d, const unsigned long m[], unsigned long p)
+{
+  unsigned long i, j, l = na - d;
+
+  MAY_ASSERT (m[d] == 1 && na > d);
+  if (l < MULTIPOINT_KARA_THRESHOLD || d < MULTIPOINT_KARA_THRESHOLD) {
+    for (i = na; i-- > d; ) {
+      unsigned long q = a[i];
+      if (q != 0)
+        for (j = 0; j < d; j++)
+          a[i-d+j] = may_submod_ui (a[i-d+j], may_mulmod_ui (q, m[j], p), p);
+      a[i] = 0;
+    }
+    return;
+  }
+  /* The reversed quotient is rev(a) / rev(m) mod x^l */
+  may_mark ();
+  unsigned long *rm = may_alloc ((d + 1) * sizeof *rm);
+  unsigned long *ra = may_alloc (l * sizeof *ra);
+  unsigned long *g = may_alloc (l * sizeof *g);
+  unsigned long *t = may_alloc (MAX (2*l, l + d) * sizeof *t);
+  unsigned long *q = may_alloc (l * sizeof *q);
+  for (i = 0; i <= d; i++)
+    rm[i] = m[d-i];
+  for (i = 0; i < l; i++)
+    ra[i] = a[na-1-i];
+  multipoint_inv (g, l, d + 1, rm, p);
+  multipoint_mul (t, l, ra, l, g, p);
+  for (i = 0; i < l; i++)
+    q[i] = t[l-1-i];
+  /* a = a - q*m */
+  multipoint_mul (t, l, q, d, m, p);
+  for (i = 0; i < d; i++)
+    a[i] = may_submod_ui (a[i], t[i], p);
+  for (i = d; i < na; i++)
+    a[i] = 0;
+  may_keep (NULL);
+}
+
+/* The subproduct tree of n points */
+typedef struct {
+  unsigned long n, levels;
+  unsigned long **node;         /* node[k] + j*(2^k+1) = node j of level k */
+} multipoint_tree_t;
+
+/* Return the number of points of the node j of the level k */
+MAY_INLINE unsigned long
+tree_size (const multipoint_tree_t *t, unsigned long k, unsigned long j)
+{
+  unsigned long b = j << k, e = (j + 1) << k;
+  return (e > t->n ? t->n : e) - b;
+}
+
+MAY_INLINE unsigned long *
+tree_node (const multipoint_tree_t *t, unsigned long k, unsigned long j)
+{
+  return t->node[k] + j * ((1UL << k) + 1);
+}
+
+static void
+tree_init (multipoint_tree_t *t, unsigned long n, const unsigned long pts[],
+           unsigned long p)
+{
+  unsigned long k, j, nodes;
+
+  t->n = n;
+  for (t->levels = 1; (1UL << (t->levels - 1)) < n; t->levels++);
+  t->node = may_alloc (t->levels * sizeof *t->node);
+  t->node[0] = may_alloc (2 * n * sizeof *t->node[0]);
+  for (j = 0; j < n; j++) {
+    t->node[0][2*j] = pts[j] == 0 ? 0 : p - pts[j];
+    t->node[0][2*j+1] = 1;
+  }
+  for (k = 1, nodes = (n + 1) / 2; k < t->levels; k++, nodes = (nodes + 1) / 2) {
+    t->node[k] = may_alloc (nodes * ((1UL << k) + 1) * sizeof *t->node[k]);
+    for (j = 0; j < nodes; j++) {
+      unsigned long s0 = tree_size (t, k-1, 2*j);
+      unsigned long *r = tree_node (t, k, j), *a = tree_node (t, k-1, 2*j);
+      if (s0 == tree_size (t, k, j))
+        memcpy (r, a, (s0 + 1) * sizeof *r);
+      else
+        multipoint_mul (r, s0 + 1, a, tree_size (t, k-1, 2*j+1) + 1,
+                        tree_node (t, k-1, 2*j+1), p);
+    }
+  }
+}
+
+/* Evaluate f of size n on the points of the node j of the level k */
+static void
+tree_eval (unsigned long r[], const multipoint_tree_t *t,
+           unsigned long k, unsigned long j, const unsigned long pts[],
+           unsigned long n, const unsigned long f[], unsigned long p)
+{
+  unsigned long d = tree_size (t, k, j);
+  unsigned long *a;
+
+  if (d < MAY_MULTIPOINT_THRESHOLD || k == 0) {
+    multieval_horner (r + (j << k), n, f, d, pts + (j << k), p);
+    return;
+  }
+  /* a = f mod the node */
+  a = may_alloc (MAX (n, d) * sizeof *a);
+  memcpy (a, f, n * sizeof *a);
+  for (unsigned long i = n; i < d; i++)
+    a[i] = 0;
+  if (n > d)
+    multipoint_rem (n, a, d, tree_node (t, k, j), p);
+  tree_eval (r, t, k-1, 2*j, pts, d, a, p);
+  if (tree_size (t, k-1, 2*j) < d)
+    tree_eval (r, t, k-1, 2*j+1, pts, d, a, p);
+}
+
+/* r[j] = f(pts[j]) mod p for j in [0, npts[ with f of size n.
+   The points are evaluated by blocks of n points, so that f is
+   reduced at the root of the tree of each block */
+void
+may_multieval_ui (unsigned long r[], unsigned long n, const unsigned long f[],
+                  unsigned long npts, const unsigned long pts[],
+                  unsigned long p)
+{
+  multipoint_tree_t t;
+
+  MAY_ASSERT (p >= 2 && p <= 0xFFFFFFFFUL);
+  if (npts < MAY_MULTIEVAL_THRESHOLD || n < MAY_MULTIEVAL_THRESHOLD) {
+    multieval_horner (r, n, f, npts, pts, p);
+    return;
+  }
+  for (unsigned long i = 0; i < npts; i += n) {
+    unsigned long size = MIN (n, npts - i);
+    may_mark ();
+    tree_init (&t, size, pts + i, p);
+    tree_eval (r + i, &t, t.levels - 1, 0, pts + i, n, f, p);
+    may_keep (NULL);
+  }
+}
+
+/* Lagrange interpolation: f = sum (c[i] * m/(x-pts[i])) with m the
+   product of the (x-pts[i]) of size n+1.
+   If l is not NULL, the coefficients of c[i]*m/(x-pts[i]) are stored
+   in l[i*n] instead */
+static void
+interpolate_lagrange (unsigned long f[], unsigned long n,
+                      const unsigned long pts[], const unsigned long c[],
+                      const unsigned long m[], unsigned long *l,
+                      unsigned long p)
+{
+  unsigned long i, j, q;
+
+  for (j = 0; j < n; j++)
+    f[j] = 0;
+  for (i = 0; i < n; i++) {
+    if (c[i] == 0 && l == NULL)
+      continue;
+    /* Synthetic division of m by (x-pts[i]) */
+    q = 1;
+    for (j = n; j-- > 0; ) {
+      if (l != NULL)
+        l[i*n+j] = may_mulmod_ui (c[i], q, p);
+      else
+        f[j] = may_addmod_ui (f[j], may_mulmod_ui (c[i], q, p), p);
+      q = may_addmod_ui (m[j], may_mulmod_ui (q, pts[i], p), p);
+    }
+  }
+}
+
+/* Return in f (of size the number of points of the node) the combination
+   sum (c[i] * node/(x-pts[i])) for the points i of the node j of level k */
+static void
+tree_combine (unsigned long f[], const multipoint_tree_t *t,
+              unsigned long k, unsigned long j, const unsigned long pts[],
+              const unsigned long c[], unsigned long p)
+{
+  unsigned long d = tree_size (t, k, j), d0, d1;
+  unsigned long *f0, *f1, *tmp;
+
+  if (d < MAY_MULTIPOINT_THRESHOLD || k == 0) {
+    interpolate_lagrange (f, d, pts + (j << k), c + (j << k),
+                          tree_node (t, k, j), NULL, p);
+    return;
+  }
+  d0 = tree_size (t, k-1, 2*j);
+  if (d0 == d) {
+    tree_combine (f, t, k-1, 2*j, pts, c, p);
+    return;
+  }
+  d1 = d - d0;
+  f0 = may_alloc (d0 * sizeof *f0);
+  f1 = may_alloc (d1 * sizeof *f1);
+  tmp = may_alloc ((d + 1) * sizeof *tmp);
+  tree_combine (f0, t, k-1, 2*j, pts, c, p);
+  tree_combine (f1, t, k-1, 2*j+1, pts, c, p);
+  /* f = f0 * node1 + f1 * node0 */
+  multipoint_mul (tmp, d0, f0, d1 + 1, tree_node (t, k-1, 2*j+1), p);
+  memcpy (f, tmp, d * sizeof *f);
+  multipoint_mul (tmp, d1, f1, d0 + 1, tree_node (t, k-1, 2*j), p);
+  for (unsigned long i = 0; i < d; i++)
+    f[i] = may_addmod_ui (f[i], tmp[i], p);
+}
+
+/* Return in f+c*n the polynomial of size n such that f[c*n+k](pts[i])
+   = val[c*n+i] mod p for the n distinct points pts[i], and for the count
+   vectors of values c in [0, count[ (the weights of the points are
+   computed once) */
+void
+may_interpolate_ui (unsigned long f[], unsigned long n,
+                    const unsigned long pts[], unsigned long count,
+                    const unsigned long val[], unsigned long p)
+{
+  multipoint_tree_t t;
+  unsigned long i, j, k, *w, *c, *m;
+
+  MAY_ASSERT (p >= 2 && p <= 0xFFFFFFFFUL);
+  if (n == 0)
+    return;
+  may_mark ();
+  w = may_alloc (n * sizeof *w);
+  c = may_alloc (n * sizeof *c);
+  /* The Lagrange basis costs n^2 per vector of values once computed:
+     it remains faster than the tree up to about 3 times the threshold */
+  if (n < MAY_MULTIPOINT_THRESHOLD
+      || (count > 1 && n < 3 * MAY_MULTIPOINT_THRESHOLD)) {
+    /* m = product of the (x-pts[i]), and w[i] = 1/m'(pts[i]) */
+    m = may_alloc ((n + 1) * sizeof *m);
+    m[0] = 1;
+    for (i = 0; i < n; i++) {
+      m[i+1] = m[i];
+      for (j = i; j > 0; j--)
+        m[j] = may_submod_ui (m[j-1], may_mulmod_ui (pts[i], m[j], p), p);
+      m[0] = may_submod_ui (0, may_mulmod_ui (pts[i], m[0], p), p);
+    }
+    for (i = 0; i < n; i++) {
+      w[i] = 1;
+      for (j = 0; j < n; j++)
+        if (j != i)
+          w[i] = may_mulmod_ui (w[i], may_submod_ui (pts[i], pts[j], p), p);
+      w[i] = may_invmod_ui (w[i], p);
+    }
+    if (count == 1) {
+      for (i = 0; i < n; i++)
+        c[i] = may_mulmod_ui (val[i], w[i], p);
+      interpolate_lagrange (f, n, pts, c, m, NULL, p);
+      may_keep (NULL);
+      return;
+    }
+    /* f = sum (val[i] * l[i]) with l[i] the Lagrange basis polynomials */
+    unsigned long *l = may_alloc (n * n * sizeof *l);
+    interpolate_lagrange (c, n, pts, w, m, l, p);
+    for (k = 0; k < count; k++) {
+      unsigned long *fk = f + k*n;
+      for (j = 0; j < n; j++)
+        fk[j] = 0;
+      for (i = 0; i < n; i++) {
+        unsigned long vi = val[k*n+i];
+        if (vi != 0)
+          for (j = 0; j < n; j++)
+            fk[j] = may_addmod_ui (fk[j], may_mulmod_ui (vi, l[i*n+j], p), p);
+      }
+    }
+    may_keep (NULL);
+    return;
+  }
+  /* w[i] = 1/m'(pts[i]) with m the root of the tree */
+  tree_init (&t, n, pts, p);
+  m = tree_node (&t, t.levels - 1, 0);
+  for (i = 0; i < n; i++)
+    c[i] = may_mulmod_ui (m[i+1], i + 1, p);
+  tree_eval (w, &t, t.levels - 1, 0, pts, n, c, p);
+  for (i = 0; i < n; i++)
+    w[i] = may_invmod_ui (w[i], p);
+  for (k = 0; k < count; k++) {
+    for (i = 0; i < n; i++)
+      c[i] = may_mulmod_ui (val[k*n+i], w[i], p);
+    tree_combine (f + k*n, &t, t.levels - 1, 0, pts, c, p);
+  }
+  may_keep (NULL);
+}
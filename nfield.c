@@ -0,0 +1,319 @@
+/* This file is part of the MAYLIB libray.
+   Copyright 2007-2018 Patrick Pelissier
+
+This Library is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This Library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with th Library; see the file COPYING.LESSER.txt.
+If not, write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston,
+MA 02110-1301, USA. */
+
+#include "may-impl.h"
+
+/* Arithmetic in an algebraic number field K = Q[y]/(m(y)), with m
+   a monic polynomial of degree n over the rationals.
+   An element of K is the dense vector of the n rational coefficients
+   of its representative of degree < n (See may_nf_t).
+   The product of two elements is a dense product followed by its
+   reduction modulo m, which only goes through the non zero coefficients
+   of m (a sparse m like y^n-y-1 is cheap even for a big n).
+   All the memory is allocated in the heap of the kernel. */
+
+/* Allocate a dense vector of n null rationals */
+static mpq_t *
+nf_vector (unsigned long n)
+{
+  mpq_t *v = may_alloc (n * sizeof *v);
+  for (unsigned long i = 0; i < n; i++)
+    mpq_init (v[i]);
+  return v;
+}
+
+/* Return the degree of the dense polynomial p of size n (-1 if zero) */
+static long
+nf_degree (long n, mpq_t p[])
+{
+  while (n > 0 && mpq_sgn (p[n-1]) == 0)
+    n--;
+  return n-1;
+}
+
+/* Initialize the field K = Q[y]/(m) with m = sum(m[i]*y^i, i=0..n)
+   and m[n] != 0 (m is made monic) */
+void
+may_nf_init (may_nf_t K, unsigned long n, mpq_t m[])
+{
+  unsigned long i;
+
+  MAY_ASSERT (n >= 1 && mpq_sgn (m[n]) != 0);
+  K->n = n;
+  K->m = nf_vector (n);
+  K->support = may_alloc (n * sizeof *K->support);
+  K->nsupport = 0;
+  for (i = 0; i < n; i++) {
+    mpq_div (K->m[i], m[i], m[n]);
+    if (mpq_sgn (K->m[i]) != 0)
+      K->support[K->nsupport++] = i;
+  }
+}
+
+/* t = t - c * y^k * m (without its leading term) */
+static void
+nf_submul_m (const may_nf_t K, mpq_t t[], unsigned long k, mpq_t c)
+{
+  mpq_t u;
+
+  mpq_init (u);
+  for (unsigned long s = 0; s < K->nsupport; s++) {
+    unsigned long j = K->support[s];
+    mpq_mul (u, c, K->m[j]);
+    mpq_sub (t[k+j], t[k+j], u);
+  }
+}
+
+/* Return a new null element of K */
+mpq_t *
+may_nf_new (const may_nf_t K)
+{
+  return nf_vector (K->n);
+}
+
+void
+may_nf_set (const may_nf_t K, mpq_t r[], mpq_t a[])
+{
+  for (unsigned long i = 0; i < K->n; i++)
+    mpq_set (r[i], a[i]);
+}
+
+void
+may_nf_set_ui (const may_nf_t K, mpq_t r[], unsigned long c)
+{
+  mpq_set_ui (r[0], c, 1);
+  for (unsigned long i = 1; i < K->n; i++)
+    mpq_set_ui (r[i], 0, 1);
+}
+
+int
+may_nf_equal_p (const may_nf_t K, mpq_t a[], mpq_t b[])
+{
+  for (unsigned long i = 0; i < K->n; i++)
+    if (!mpq_equal (a[i], b[i]))
+      return 0;
+  return 1;
+}
+
+/* Reduce the dense polynomial t of size 2n-1 into r:
+   y^(n+i) is replaced by -y^i*(m-y^n) from the highest degree */
+static void
+nf_reduce (const may_nf_t K, mpq_t r[], mpq_t t[])
+{
+  unsigned long i, j, n = K->n;
+
+  for (i = n-1; i-- > 0; )
+    if (mpq_sgn (t[n+i]) != 0)
+      nf_submul_m (K, t, i, t[n+i]);
+  for (j = 0; j < n; j++)
+    mpq_set (r[j], t[j]);
+}
+
+/* r = a * b */
+void
+may_nf_mul (const may_nf_t K, mpq_t r[], mpq_t a[], mpq_t b[])
+{
+  unsigned long i, j, n = K->n;
+  mpq_t *t = nf_vector (2*n-1), c;
+
+  mpq_init (c);
+  for (i = 0; i < n; i++)
+    if (mpq_sgn (a[i]) != 0)
+      for (j = 0; j < n; j++) {
+        mpq_mul (c, a[i], b[j]);
+        mpq_add (t[i+j], t[i+j], c);
+      }
+  nf_reduce (K, r, t);
+}
+
+/* r = a ^ e */
+void
+may_nf_pow_ui (const may_nf_t K, mpq_t r[], mpq_t a[], unsigned long e)
+{
+  mpq_t *b = may_nf_new (K);
+
+  may_nf_set (K, b, a);
+  may_nf_set_ui (K, r, 1);
+  while (e != 0) {
+    if (e & 1)
+      may_nf_mul (K, r, r, b);
+    e >>= 1;
+    if (e != 0)
+      may_nf_mul (K, b, b, b);
+  }
+}
+
+/* Replace the dense polynomial a (of degree da) by its remainder by b
+   (of degree db >= 0). If q is not NULL, store the quotient in q.
+   Return the degree of the remainder */
+static long
+nf_divrem (mpq_t q[], mpq_t a[], long da, mpq_t b[], long db)
+{
+  mpq_t c, t;
+
+  mpq_init (c);
+  mpq_init (t);
+  if (q != NULL)
+    for (long i = 0; i <= da - db; i++)
+      mpq_set_ui (q[i], 0, 1);
+  for ( ; da >= db; da = nf_degree (da, a)) {
+    mpq_div (c, a[da], b[db]);
+    if (q != NULL)
+      mpq_set (q[da-db], c);
+    for (long i = 0; i <= db; i++) {
+      mpq_mul (t, c, b[i]);
+      mpq_sub (a[da-db+i], a[da-db+i], t);
+    }
+    MAY_ASSERT (mpq_sgn (a[da]) == 0);
+  }
+  return da;
+}
+
+/* r = 1/a. Return 0 if a is not invertible (m is not irreducible) */
+int
+may_nf_inv (const may_nf_t K, mpq_t r[], mpq_t a[])
+{
+  unsigned long n = K->n;
+  mpq_t *r0 = nf_vector (n+1), *r1 = nf_vector (n+1);
+  mpq_t *s0 = nf_vector (n+1), *s1 = nf_vector (n+1);
+  mpq_t *q = nf_vector (n+1), t;
+  long d0, d1;
+
+  /* Extended euclidean algorithm: s_i * a = r_i mod m */
+  mpq_init (t);
+  for (unsigned long i = 0; i < n; i++) {
+    mpq_set (r0[i], K->m[i]);
+    mpq_set (r1[i], a[i]);
+  }
+  mpq_set_ui (r0[n], 1, 1);
+  mpq_set_ui (s1[0], 1, 1);
+  d0 = n;
+  d1 = nf_degree (n, r1);
+  while (d1 > 0) {
+    long dq = d0 - d1;
+    d0 = nf_divrem (q, r0, d0, r1, d1);
+    /* s0 = s0 - q * s1 */
+    for (long i = 0; i <= dq; i++)
+      if (mpq_sgn (q[i]) != 0)
+        for (unsigned long j = 0; i + j < n; j++) {
+          mpq_mul (t, q[i], s1[j]);
+          mpq_sub (s0[i+j], s0[i+j], t);
+        }
+    swap (r0, r1);
+    swap (s0, s1);
+    swap (d0, d1);
+  }
+  if (d1 < 0)
+    return 0;
+  for (unsigned long i = 0; i < n; i++)
+    mpq_div (r[i], s1[i], r1[0]);
+  return 1;
+}
+
+/* r = resultant (a, b) of the dense polynomials a of degree da and b
+   of degree db. a and b are destroyed */
+static void
+nf_resultant (mpq_t r, mpq_t a[], long da, mpq_t b[], long db)
+{
+  mpq_set_ui (r, 1, 1);
+  for (;;) {
+    if (db < 0) {
+      mpq_set_ui (r, 0, 1);
+      return;
+    }
+    if (db == 0) {
+      /* res (a, b0) = b0^da */
+      for (long i = 0; i < da; i++)
+        mpq_mul (r, r, b[0]);
+      return;
+    }
+    /* res (a, b) = (-1)^(da*db) * lc(b)^(da-dr) * res (b, a mod b) */
+    if ((da & db & 1) != 0)
+      mpq_neg (r, r);
+    long dr = nf_divrem (NULL, a, da, b, db);
+    for (long i = dr < 0 ? 0 : dr; i < da; i++)
+      mpq_mul (r, r, b[db]);
+    if (dr < 0) {
+      mpq_set_ui (r, 0, 1);
+      return;
+    }
+    swap (a, b);
+    da = db;
+    db = dr;
+  }
+}
+
+/* r = norm of a over Q = resultant (m, a) since m is monic */
+void
+may_nf_norm (mpq_t r, const may_nf_t K, mpq_t a[])
+{
+  unsigned long n = K->n;
+  mpq_t *m = nf_vector (n+1), *b = nf_vector (n);
+
+  for (unsigned long i = 0; i < n; i++) {
+    mpq_set (m[i], K->m[i]);
+    mpq_set (b[i], a[i]);
+  }
+  mpq_set_ui (m[n], 1, 1);
+  nf_resultant (r, m, n, b, nf_degree (n, b));
+}
+
+/* Set r to the polynomial p in the variable y (reduced modulo m).
+   Return 0 if p is not a polynomial in y with rational coefficients */
+int
+may_nf_set_upol (const may_nf_t K, mpq_t r[], may_t p, may_t y)
+{
+  unsigned long i, j, size, n = K->n;
+  may_t *tab;
+
+  if (may_zero_fastp (p)) {
+    may_nf_set_ui (K, r, 0);
+    return 1;
+  }
+  if (!may_upol2array (&size, &tab, p, y, true))
+    return 0;
+  for (i = 0; i < size; i++)
+    if (MAY_TYPE (tab[i]) != MAY_INT_T && MAY_TYPE (tab[i]) != MAY_RAT_T)
+      return 0;
+  /* Horner scheme: r = r * y + tab[i] */
+  mpq_t *t = nf_vector (n+1);
+  for (i = size; i-- > 0; ) {
+    mpq_set_ui (t[n], 0, 1);
+    for (j = n; j > 0; j--)
+      mpq_set (t[j], t[j-1]);
+    if (MAY_TYPE (tab[i]) == MAY_INT_T)
+      mpq_set_z (t[0], MAY_INT (tab[i]));
+    else
+      mpq_set (t[0], MAY_RAT (tab[i]));
+    if (mpq_sgn (t[n]) != 0)
+      nf_submul_m (K, t, 0, t[n]);
+  }
+  may_nf_set (K, r, t);
+  return 1;
+}
+
+/* Return the evaluated polynomial a in the expression y */
+may_t
+may_nf_get_upol (const may_nf_t K, mpq_t a[], may_t y)
+{
+  may_t *tab = may_alloc (K->n * sizeof *tab);
+  for (unsigned long i = 0; i < K->n; i++)
+    tab[i] = may_set_q (a[i]);
+  return may_array2upol (K->n, tab, y);
+}
@@ -0,0 +1,315 @@
+/* This file is part of the MAYLIB libray.
+   Copyright 2007-2018 Patrick Pelissier
+
+This Library is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This Library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with th Library; see the file COPYING.LESSER.txt.
+If not, write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston,
+MA 02110-1301, USA. */
+
+#include "may-impl.h"
+
+/* A rational function num/den of the generalized variables of
+   the expression (the symbols and the subexpressions which are not
+   rational operations), where:
+    + num and den are expanded polynomials,
+    + num and den are coprime,
+    + den is normalized: over the rationals, its coefficients are coprime
+      integers and the coefficient of its first non numerical term (in the
+      order of the sums of the kernel, which only depends on the monomials)
+      is positive. Otherwise this coefficient is 1.
+   The operations keep this representation incrementally, so that two
+   equal rational functions have the same num and den. */
+typedef struct {
+  may_t num, den;
+} normal_t;
+
+static void normal_rec (normal_t *r, may_t x);
+
+/* Return the gcd g of a and b and their cofactors a/g and b/g.
+   The numbers are units: their gcd is 1 */
+static may_t
+normal_gcd (may_t *ca, may_t *cb, may_t a, may_t b)
+{
+  may_t g;
+
+  if (MAY_PURENUM_P (a) || MAY_PURENUM_P (b)
+      || MAY_PURENUM_P (g = may_gcd2 (a, b))) {
+    *ca = a;
+    *cb = b;
+    return MAY_ONE;
+  }
+  *ca = may_divexact (a, g);
+  *cb = may_divexact (b, g);
+  MAY_ASSERT (*ca != NULL && *cb != NULL);
+  *ca = may_expand (*ca);
+  *cb = may_expand (*cb);
+  return may_expand (g);
+}
+
+/* Return the numerical coefficient of the term x of a sum */
+MAY_INLINE may_t
+normal_coeff (may_t x)
+{
+  return MAY_TYPE (x) == MAY_FACTOR_T ? MAY_AT (x, 0) : MAY_ONE;
+}
+
+/* Normalize the denominator of r (See normal_t) */
+static void
+normal_unit (normal_t *r)
+{
+  may_t c, lc, den = r->den;
+  may_t *it;
+  may_size_t i, n;
+
+  if (MAY_PURENUM_P (den)) {
+    if (den != MAY_ONE)
+      r->num = may_expand (may_div (r->num, den));
+    r->den = MAY_ONE;
+    return;
+  }
+  if (MAY_TYPE (den) == MAY_SUM_T)
+    it = MAY_AT_PTR (den, 0), n = MAY_NODE_SIZE (den);
+  else
+    it = &den, n = 1;
+  /* The leading coefficient is the one of the first non numerical term */
+  lc = normal_coeff (it[MAY_PURENUM_P (it[0]) ? 1 : 0]);
+  /* Over the rationals, c is the content of den (the gcd of the
+     numerators of its coefficients over the lcm of their denominators)
+     with the sign of lc. Otherwise, c is lc itself */
+  c = lc;
+  if (MAY_TYPE (lc) <= MAY_RAT_T && may_g.frame.intmod == NULL) {
+    mpq_t q;
+    mpq_init (q);
+    mpz_set_ui (mpq_denref (q), 1);
+    for (i = 0; i < n; i++) {
+      may_t ci = MAY_PURENUM_P (it[i]) ? it[i] : normal_coeff (it[i]);
+      if (MAY_TYPE (ci) == MAY_INT_T)
+        mpz_gcd (mpq_numref (q), mpq_numref (q), MAY_INT (ci));
+      else if (MAY_TYPE (ci) == MAY_RAT_T) {
+        mpz_gcd (mpq_numref (q), mpq_numref (q), mpq_numref (MAY_RAT (ci)));
+        mpz_lcm (mpq_denref (q), mpq_denref (q), mpq_denref (MAY_RAT (ci)));
+      } else
+        break;
+    }
+    if (i == n) {
+      if (may_num_neg_p (lc))
+        mpz_neg (mpq_numref (q), mpq_numref (q));
+      c = may_mpq_simplify (NULL, q);
+    }
+  }
+  if (MAY_ONE_P (c))
+    return;
+  c = may_eval (may_div_c (MAY_ONE, c));
+  r->num = may_expand (may_mul (c, r->num));
+  r->den = may_expand (may_mul (c, r->den));
+}
+
+/* r = a + b */
+static void
+normal_add (normal_t *r, const normal_t *a, const normal_t *b)
+{
+  may_t a1, b1, n, g;
+
+  if (a->den == MAY_ONE && b->den == MAY_ONE) {
+    r->num = may_expand (may_add (a->num, b->num));
+    r->den = MAY_ONE;
+    return;
+  }
+  /* a/b1 + c/d1 with b1 = g*bb and d1 = g*dd:
+     n = a*dd + c*bb is coprime with bb*dd, so only the gcd
+     of n and g remains to be removed */
+  g = normal_gcd (&a1, &b1, a->den, b->den);
+  n = may_expand (may_add (may_mul (a->num, b1), may_mul (b->num, a1)));
+  if (MAY_UNLIKELY (may_zero_fastp (n))) {
+    r->num = MAY_ZERO;
+    r->den = MAY_ONE;
+    return;
+  }
+  if (g != MAY_ONE)
+    normal_gcd (&n, &g, n, g);
+  r->num = n;
+  r->den = may_expand (may_eval (may_mul_vac (a1, b1, g, NULL)));
+  normal_unit (r);
+}
+
+/* r = a * b: the gcds of the crossed numerators and denominators
+   are removed */
+static void
+normal_mul (normal_t *r, const normal_t *a, const normal_t *b)
+{
+  may_t an, ad, bn, bd;
+
+  if (MAY_UNLIKELY (may_zero_fastp (a->num) || may_zero_fastp (b->num))) {
+    r->num = MAY_ZERO;
+    r->den = MAY_ONE;
+    return;
+  }
+  an = a->num, ad = a->den, bn = b->num, bd = b->den;
+  if (bd != MAY_ONE)
+    normal_gcd (&an, &bd, an, bd);
+  if (ad != MAY_ONE)
+    normal_gcd (&bn, &ad, bn, ad);
+  r->num = may_expand (may_mul (an, bn));
+  r->den = may_expand (may_mul (ad, bd));
+  normal_unit (r);
+}
+
+/* r = a^n with n an integer: num^n and den^n remain coprime */
+static void
+normal_pow (normal_t *r, const normal_t *a, may_t n)
+{
+  MAY_ASSERT (MAY_TYPE (n) == MAY_INT_T);
+  may_t num = a->num, den = a->den;
+  if (mpz_sgn (MAY_INT (n)) < 0) {
+    if (MAY_UNLIKELY (may_zero_fastp (num))) {
+      /* Let the kernel handle the division by zero */
+      r->num = may_eval (may_pow_c (num, n));
+      r->den = MAY_ONE;
+      return;
+    }
+    swap (num, den);
+    n = may_neg (n);
+  }
+  r->num = may_expand (may_pow (num, n));
+  r->den = may_expand (may_pow (den, n));
+  normal_unit (r);
+}
+
+/* Return the normal form of the sum of the size terms of tab.
+   The terms are normalized on the worker threads, and then added
+   pairwise up a balanced binary tree as for may_comdenom.
+   The terms without denominator are added at once. */
+static void
+normal_sum (normal_t *r, may_size_t size, const may_t *tab)
+{
+  may_mark_t mark;
+  normal_t *t, *t2;
+  may_t poly;
+  may_size_t j, n;
+
+  may_mark (mark);
+  t = may_alloc ((size + 1) * sizeof *t);
+  MAY_SPAWN_FOR (mark, i, 0, (may_int_t) size, (t, tab), {
+      normal_rec (&t[i], tab[i]);
+    });
+  poly = MAY_NODE_C (MAY_SUM_T, size);
+  for (j = n = 0; j < size; j++)
+    if (t[j].den == MAY_ONE)
+      MAY_SET_AT (poly, n++, t[j].num);
+    else
+      t[j - n] = t[j];
+  MAY_NODE_SIZE (poly) = n;
+  size -= n;
+  t[size].num = n == 0 ? MAY_ZERO : may_expand (may_eval (poly));
+  t[size].den = MAY_ONE;
+  size++;
+
+  t2 = may_alloc (size * sizeof *t2);
+  while (size > 1) {
+    may_int_t half = size / 2;
+    MAY_SPAWN_FOR (mark, i, 0, half, (t, t2), {
+        normal_add (&t2[i], &t[2*i], &t[2*i+1]);
+      });
+    if (size % 2 != 0)
+      t2[half] = t[size-1];
+    size = (size + 1) / 2;
+    swap (t, t2);
+  }
+  may_t result[2] = { t[0].num, t[0].den };
+  may_compact_v (mark, 2, result);
+  r->num = result[0];
+  r->den = result[1];
+}
+
+/* Compute the normal form r of x */
+static void
+normal_rec (normal_t *r, may_t x)
+{
+  normal_t a, b;
+  may_size_t i, n;
+
+  MAY_ASSERT (MAY_EVAL_P (x));
+  MAY_BUDGET_CHECK ();
+
+  switch (MAY_TYPE (x)) {
+  case MAY_INT_T ... MAY_NUM_LIMIT:
+    r->num = x;
+    r->den = MAY_ONE;
+    return;
+  case MAY_SUM_T:
+    normal_sum (r, MAY_NODE_SIZE (x), MAY_AT_PTR (x, 0));
+    return;
+  case MAY_FACTOR_T:
+  case MAY_PRODUCT_T:
+    n = MAY_NODE_SIZE (x);
+    normal_rec (r, MAY_AT (x, 0));
+    for (i = 1; i < n; i++) {
+      normal_rec (&b, MAY_AT (x, i));
+      a = *r;
+      normal_mul (r, &a, &b);
+    }
+    return;
+  case MAY_POW_T:
+    if (MAY_TYPE (MAY_AT (x, 1)) == MAY_INT_T) {
+      normal_rec (&a, MAY_AT (x, 0));
+      normal_pow (r, &a, MAY_AT (x, 1));
+      return;
+    }
+    break;
+  default:
+    break;
+  }
+  /* A generalized variable: normalize its arguments */
+  if (!MAY_ATOMIC_P (x) && !MAY_EXT_P (x)) {
+    may_t y = may_map (x, may_normal);
+    /* The evaluation may turn it into a rational operation */
+    if (MAY_TYPE (y) != MAY_TYPE (x) && (MAY_PURENUM_P (y)
+        || MAY_TYPE (y) == MAY_SUM_T || MAY_TYPE (y) == MAY_FACTOR_T
+        || MAY_TYPE (y) == MAY_PRODUCT_T || MAY_TYPE (y) == MAY_POW_T)) {
+      normal_rec (r, y);
+      return;
+    }
+    x = y;
+  }
+  r->num = x;
+  r->den = MAY_ONE;
+}
+
+may_t
+may_normal (may_t x)
+{
+  normal_t r;
+
+  MAY_LOG_FUNC (("%Y", x));
+  MAY_ASSERT (MAY_EVAL_P (x));
+
+  may_mark ();
+  normal_rec (&r, x);
+  return may_keep (r.den == MAY_ONE ? r.num : may_div (r.num, r.den));
+}
+
+int
+may_equal_p (may_t a, may_t b)
+{
+  normal_t r;
+
+  MAY_LOG_FUNC (("a='%Y' b='%Y'", a, b));
+  MAY_ASSERT (MAY_EVAL_P (a) && MAY_EVAL_P (b));
+
+  may_mark ();
+  normal_rec (&r, may_sub (a, b));
+  int ret = may_zero_fastp (r.num);
+  may_keep (NULL);
+  return ret;
+}
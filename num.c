@@ -22,6 +22,93 @@ MA 02110-1301, USA. */
 /* All the functions accept unevaluated args.
    Only simplify functions return evaluated args */
 
+/* Arithmetic modulo a small intmod.
+   If intmod fits in MAY_INTMOD_SMALL_BITS bits, the operations on
+   integers already reduced (in [0, intmod[) are performed on
+   machine words: a product is reduced with a Barrett reduction
+   using the precomputed inverse of the modulus (see may_intmod_s) */
+#if defined(__SIZEOF_INT128__) && GMP_NUMB_BITS == 64 && !defined(MAY_NO_INTMOD_FAST)
+# define MAY_INTMOD_FAST 1
+typedef unsigned __int128 may_intmod_dlimb_t;
+
+/* Return the small modulus if intmod is small, 0 otherwise */
+static inline mp_limb_t
+intmod_small (void)
+{
+  mpz_srcptr mod = MAY_INT (may_g.frame.intmod);
+  if (mpz_size (mod) != 1 || mpz_sgn (mod) < 0)
+    return 0;
+  mp_limb_t m = mpz_getlimbn (mod, 0);
+  if (MAY_UNLIKELY (m != may_g.intmod.m)) {
+    if (m < 2 || (m >> MAY_INTMOD_SMALL_BITS) != 0)
+      return 0;
+    /* Compute the Barrett inverse of the new modulus */
+    unsigned int s = GMP_NUMB_BITS - __builtin_clzl (m);
+    may_g.intmod.inv = (mp_limb_t) (((may_intmod_dlimb_t) 1 << (2*s)) / m);
+    may_g.intmod.s = s;
+    may_g.intmod.m = m;
+  }
+  return m;
+}
+
+/* Set *r to the residue x if it is already reduced modulo m */
+static inline int
+intmod_get (mp_limb_t *r, may_t x, mp_limb_t m)
+{
+  mpz_srcptr z = MAY_INT (x);
+  if (mpz_sgn (z) < 0 || mpz_size (z) > 1)
+    return 0;
+  *r = mpz_getlimbn (z, 0);
+  return *r < m;
+}
+
+/* Return (a*b) mod m with a, b < m (Barrett reduction) */
+static inline mp_limb_t
+intmod_mul (mp_limb_t a, mp_limb_t b, mp_limb_t m)
+{
+  const unsigned int s = may_g.intmod.s;
+  may_intmod_dlimb_t x = (may_intmod_dlimb_t) a * b;
+  /* x < 2^(2s): (x >> (s-1)) fits in a limb and q <= x/m < q+3 */
+  mp_limb_t q = (mp_limb_t) (((may_intmod_dlimb_t) (mp_limb_t) (x >> (s-1))
+                              * may_g.intmod.inv) >> (s+1));
+  mp_limb_t r = (mp_limb_t) x - q * m;
+  while (r >= m)
+    r -= m;
+  return r;
+}
+
+/* Return a^e mod m with a < m */
+static mp_limb_t
+intmod_pow (mp_limb_t a, unsigned long e, mp_limb_t m)
+{
+  mp_limb_t r = 1;
+  for ( ; e != 0; e >>= 1) {
+    if (e & 1)
+      r = intmod_mul (r, a, m);
+    a = intmod_mul (a, a, m);
+  }
+  return r;
+}
+
+/* Return the inverse of a modulo m, or 0 if it is not invertible */
+static mp_limb_t
+intmod_inv (mp_limb_t a, mp_limb_t m)
+{
+  /* Extended Euclid with signed cofactors: m < 2^62 so no overflow */
+  long u0 = 0, u1 = 1;
+  mp_limb_t r0 = m, r1 = a;
+  while (r1 != 0) {
+    mp_limb_t q = r0 / r1, t = r0 - q * r1;
+    long v = u0 - (long) q * u1;
+    r0 = r1, r1 = t;
+    u0 = u1, u1 = v;
+  }
+  if (r0 != 1)
+    return 0;
+  return u0 < 0 ? (mp_limb_t) (u0 + (long) m) : (mp_limb_t) u0;
+}
+#endif
+
 /* Support NON evaluated arg (May be called with MAY_DUMMY) */
 MAY_REGPARM int
 may_num_zero_p (may_t x)
@@ -250,10 +337,26 @@ may_mpz_simplify (may_t x)
 #endif
   /* Arithemic in Z/nZ. Simplify number according to modulo */
   if (MAY_UNLIKELY (may_g.frame.intmod != NULL)) {
-    mpz_t r;
-    mpz_init (r);
-    mpz_fdiv_r (r, MAY_INT (x), MAY_INT (may_g.frame.intmod));
-    x = MAY_MPZ_NOCOPY_C (r);
+#ifdef MAY_INTMOD_FAST
+    mp_limb_t m = intmod_small (), r;
+    if (m != 0 && mpz_size (MAY_INT (x)) <= 1) {
+      /* Single limb: reduce without GMP */
+      if (!intmod_get (&r, x, m)) {
+        r = mpz_getlimbn (MAY_INT (x), 0) % m;
+        if (mpz_sgn (MAY_INT (x)) < 0 && r != 0)
+          r = m - r;
+        mpz_t z;
+        mpz_init_set_ui (z, r);
+        x = MAY_MPZ_NOCOPY_C (z);
+      }
+    } else
+#endif
+    {
+      mpz_t r;
+      mpz_init (r);
+      mpz_fdiv_r (r, MAY_INT (x), MAY_INT (may_g.frame.intmod));
+      x = MAY_MPZ_NOCOPY_C (r);
+    }
   }
   mp_limb_t t;
   /* Simplify number: Don't use mpz_cmpabs_ui, but mpz_size and mpz_getlimbn which are inlined  */
@@ -465,6 +568,16 @@ may_num_add (may_t dest, may_t op1, may_t op2)
     case MAY_INT_T:
       if (MAY_TYPE(dest) != MAY_INT_T)
         dest = MAY_INT_INIT_C ();
+#ifdef MAY_INTMOD_FAST
+      if (MAY_UNLIKELY (may_g.frame.intmod != NULL)) {
+        mp_limb_t m = intmod_small (), a, b;
+        if (m != 0 && intmod_get (&a, op1, m) && intmod_get (&b, op2, m)) {
+          a += b;
+          mpz_set_ui (MAY_INT (dest), a >= m ? a - m : a);
+          break;
+        }
+      }
+#endif
       mpz_add (MAY_INT (dest), MAY_INT (op1), MAY_INT (op2));
       break;
     case MAY_RAT_T:
@@ -612,6 +725,15 @@ may_num_sub (may_t dest, may_t op1, may_t op2)
     case MAY_INT_T:
       if (MAY_TYPE(dest) != MAY_INT_T)
         dest = MAY_INT_INIT_C ();
+#ifdef MAY_INTMOD_FAST
+      if (MAY_UNLIKELY (may_g.frame.intmod != NULL)) {
+        mp_limb_t m = intmod_small (), a, b;
+        if (m != 0 && intmod_get (&a, op1, m) && intmod_get (&b, op2, m)) {
+          mpz_set_ui (MAY_INT (dest), a >= b ? a - b : a + (m - b));
+          break;
+        }
+      }
+#endif
       mpz_sub (MAY_INT (dest), MAY_INT (op1), MAY_INT (op2));
       break;
     case MAY_RAT_T:
@@ -659,6 +781,15 @@ may_num_mul (may_t dest, may_t op1, may_t op2)
     case MAY_INT_T:
       if (MAY_TYPE (dest) != MAY_INT_T)
         dest = MAY_INT_INIT_C ();
+#ifdef MAY_INTMOD_FAST
+      if (MAY_UNLIKELY (may_g.frame.intmod != NULL)) {
+        mp_limb_t m = intmod_small (), a, b;
+        if (m != 0 && intmod_get (&a, op1, m) && intmod_get (&b, op2, m)) {
+          mpz_set_ui (MAY_INT (dest), intmod_mul (a, b, m));
+          break;
+        }
+      }
+#endif
       mpz_mul (MAY_INT (dest), MAY_INT (op1), MAY_INT (op2));
       break;
     case MAY_RAT_T:
@@ -770,6 +901,16 @@ may_num_invmod (may_t dest, may_t op)
   MAY_ASSERT (may_g.frame.intmod != NULL);
   if (MAY_TYPE(dest) != MAY_INT_T)
     dest = MAY_INT_INIT_C ();
+#ifdef MAY_INTMOD_FAST
+  mp_limb_t m = intmod_small (), a;
+  if (m != 0 && intmod_get (&a, op, m)) {
+    a = intmod_inv (a, m);
+    if (a == 0)
+      return MAY_NAN;
+    mpz_set_ui (MAY_INT (dest), a);
+    return dest;
+  }
+#endif
   i = mpz_invert (MAY_INT (dest), MAY_INT (op), MAY_INT (may_g.frame.intmod));
   return i == 0 ? MAY_NAN : dest;
 }
@@ -1013,6 +1154,14 @@ may_num_pow (may_t base, may_t expo)
 	/* INT^+INT */
         if (MAY_UNLIKELY (may_g.frame.intmod != NULL)) {
           /* (base raised to exp) % MOD */
+#ifdef MAY_INTMOD_FAST
+          mp_limb_t m = intmod_small (), a;
+          if (m != 0 && intmod_get (&a, base, m)
+              && mpz_fits_ulong_p (MAY_INT (expo))) {
+            mpz_init_set_ui (dest_z, intmod_pow (a, mpz_get_ui (MAY_INT (expo)), m));
+            return may_mpz_simplify (MAY_MPZ_NOCOPY_C (dest_z));
+          }
+#endif
           mpz_init (dest_z);
           mpz_powm (dest_z, MAY_INT (base), MAY_INT (expo),
                     MAY_INT (may_g.frame.intmod));
@@ -1034,6 +1183,17 @@ may_num_pow (may_t base, may_t expo)
         if (MAY_UNLIKELY (may_g.frame.intmod != NULL)) {
           /* (base raised to -expo) % MOD */
           mpz_t absexp;
+#ifdef MAY_INTMOD_FAST
+          mp_limb_t m = intmod_small (), a;
+          if (m != 0 && intmod_get (&a, base, m)
+              && mpz_cmp_si (MAY_INT (expo), -LONG_MAX) >= 0) {
+            a = intmod_inv (a, m);
+            if (a == 0)
+              return MAY_NAN;
+            mpz_init_set_ui (dest_z, intmod_pow (a, -mpz_get_si (MAY_INT (expo)), m));
+            return may_mpz_simplify (MAY_MPZ_NOCOPY_C (dest_z));
+          }
+#endif
           mpz_init (dest_z);
           /* Invert by ourself to avoid the potential "divide by 0" signal
              returned by GMP */
@@ -19,10 +19,56 @@ MA 02110-1301, USA. */
 
 #include "may-impl.h"
 
+/* Define the identifiers found in an expression view as a polynomial
+   with their maximum estimated exponent:
+   the identifiers are stored in a hash set (so that the lookup
+   doesn't depend on the number of identifiers), and their exponents
+   in a list at the same index */
+typedef struct {
+  may_hset_t var;
+  may_list_t expo;
+} polvar_t[1];
+
+static void
+polvar_init (polvar_t list)
+{
+  may_hset_init (list->var, 0);
+  may_list_init (list->expo, 0);
+}
+
+static void
+polvar_reset (polvar_t list)
+{
+  may_hset_reset (list->var);
+  may_list_resize (list->expo, 0);
+}
+
+static void
+polvar_swap (polvar_t list1, polvar_t list2)
+{
+  may_hset_swap (list1->var, list2->var);
+  may_list_swap (list1->expo, list2->expo);
+}
+
+/* Add x in list with the exponent expo,
+   or update its exponent if x is already in the list */
+static void
+polvar_update (polvar_t list, may_t x, may_t expo)
+{
+  may_size_t i, n;
+
+  n = may_hset_get_size (list->var);
+  i = may_hset_push_back (list->var, x);
+  if (i == n)
+    may_list_push_back (list->expo, expo);
+  else if (may_num_cmp (may_list_at (list->expo, i), expo) < 0)
+    may_list_set_at (list->expo, i, expo);
+}
+
 /* Add the identifiers found in x view as a polynomial to list
    with their maximum estimated exponent */
 static void
-add_polvar (may_list_t list, may_t x, may_t expo)
+add_polvar (polvar_t list, may_t x, may_t expo)
 {
   unsigned long i, n;
 
@@ -53,18 +99,7 @@ add_polvar (may_list_t list, may_t x, may_t expo)
     } /* else fall down to default */
     /* Falls through. */
   default:
-    /* Check if x is already in list */
-    n = may_list_get_size (list);
-    MAY_ASSERT ((n%2) == 0);
-    for (i = 0; i < n; i+=2)
-      if (may_identical (x, may_list_at (list, i)) == 0) {
-        if (may_num_cmp (may_list_at (list, i+1), expo) < 0)
-          may_list_set_at (list, i+1, expo);
-        return ;
-      }
-    /* Add x in the list */
-    may_list_push_back (list, x);
-    may_list_push_back (list, expo);
+    polvar_update (list, x, expo);
     break;
   }
 }
@@ -73,9 +108,9 @@ add_polvar (may_list_t list, may_t x, may_t expo)
 /* Add in 'list' the identifiers found in x view as a polynomial
    iff there are found in 'org' too (with their maximal extimated exponent) */
 static void
-remove_polvar (may_list_t list, may_list_t org, may_t x, may_t expo)
+remove_polvar (polvar_t list, polvar_t org, may_t x, may_t expo)
 {
-  unsigned long i, n;
+  may_size_t i, n;
 
   MAY_ASSERT (MAY_TYPE (expo) == MAY_INT_T);
 
@@ -105,27 +140,12 @@ remove_polvar (may_list_t list, may_list_t org, may_t x, may_t expo)
     /* Falls through. */
   default:
     /* Add x in list if it is found in org */
-    n = may_list_get_size (org);
-    MAY_ASSERT ((n%2) == 0);
-    for (i = 0; i < n; i+=2)
-      if (may_identical (x, may_list_at (org, i)) == 0) {
-        /* Keep the max between expo and previous one */
-        if (may_num_cmp (may_list_at (org,i+1), expo) > 0)
-          expo = may_list_at (org,i+1);
-        /* Check if x is already in list */
-        n = may_list_get_size (list);
-        MAY_ASSERT ((n%2) == 0);
-        for (i = 0; i < n; i+=2)
-          if (may_identical (x, may_list_at (list, i)) == 0) {
-            if (may_num_cmp (may_list_at (list, i+1), expo) < 0)
-              may_list_set_at (list, i+1, expo);
-            return ;
-          }
-        /* Add x in list */
-        may_list_push_back (list, x);
-        may_list_push_back (list, expo);
-        break;
-      }
+    if (may_hset_find (&i, org->var, x)) {
+      /* Keep the max between expo and previous one */
+      if (may_num_cmp (may_list_at (org->expo, i), expo) > 0)
+        expo = may_list_at (org->expo, i);
+      polvar_update (list, x, expo);
+    }
     break;
   }
 }
@@ -135,7 +155,7 @@ remove_polvar (may_list_t list, may_list_t org, may_t x, may_t expo)
 may_t
 may_find_one_polvar (unsigned long n, const may_t tab[])
 {
-  may_list_t list, list2;
+  polvar_t list, list2;
   may_t x, min;
   unsigned long i;
 
@@ -150,32 +170,32 @@ may_find_one_polvar (unsigned long n, const may_t tab[])
       return NULL;
 
   MAY_RECORD ();
-  may_list_init (list, 0);
+  polvar_init (list);
 
   /* Second pass: search for all commun vars */
   add_polvar (list, tab[0], MAY_ONE);
-  may_list_init (list2, may_list_get_size (list));
-  for (i = 1; i < n && may_list_get_size (list) > 0; i++) {
-    may_list_resize (list2, 0);
+  polvar_init (list2);
+  for (i = 1; i < n && may_hset_get_size (list->var) > 0; i++) {
+    polvar_reset (list2);
     remove_polvar (list2, list, tab[i], MAY_ONE);
-    may_list_swap (list, list2);
+    polvar_swap (list, list2);
   }
 
   /* If no comun var was found, return NULL */
-  n = may_list_get_size (list);
+  n = may_hset_get_size (list->var);
   if (MAY_UNLIKELY (n == 0))
     MAY_RET (NULL);
 
   /* Find the common var with the minimal exponent */
-  x   = may_list_at (list, 0);
-  min = may_list_at (list, 1);
-  for (i = 0; i < n; i+=2) {
-    may_t y = may_list_at (list, i);
+  x   = may_hset_at (list->var, 0);
+  min = may_list_at (list->expo, 0);
+  for (i = 0; i < n; i++) {
+    may_t y = may_hset_at (list->var, i);
     if (MAY_UNLIKELY (MAY_TYPE (y) == MAY_STRING_T
                       && (MAY_TYPE (x) != MAY_STRING_T
-                          || may_num_cmp (may_list_at (list, i+1), min) < 0))){
+                          || may_num_cmp (may_list_at (list->expo, i), min) < 0))){
       x   = y;
-      min = may_list_at (list, i+1);
+      min = may_list_at (list->expo, i);
     }
   }
 
@@ -191,42 +211,39 @@ may_find_one_polvar (unsigned long n, const may_t tab[])
 may_t
 may_find_unused_polvar (unsigned long n, const may_t tab[])
 {
-  may_list_t used, common, unused;
-  unsigned long i, j, nused, ncommon;
+  polvar_t used, common, temp;
+  may_list_t unused;
+  may_size_t i, j, nused;
 
   MAY_ASSERT (n >= 1);
 
   MAY_LOG_FUNC (("n=%d", (int)n));
 
   MAY_RECORD ();
-  may_list_init (used, 0);
+  polvar_init (used);
+  polvar_init (common);
+  polvar_init (temp);
 
   /* Search for all used and commun vars */
   add_polvar (used, tab[0], MAY_ONE);
-  may_list_init (common, may_list_get_size (used));
-  may_list_init (unused, may_list_get_size (used));
-  may_list_set (common, used);
+  add_polvar (common, tab[0], MAY_ONE);
 
   for (i = 1; i < n; i++) {
     add_polvar (used, tab[i], MAY_ONE);
-    if (may_list_get_size (common) > 0) {
-      may_list_resize (unused, 0);
-      remove_polvar (unused, common, tab[i], MAY_ONE);
-      may_list_set (common, unused);
+    if (may_hset_get_size (common->var) > 0) {
+      polvar_reset (temp);
+      remove_polvar (temp, common, tab[i], MAY_ONE);
+      polvar_swap (common, temp);
     }
   }
 
   /* Save in 'unused' all variables present in 'used' but not in 'commun' */
-  nused   = may_list_get_size (used);
-  ncommon = may_list_get_size (common);
-  may_list_resize (unused, 0);
-  for (i = 0; i < nused; i+=2) {
-    may_t t = may_list_at (used, i);
-    for (j = 0; j < ncommon; j+=2)
-      if (may_identical (t, may_list_at (common, j)) == 0)
-        break;
-    if (j == ncommon)
-      may_list_push_back_single (unused, t);
+  nused = may_hset_get_size (used->var);
+  may_list_init (unused, 0);
+  for (i = 0; i < nused; i++) {
+    may_t t = may_hset_at (used->var, i);
+    if (!may_hset_find (&j, common->var, t))
+      may_list_push_back (unused, t);
   }
   if (MAY_UNLIKELY (may_list_get_size (unused) == 0))
     MAY_RET (NULL);
@@ -238,7 +255,7 @@ may_find_unused_polvar (unsigned long n, const may_t tab[])
 
 /* Add the identifiers found in x view as a rational function to list */
 static void
-add_ratvar (may_list_t list, may_t x, may_indets_e flags)
+add_ratvar (may_hset_t list, may_t x, may_indets_e flags)
 {
   unsigned long i, n;
 
@@ -262,7 +279,7 @@ add_ratvar (may_list_t list, may_t x, may_indets_e flags)
       add_ratvar (list, MAY_AT (x, i), flags);
     break;
   case MAY_FUNC_T:
-    may_list_push_back_single (list, x);
+    may_hset_push_back (list, x);
     if ((flags & MAY_INDETS_RECUR) != 0)
       add_ratvar (list, MAY_AT (x, 1), flags);
     break;
@@ -273,7 +290,7 @@ add_ratvar (may_list_t list, may_t x, may_indets_e flags)
     } /* else fall down to default */
     /* Falls through. */
   default:
-    may_list_push_back_single (list, x);
+    may_hset_push_back (list, x);
     if (MAY_UNLIKELY ((flags & MAY_INDETS_RECUR) != 0 && MAY_NODE_P (x))) {
       n = MAY_NODE_SIZE(x);
       for (i = 0; i < n; i++)
@@ -291,16 +308,17 @@ cmp_ratvar (const may_t *a, const may_t *b) {
 may_t
 may_indets (may_t x, may_indets_e flags)
 {
-  may_list_t list;
+  may_hset_t list;
 
   MAY_LOG_FUNC (("x=%Y flags=%d", x, (int)flags));
 
   may_mark();
 
-  may_list_init (list, 0);
+  may_hset_init (list, 0);
   add_ratvar (list, x, flags);
-  may_list_sort (list, cmp_ratvar);
-  may_t y = may_list_quit (list);
+  /* The order of the elements is changed: the set is no longer usable */
+  may_list_sort (list->list, cmp_ratvar);
+  may_t y = may_hset_quit (list);
 
   return may_keep (may_eval (y));
 }
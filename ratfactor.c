@@ -91,11 +91,32 @@ ratfactor (may_t p, may_t x)
          Endif
        Endfor
    */
+  /* 3'. If m fits in a word and the coefficients of P are integers,
+     evaluate P at all the candidates at once modulo m */
+  unsigned long n, *coeff = NULL, *val = NULL;
+  may_t *tab;
+  if (im <= 0xFFFFFFFFUL && may_upol2array (&n, &tab, p, x, true)) {
+    coeff = may_alloc (n * sizeof *coeff);
+    for (unsigned long j = 0; j < n && coeff != NULL; j++)
+      if (MAY_TYPE (tab[j]) == MAY_INT_T)
+        coeff[j] = mpz_fdiv_ui (MAY_INT (tab[j]), im);
+      else
+        coeff = NULL;
+  }
+  if (coeff != NULL) {
+    unsigned long *pts = may_alloc (im * sizeof *pts);
+    val = may_alloc (im * sizeof *val);
+    for (unsigned long i = 0; i < im; i++)
+      pts[i] = i;
+    may_multieval_ui (val, n, coeff, im, pts, im);
+  }
+
   may_t result = MAY_ONE;
   /* 3. For each potential candidate */
   for (unsigned long i = 0; i < im; i++)
     /* if this candidate is 0 in Z/mZ */
-    if (MAY_ZERO_P (may_smod (may_replace (p, x, may_set_ui (i)), m))) {
+    if (val != NULL ? val[i] == 0
+        : MAY_ZERO_P (may_smod (may_replace (p, x, may_set_ui (i)), m))) {
       /* Rebuild it in Z */
       MAY_RECORD ();
       may_t xi = may_set_ui (i);
@@ -0,0 +1,558 @@
+/* This file is part of the MAYLIB libray.
+   Copyright 2007-2018 Patrick Pelissier
+
+This Library is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 3 of the License, or (at your
+option) any later version.
+
+This Library is distributed in the hope that it will be useful, but
+WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with th Library; see the file COPYING.LESSER.txt.
+If not, write to the Free Software Foundation, Inc.,
+51 Franklin St, Fifth Floor, Boston,
+MA 02110-1301, USA. */
+
+#include "may-impl.h"
+
+/* Resultant of two polynomials a and b of the variable x.
+   Two algorithms are available:
+    + the subresultant PRS, which works for any coefficients,
+    + a multimodular algorithm for the polynomials with integer coefficients
+      in the symbols of the expression, once their degree in x reaches
+      MAY_RESULTANT_MODULAR_THRESHOLD: the resultant is computed modulo
+      enough primes to recover its coefficients, each prime on a worker
+      thread. Modulo a prime, the other symbols are evaluated on a grid
+      of points, the univariate resultants are computed by the euclidean
+      algorithm, and the resultant is interpolated back.
+   The resultant is the determinant of the Sylvester matrix of a and b
+   for their degrees in x, so that the evaluation commutes with it when
+   the leading coefficients are kept in the formal degrees: there is no
+   unlucky evaluation point nor unlucky prime. */
+
+/* Maximum number of words of the values of the modular resultants */
+#define RESULTANT_MODULAR_MAX_SIZE (1UL << 22)
+
+/* Subresultant PRS (Cohen, Algorithm 3.3.7 without the contents).
+   a and b are expanded of degrees da >= 1 and db >= 1 in x */
+static may_t
+resultant_prs (may_t a, may_t b, may_t x, unsigned long da, unsigned long db)
+{
+  may_t g, h, cb, r, res;
+  mpz_srcptr dz;
+  unsigned long d;
+  int s = 1, retvalue;
+  UNUSED (retvalue);
+
+  if (da < db) {
+    swap (a, b);
+    swap (da, db);
+    if ((da & db & 1) != 0)
+      s = -1;
+  }
+  g = h = MAY_ONE;
+  may_mark ();
+  for (;;) {
+    retvalue = may_degree (&cb, &dz, NULL, b, 1, &x);
+    MAY_ASSERT (retvalue != 0 && mpz_cmp_ui (dz, db) == 0);
+    d = da - db;
+    if ((da & db & 1) != 0)
+      s = -s;
+
+    /* r = prem (a, b) = rem (lc(b)^(da-db+1)*a, b) */
+    if (!MAY_ONE_P (cb))
+      a = may_expand (may_eval (may_mul_c (may_pow_c (cb, may_set_ui (d+1)),
+                                           a)));
+    retvalue = may_div_qr (NULL, &r, a, b, x);
+    MAY_ASSERT (retvalue != 0);
+    if (may_zero_fastp (r))
+      return may_keep (MAY_ZERO);
+
+    /* a = b and b = r / (g*h^d) */
+    a = b;
+    da = db;
+    res = may_eval (may_mul_c (g, may_pow_c (h, may_set_ui (d))));
+    b = may_divexact (r, res);
+    MAY_ASSERT (b != NULL);
+    b = may_expand (b);
+    g = cb;
+    /* h = g^d / h^(d-1) */
+    if (d == 1)
+      h = g;
+    else if (d > 1) {
+      h = may_divexact (may_eval (may_pow_c (g, may_set_ui (d))),
+                        may_eval (may_pow_c (h, may_set_ui (d-1))));
+      MAY_ASSERT (h != NULL);
+      h = may_expand (h);
+    }
+
+    retvalue = may_degree (NULL, &dz, NULL, b, 1, &x);
+    MAY_ASSERT (retvalue != 0 && mpz_fits_ulong_p (dz));
+    db = mpz_get_ui (dz);
+    if (db == 0) {
+      /* res = b^da / h^(da-1) */
+      res = may_divexact (may_eval (may_pow_c (b, may_set_ui (da))),
+                          may_eval (may_pow_c (h, may_set_ui (da-1))));
+      MAY_ASSERT (res != NULL);
+      if (s < 0)
+        res = may_neg (res);
+      return may_keep (may_expand (res));
+    }
+
+    /* Keep a, b, g, h for the next step */
+    {
+      may_t ktab[4] = {a, b, g, h};
+      may_compact_v (4, ktab);
+      a = ktab[0];
+      b = ktab[1];
+      g = ktab[2];
+      h = ktab[3];
+    }
+  }
+}
+
+/* A polynomial with integer coefficients as an array of terms:
+   coefficient and exponents in x, var[0], ..., var[n-1] */
+typedef struct {
+  mpz_srcptr c;
+  unsigned long *e;
+} resultant_term_t;
+
+/* The modular problem shared by the worker threads */
+typedef struct {
+  unsigned long n;              /* Number of variables except x */
+  unsigned long da, db;         /* Degrees in x */
+  unsigned long na, nb;         /* Number of terms */
+  resultant_term_t *ta, *tb;    /* Terms of a and b */
+  unsigned long *deg;           /* Max degrees of a and b in var[i] */
+  unsigned long *size;          /* Number of points in var[i] */
+  unsigned long total;          /* Number of points of the grid */
+} resultant_modular_t;
+
+/* The computation modulo one prime */
+typedef struct {
+  const resultant_modular_t *pb;
+  unsigned long p;
+  unsigned long *val;           /* Coefficients of the resultant mod p */
+} resultant_prime_t;
+
+/* Return the resultant modulo p of the dense polynomials a and b of
+   formal degrees m and n (their leading coefficients may be 0).
+   a and b are destroyed */
+static unsigned long
+resultant_modp (unsigned long *a, unsigned long m,
+                unsigned long *b, unsigned long n, unsigned long p)
+{
+  unsigned long r = 1, c;
+  long i, j, k;
+
+  for (;;) {
+    if (n == 0)
+      return may_mulmod_ui (r, may_powmod_ui (b[0], m, p), p);
+    if (m == 0)
+      return may_mulmod_ui (r, may_powmod_ui (a[0], n, p), p);
+    if (a[m] == 0 && b[n] == 0)
+      return 0;
+    /* res (a, b) = lc(a) * res (a, b of degree n-1) if lc(b) = 0 */
+    if (b[n] == 0) {
+      r = may_mulmod_ui (r, a[m], p);
+      n--;
+      continue;
+    }
+    /* res (a, b) = (-1)^n * lc(b) * res (a of degree m-1, b) if lc(a) = 0 */
+    if (a[m] == 0) {
+      r = may_mulmod_ui (r, (n & 1) ? p - b[n] : b[n], p);
+      m--;
+      continue;
+    }
+    /* res (a, b) = (-1)^(m*n) * res (b, a) so that m >= n */
+    if (m < n) {
+      if ((m & n & 1) != 0)
+        r = (p - r) % p;
+      swap (a, b);
+      swap (m, n);
+    }
+    /* res (a, b) = (-1)^(m*n) * lc(b)^(m-deg(a mod b)) * res (b, a mod b) */
+    if ((m & n & 1) != 0)
+      r = (p - r) % p;
+    c = may_invmod_ui (b[n], p);
+    for (i = m; i >= (long) n; i--) {
+      unsigned long q = may_mulmod_ui (a[i], c, p);
+      if (q != 0)
+        for (j = 0, k = i - n; j <= (long) n; j++, k++)
+          a[k] = may_submod_ui (a[k], may_mulmod_ui (q, b[j], p), p);
+    }
+    for (i = n - 1; i >= 0 && a[i] == 0; i--);
+    if (i < 0)
+      return 0;
+    r = may_mulmod_ui (r, may_powmod_ui (b[n], m - i, p), p);
+    swap (a, b);
+    m = n;
+    n = i;
+  }
+}
+
+/* Evaluate at the point pt the polynomial of the terms t into the
+   dense polynomial r of degree d in x */
+static void
+resultant_eval (unsigned long *r, unsigned long d,
+                unsigned long nt, const resultant_term_t *t,
+                const unsigned long *c, unsigned long n,
+                unsigned long **pw, const unsigned long *pt,
+                const unsigned long *deg, unsigned long p)
+{
+  unsigned long i, j;
+
+  for (i = 0; i <= d; i++)
+    r[i] = 0;
+  for (i = 0; i < nt; i++) {
+    unsigned long v = c[i];
+    for (j = 0; j < n && v != 0; j++)
+      v = may_mulmod_ui (v, pw[j][pt[j] * (deg[j] + 1) + t[i].e[j+1]], p);
+    r[t[i].e[0]] = may_addmod_ui (r[t[i].e[0]], v, p);
+  }
+}
+
+/* Compute the coefficients of the resultant modulo the prime */
+static void
+resultant_prime (void *data)
+{
+  resultant_prime_t *task = data;
+  const resultant_modular_t *pb = task->pb;
+  unsigned long p = task->p, n = pb->n, *val = task->val;
+  unsigned long i, j, maxsize = 1;
+
+  /* Coefficients of a and b modulo p */
+  unsigned long *ca = may_alloc (pb->na * sizeof *ca);
+  unsigned long *cb = may_alloc (pb->nb * sizeof *cb);
+  for (i = 0; i < pb->na; i++)
+    ca[i] = mpz_fdiv_ui (pb->ta[i].c, p);
+  for (i = 0; i < pb->nb; i++)
+    cb[i] = mpz_fdiv_ui (pb->tb[i].c, p);
+
+  /* pw[j][k*(deg[j]+1)+e] = k^e for the points k of var[j] */
+  unsigned long **pw = may_alloc ((n + 1) * sizeof *pw);
+  for (j = 0; j < n; j++) {
+    unsigned long k, e, dj = pb->deg[j] + 1;
+    pw[j] = may_alloc (pb->size[j] * dj * sizeof *pw[j]);
+    for (k = 0; k < pb->size[j]; k++) {
+      pw[j][k*dj] = 1;
+      for (e = 1; e < dj; e++)
+        pw[j][k*dj+e] = may_mulmod_ui (pw[j][k*dj+e-1], k, p);
+    }
+    maxsize = MAX (maxsize, pb->size[j]);
+  }
+
+  /* Resultant on each point of the grid */
+  unsigned long *a = may_alloc ((pb->da + 1) * sizeof *a);
+  unsigned long *b = may_alloc ((pb->db + 1) * sizeof *b);
+  unsigned long *pt = may_alloc ((n + 1) * sizeof *pt);
+  for (j = 0; j < n; j++)
+    pt[j] = 0;
+  for (i = 0; i < pb->total; i++) {
+    resultant_eval (a, pb->da, pb->na, pb->ta, ca, n, pw, pt, pb->deg, p);
+    resultant_eval (b, pb->db, pb->nb, pb->tb, cb, n, pw, pt, pb->deg, p);
+    val[i] = resultant_modp (a, pb->da, b, pb->db, p);
+    /* Next point */
+    for (j = 0; j < n && ++pt[j] == pb->size[j]; j++)
+      pt[j] = 0;
+  }
+
+  /* Interpolate variable by variable: the lines of values along var[j]
+     are gathered to be interpolated at once on the points 0, 1, ... */
+  unsigned long *x = may_alloc (maxsize * sizeof *x);
+  unsigned long *v = may_alloc (pb->total * sizeof *v);
+  unsigned long *f = may_alloc (pb->total * sizeof *f);
+  for (i = 0; i < maxsize; i++)
+    x[i] = i;
+  unsigned long stride = 1;
+  for (j = 0; j < n; j++) {
+    unsigned long s = pb->size[j], k, l, m, c;
+    for (c = k = 0; k < pb->total; k += stride * s)
+      for (l = 0; l < stride; l++, c += s)
+        for (m = 0; m < s; m++)
+          v[c + m] = val[k + l + m * stride];
+    may_interpolate_ui (f, s, x, pb->total / s, v, p);
+    for (c = k = 0; k < pb->total; k += stride * s)
+      for (l = 0; l < stride; l++, c += s)
+        for (m = 0; m < s; m++)
+          val[k + l + m * stride] = f[c + m];
+    stride *= s;
+  }
+}
+
+/* Fill the terms t of the expanded polynomial a of degree d in x
+   with integer coefficients in the sorted variables var[0..n-1].
+   Update deg with the max degrees in var.
+   Return the number of terms, or 0 if a hasn't this form */
+static unsigned long
+resultant_terms (resultant_term_t **t, may_t a, may_t x, unsigned long n,
+                 const may_t var[], unsigned long *deg)
+{
+  may_t *it;
+  unsigned long i, j, nt;
+  may_size_t index_var[n+1];
+  may_t new_var[n+1];
+  mpz_srcptr d[n+1], tempdeg[n+1];
+  may_t tempsum[n+1];
+
+  /* Insert x in the sorted variables at the position px,
+     and keep its degree in first position */
+  unsigned long px;
+  for (px = 0; px < n && may_identical (var[px], x) < 0; px++);
+  for (i = 0; i <= n; i++) {
+    new_var[i] = i < px ? var[i] : i == px ? x : var[i-1];
+    index_var[i] = i < px ? i + 1 : i == px ? 0 : i;
+  }
+
+  if (MAY_TYPE (a) == MAY_SUM_T)
+    it = MAY_AT_PTR (a, 0), nt = MAY_NODE_SIZE (a);
+  else
+    it = &a, nt = 1;
+  *t = may_alloc (nt * sizeof **t);
+  for (i = 0; i < nt; i++) {
+    may_t c;
+    if (n == 0) {
+      if (!may_extract_coeff_deg (&c, &d[0], it[i], x, true))
+        return 0;
+    } else if (!may_extract_coeff_multideg (&c, d, it[i], n+1, new_var,
+                                            index_var, tempdeg, tempsum))
+      return 0;
+    if (MAY_TYPE (c) != MAY_INT_T)
+      return 0;
+    (*t)[i].c = MAY_INT (c);
+    (*t)[i].e = may_alloc ((n + 1) * sizeof *(*t)[i].e);
+    for (j = 0; j <= n; j++) {
+      if (mpz_sgn (d[j]) < 0 || !mpz_fits_slong_p (d[j]))
+        return 0;
+      (*t)[i].e[j] = mpz_get_ui (d[j]);
+      if (j > 0)
+        deg[j-1] = MAX (deg[j-1], (*t)[i].e[j]);
+    }
+  }
+  return nt;
+}
+
+/* Add to z the sum of the absolute values of the coefficients of t */
+static void
+resultant_norm (mpz_t z, unsigned long nt, const resultant_term_t *t)
+{
+  mpz_set_ui (z, 0);
+  for (unsigned long i = 0; i < nt; i++)
+    if (mpz_sgn (t[i].c) >= 0)
+      mpz_add (z, z, t[i].c);
+    else
+      mpz_sub (z, z, t[i].c);
+}
+
+/* Multimodular resultant of a and b of degrees da and db in x.
+   Return NULL if a or b has not integer coefficients in symbols
+   or if the grid of points is too large */
+static may_t
+resultant_modular (may_t a, may_t b, may_t x, unsigned long da, unsigned long db)
+{
+  resultant_modular_t pb;
+  may_t la, lb, *var, res;
+  unsigned long i, j, k, n, nprimes, bits;
+  mpz_t z, m, r;
+
+  MAY_RECORD ();
+
+  /* The variables except x, sorted following the current order */
+  la = may_indets (a, MAY_INDETS_NONE);
+  lb = may_indets (b, MAY_INDETS_NONE);
+  n = may_nops (la) + may_nops (lb);
+  var = may_alloc ((n + 1) * sizeof *var);
+  for (i = k = 0; i < n; i++) {
+    may_t v = i < may_nops (la) ? may_op (la, i) : may_op (lb, i - may_nops (la));
+    if (MAY_TYPE (v) != MAY_STRING_T) {
+      MAY_CLEANUP ();
+      return NULL;
+    }
+    if (may_identical (v, x) == 0)
+      continue;
+    for (j = 0; j < k && may_identical (var[j], v) < 0; j++);
+    if (j < k && may_identical (var[j], v) == 0)
+      continue;
+    memmove (&var[j+1], &var[j], (k - j) * sizeof *var);
+    var[j] = v;
+    k++;
+  }
+  n = pb.n = k;
+  pb.da = da;
+  pb.db = db;
+  pb.deg = may_alloc ((n + 1) * sizeof *pb.deg);
+  unsigned long dega[n+1], degb[n+1];
+  for (i = 0; i < n; i++)
+    dega[i] = degb[i] = 0;
+  pb.na = resultant_terms (&pb.ta, a, x, n, var, dega);
+  pb.nb = pb.na == 0 ? 0 : resultant_terms (&pb.tb, b, x, n, var, degb);
+  if (pb.nb == 0) {
+    MAY_CLEANUP ();
+    return NULL;
+  }
+
+  /* The degree of the resultant in var[i] is at most
+     db*deg(a,var[i]) + da*deg(b,var[i]) */
+  pb.size = may_alloc ((n + 1) * sizeof *pb.size);
+  pb.total = 1;
+  for (i = 0; i < n; i++) {
+    pb.deg[i] = MAX (dega[i], degb[i]);
+    pb.size[i] = db * dega[i] + da * degb[i] + 1;
+    if (pb.size[i] > RESULTANT_MODULAR_MAX_SIZE
+        || pb.total > RESULTANT_MODULAR_MAX_SIZE / pb.size[i]) {
+      MAY_CLEANUP ();
+      return NULL;
+    }
+    pb.total *= pb.size[i];
+  }
+
+  /* The resultant is the determinant of the Sylvester matrix:
+     the sum of the absolute values of its coefficients is at most
+     |a|^db * |b|^da with |a| the sum of the ones of a */
+  mpz_init (z);
+  resultant_norm (z, pb.na, pb.ta);
+  bits = db * mpz_sizeinbase (z, 2);
+  resultant_norm (z, pb.nb, pb.tb);
+  bits += da * mpz_sizeinbase (z, 2) + 2;
+  nprimes = bits / 30 + 1;
+  if (nprimes > RESULTANT_MODULAR_MAX_SIZE / pb.total) {
+    MAY_CLEANUP ();
+    return NULL;
+  }
+
+  /* Compute the resultant modulo primes above 2^30 on the workers */
+  may_mark_t mark;
+  resultant_prime_t *task = may_alloc (nprimes * sizeof *task);
+  mpz_set_ui (z, 1);
+  mpz_mul_2exp (z, z, 30);
+  for (i = 0; i < nprimes; i++) {
+    mpz_nextprime (z, z);
+    task[i].pb = &pb;
+    task[i].p = mpz_get_ui (z);
+    task[i].val = may_alloc (pb.total * sizeof *task[i].val);
+  }
+  may_mark (mark);
+#ifdef MAY_WANT_THREAD
+  MAY_SPAWN_BLOCK (block, mark);
+  for (i = 0; i < nprimes; i++)
+    may_spawn (block, resultant_prime, &task[i]);
+  MAY_SPAWN_SYNC (block);
+#else
+  for (i = 0; i < nprimes; i++)
+    resultant_prime (&task[i]);
+#endif
+  may_compact (mark, NULL);
+
+  /* Chinese remainder on each coefficient (Garner) in the symmetric range */
+  unsigned long inv[nprimes];
+  mpz_init (m);
+  mpz_init (r);
+  mpz_set_ui (m, 1);
+  for (i = 0; i < nprimes; i++) {
+    inv[i] = mpz_fdiv_ui (m, task[i].p);
+    inv[i] = i == 0 ? 1 : may_invmod_ui (inv[i], task[i].p);
+    mpz_mul_ui (m, m, task[i].p);
+  }
+  mpz_fdiv_q_2exp (m, m, 1);
+  may_t sum = MAY_NODE_C (MAY_SUM_T, pb.total);
+  unsigned long e[n+1];
+  for (j = 0; j < n; j++)
+    e[j] = 0;
+  for (k = j = 0; k < pb.total; k++) {
+    mpz_set_ui (r, task[0].val[k]);
+    mpz_set_ui (z, 1);
+    for (i = 1; i < nprimes; i++) {
+      unsigned long p = task[i].p;
+      unsigned long t = may_submod_ui (task[i].val[k], mpz_fdiv_ui (r, p), p);
+      mpz_mul_ui (z, z, task[i-1].p);
+      mpz_addmul_ui (r, z, may_mulmod_ui (t, inv[i], p));
+    }
+    if (mpz_sgn (r) != 0) {
+      if (mpz_cmp (r, m) > 0) {
+        mpz_mul_2exp (z, m, 1);
+        mpz_add_ui (z, z, 1);
+        mpz_sub (r, r, z);
+      }
+      may_t term = MAY_NODE_C (MAY_PRODUCT_T, n + 1);
+      MAY_SET_AT (term, 0, may_set_z (r));
+      for (i = 0; i < n; i++)
+        MAY_SET_AT (term, i+1, may_pow_c (var[i], may_set_ui (e[i])));
+      MAY_SET_AT (sum, j++, term);
+    }
+    /* Next exponent */
+    for (i = 0; i < n && ++e[i] == pb.size[i]; i++)
+      e[i] = 0;
+  }
+  MAY_NODE_SIZE (sum) = j;
+  res = j == 0 ? MAY_ZERO : may_eval (sum);
+  MAY_RET (res);
+}
+
+may_t
+may_resultant (may_t a, may_t b, may_t x)
+{
+  may_t res;
+  mpz_srcptr dz;
+  unsigned long da, db;
+
+  MAY_LOG_FUNC (("a='%Y' b='%Y' x='%Y'", a, b, x));
+  MAY_ASSERT (MAY_EVAL_P (a) && MAY_EVAL_P (b));
+
+  may_mark ();
+  a = may_expand (a);
+  b = may_expand (b);
+  if (may_zero_fastp (a) || may_zero_fastp (b))
+    return may_keep (MAY_ZERO);
+  if (!may_degree (NULL, &dz, NULL, a, 1, &x) || !mpz_fits_slong_p (dz))
+    return may_keep (NULL);
+  da = mpz_get_ui (dz);
+  if (!may_degree (NULL, &dz, NULL, b, 1, &x) || !mpz_fits_slong_p (dz))
+    return may_keep (NULL);
+  db = mpz_get_ui (dz);
+
+  /* res (a, b) = a^db if a is a constant, b^da if b is a constant */
+  if (da == 0 || db == 0)
+    return may_keep (may_expand (may_pow (da == 0 ? a : b,
+                                          may_set_ui (da == 0 ? db : da))));
+
+  res = NULL;
+  if (MAY_TYPE (x) == MAY_STRING_T
+      && da + db >= MAY_RESULTANT_MODULAR_THRESHOLD)
+    res = resultant_modular (a, b, x, da, db);
+  if (res == NULL)
+    res = resultant_prs (a, b, x, da, db);
+  return may_keep (res);
+}
+
+may_t
+may_discriminant (may_t p, may_t x)
+{
+  may_t lc, res;
+  mpz_srcptr dz;
+  unsigned long n;
+
+  MAY_LOG_FUNC (("p='%Y' x='%Y'", p, x));
+  MAY_ASSERT (MAY_EVAL_P (p));
+
+  may_mark ();
+  p = may_expand (p);
+  if (may_zero_fastp (p)
+      || !may_degree (&lc, &dz, NULL, p, 1, &x)
+      || !mpz_fits_slong_p (dz) || mpz_sgn (dz) <= 0)
+    return may_keep (NULL);
+  n = mpz_get_ui (dz);
+
+  /* disc (p) = (-1)^(n*(n-1)/2) * res (p, p') / lc(p) */
+  res = may_resultant (p, may_diff (p, x), x);
+  MAY_ASSERT (res != NULL);
+  res = may_divexact (res, lc);
+  MAY_ASSERT (res != NULL);
+  if ((n * (n-1) / 2) % 2 != 0)
+    res = may_neg (res);
+  return may_keep (may_expand (res));
+}
@@ -21,19 +21,18 @@ MA 02110-1301, USA. */
 #include "may-impl.h"
 
 /* If p is an identifier, check if p is a wildcard, and return
-   its index if it is */
+   its index if it is (See match.c) */
 MAY_INLINE int
 get_index (may_t p)
 {
   const char *name;
-  char *end;
-  int ret;
+  unsigned long ret;
 
   name = MAY_NAME (p);
-  if (*name++ != '$')
+  if (*name++ != '$' || !isdigit ((unsigned char) *name))
     return -1;
-  ret = strtol (name, &end, 10);
-  return end == name ? -1 : ret;
+  ret = strtoul (name, NULL, 10);
+  return ret < INT_MAX ? (int) ret : INT_MAX - 1;
 }
 
 /* Return the max index of the wildcards which are used in 'x' */
@@ -141,3 +140,260 @@ may_rewrite2 (may_t x, may_t pattern1, may_t pattern2,
   /* Rewrite, compact and return */
   return may_keep (rewrite (x, &context));
 }
+
+
+/***************************************************************************/
+
+/* A compiled set of rules is a list:
+     {index, pattern_0, replacement_0, pattern_1, replacement_1, ...}
+   where 'index' is a DATA node storing a discrimination net of the rules:
+   for each type of node, the (ordered) list of the rules whose pattern
+   may match a node of this type. It only stores integers and function
+   pointers, so that the set of rules can be compacted like any other
+   symbolic number. */
+#define RULES_NUM_TYPES (MAY_END_LIMIT + 1 + MAY_MAX_EXTENSION)
+#define RULES_MEMO_SIZE (MAY_HASH_MAX < 4096 ? MAY_HASH_MAX : 4096)
+#define RULES_MAX_WILDCARD 100
+
+struct rules_info_s {
+  int size;                 /* Number of wildcards of the rule */
+  int type;                 /* Type of the pattern */
+  may_size_t arity;         /* Number of operands of the pattern (or 0) */
+  int (**funcp) (may_t);    /* Predicates of the wildcards (or NULL) */
+};
+
+struct rules_index_s {
+  unsigned long n;                        /* Number of rules */
+  int size;                               /* Max number of wildcards */
+  unsigned long start[RULES_NUM_TYPES+1]; /* Rules of type t are in
+                                             bucket[start[t]..start[t+1]] */
+  struct rules_info_s info[];             /* Followed by the buckets */
+};
+#define RULES_BUCKET(index) ((unsigned long *) &(index)->info[(index)->n])
+
+struct rules_context_s {
+  const struct rules_index_s *index;
+  const unsigned long *bucket;
+  may_t rules;
+  may_t *value;
+  may_t *memo;
+  int flags;
+};
+
+/* Return true if the rule 'info' may match a node of type t */
+static int
+rule_in_bucket_p (const struct rules_info_s *info, int t)
+{
+  if (info->size < 0)
+    return 0; /* Disabled rule */
+  return info->type == t
+    || info->type == -1  /* Wildcard: matches everything */
+    || (t == MAY_FACTOR_T && info->type == MAY_PRODUCT_T);
+}
+
+/* Allocate the DATA node of the index of n rules and nbucket entries */
+static may_t
+rules_index_new (unsigned long n, unsigned long nbucket)
+{
+  may_t data = may_data_c (sizeof (struct rules_index_s)
+                           + n * sizeof (struct rules_info_s)
+                           + nbucket * sizeof (unsigned long));
+  struct rules_index_s *index = may_data_ptr (data);
+  index->n = n;
+  index->size = 0;
+  return data;
+}
+
+may_t
+may_rewrite_compile (size_t n, const may_rule_t rules[])
+{
+  unsigned long i, nbucket;
+  int t;
+
+  MAY_LOG_FUNC (("n=%lu", (unsigned long) n));
+
+  may_mark ();
+
+  /* Empty set of rules: all the buckets are empty */
+  if (MAY_UNLIKELY (n == 0)) {
+    may_t data = rules_index_new (0, 0);
+    struct rules_index_s *index = may_data_ptr (data);
+    for (t = 0; t <= RULES_NUM_TYPES; t++)
+      index->start[t] = 0;
+    return may_keep (may_eval (may_list_vc (1, &data)));
+  }
+
+  /* Analyse the rules */
+  struct rules_info_s info[n];
+  may_t tab[2*n+1];
+  int size = 0;
+  for (i = 0; i < n; i++) {
+    may_t pattern = may_eval (rules[i].pattern);
+    int maxindex = get_max_index (pattern);
+    tab[1+2*i] = pattern;
+    tab[2+2*i] = may_eval (rules[i].replacement);
+    info[i].funcp = rules[i].funcp;
+    info[i].size  = rules[i].size;
+    if (maxindex >= RULES_MAX_WILDCARD)
+      info[i].size = -1; /* Index of wildcard too large (See may_rewrite) */
+    else if (info[i].size == 0 && info[i].funcp == NULL)
+      info[i].size = maxindex + 1;
+    else if (maxindex >= info[i].size)
+      info[i].size = -1; /* The rule can't match (See may_rewrite2) */
+    MAY_ASSERT (info[i].size < RULES_MAX_WILDCARD);
+    size = MAX (size, info[i].size);
+    if (MAY_TYPE (pattern) == MAY_STRING_T && get_index (pattern) >= 0)
+      info[i].type = -1, info[i].arity = 0;
+    else
+      info[i].type = MAY_TYPE (pattern),
+        info[i].arity = MAY_ATOMIC_P (pattern) ? 0 : MAY_NODE_SIZE (pattern);
+  }
+
+  /* Count the size of the buckets */
+  nbucket = 0;
+  for (t = 0; t < RULES_NUM_TYPES; t++)
+    for (i = 0; i < n; i++)
+      nbucket += rule_in_bucket_p (&info[i], t);
+
+  /* Build the index */
+  may_t data = rules_index_new (n, nbucket);
+  struct rules_index_s *index = may_data_ptr (data);
+  index->size = size;
+  memcpy (index->info, info, n * sizeof (struct rules_info_s));
+  unsigned long *bucket = RULES_BUCKET (index);
+  nbucket = 0;
+  for (t = 0; t < RULES_NUM_TYPES; t++) {
+    index->start[t] = nbucket;
+    for (i = 0; i < n; i++)
+      if (rule_in_bucket_p (&info[i], t))
+        bucket[nbucket++] = i;
+  }
+  index->start[t] = nbucket;
+
+  tab[0] = data;
+  return may_keep (may_eval (may_list_vc (2*n+1, tab)));
+}
+
+/* Substitute the wildcards of the pattern p by their values
+   (the wildcard $i by value[i] if i < size and value[i] != NULL).
+   The returned value is not evaluated */
+may_t
+may_rewrite_instantiate (may_t p, const may_t value[], int size)
+{
+  int idx;
+
+  if (MAY_ATOMIC_P (p)) {
+    if (MAY_TYPE (p) == MAY_STRING_T && (idx = get_index (p)) >= 0
+        && idx < size && value[idx] != NULL)
+      return value[idx];
+    return p;
+  }
+
+  may_size_t i, n = MAY_NODE_SIZE(p);
+  may_t np = NULL;
+  for (i = 0; i < n; i++) {
+    may_t z = MAY_AT (p, i), y = may_rewrite_instantiate (z, value, size);
+    if (MAY_UNLIKELY (y != z && np == NULL)) {
+      np = MAY_NODE_C (MAY_TYPE (p), n);
+      memcpy (MAY_AT_PTR (np, 0), MAY_AT_PTR (p, 0), i * sizeof (may_t));
+    }
+    if (np != NULL)
+      MAY_SET_AT (np, i, y);
+  }
+  return np == NULL ? p : np;
+}
+
+/* Try the rules on the node x (and not its operands).
+   Return the rewritten node or NULL if no rule matches */
+static may_t
+rules_node (may_t x, struct rules_context_s *context)
+{
+  const struct rules_index_s *index = context->index;
+  unsigned long i, end;
+  may_t *memo = NULL;
+  int t = MAY_TYPE (x);
+
+  if (context->memo != NULL) {
+    memo = &context->memo[MAY_HASH (x) & (RULES_MEMO_SIZE-1)];
+    if (*memo != NULL && may_identical (*memo, x) == 0)
+      return NULL;
+  }
+
+  MAY_ASSERT (t < RULES_NUM_TYPES);
+  end = index->start[t+1];
+  for (i = index->start[t]; i < end; i++) {
+    unsigned long r = context->bucket[i];
+    const struct rules_info_s *info = &index->info[r];
+    /* Fast check of the number of operands */
+    if (info->arity != 0 && info->type == t) {
+      may_size_t n = MAY_NODE_SIZE (x);
+      if (t == MAY_SUM_T || t == MAY_PRODUCT_T ? info->arity > n+1
+          : info->arity != n)
+        continue;
+    }
+    memset (context->value, 0, info->size * sizeof *context->value);
+    if (may_match_p (context->value, x, MAY_AT (context->rules, 1+2*r),
+                     info->size, info->funcp))
+      return may_eval (may_rewrite_instantiate (MAY_AT (context->rules, 2+2*r),
+                                                context->value, info->size));
+  }
+
+  if (memo != NULL)
+    *memo = x;
+  return NULL;
+}
+
+/* Rewrite the operands of x, then x itself */
+static may_t
+rules_rewrite (may_t x, struct rules_context_s *context)
+{
+  may_t y;
+
+  if (!MAY_ATOMIC_P (x)) {
+    may_size_t i, n = MAY_NODE_SIZE(x);
+    may_t nx = NULL;
+    /* The name of a function is not an operand */
+    for (i = MAY_TYPE (x) == MAY_FUNC_T; i < n; i++) {
+      may_t z = MAY_AT (x, i);
+      y = rules_rewrite (z, context);
+      if (MAY_UNLIKELY (y != z && nx == NULL)) {
+        nx = MAY_NODE_C (MAY_TYPE (x), n);
+        memcpy (MAY_AT_PTR (nx, 0), MAY_AT_PTR (x, 0), i * sizeof (may_t));
+      }
+      if (nx != NULL)
+        MAY_SET_AT (nx, i, y);
+    }
+    if (nx != NULL)
+      x = may_eval (nx);
+  }
+
+  y = rules_node (x, context);
+  if (y == NULL)
+    return x;
+  return (context->flags & MAY_REWRITE_REPEAT) != 0
+    ? rules_rewrite (y, context) : y;
+}
+
+may_t
+may_rewrite_rules (may_t x, may_t rules, may_rewrite_flags_e flags)
+{
+  struct rules_context_s context;
+
+  MAY_LOG_FUNC (("x='%Y' flags=%d", x, (int) flags));
+
+  MAY_ASSERT (MAY_TYPE (rules) == MAY_LIST_T
+              && MAY_TYPE (MAY_AT (rules, 0)) == MAY_DATA_T);
+
+  may_mark ();
+  context.index  = may_data_srcptr (MAY_AT (rules, 0));
+  context.bucket = RULES_BUCKET (context.index);
+  context.rules  = rules;
+  context.flags  = flags;
+  context.value  = may_alloc (context.index->size * sizeof *context.value);
+  context.memo   = NULL;
+  if ((flags & MAY_REWRITE_MEMO) != 0) {
+    context.memo = may_alloc (RULES_MEMO_SIZE * sizeof *context.memo);
+    memset (context.memo, 0, RULES_MEMO_SIZE * sizeof *context.memo);
+  }
+  return may_keep (rules_rewrite (x, &context));
+}
@@ -89,8 +89,6 @@ may_set_ld (long double d)
 may_t
 may_set_str_domain (const char str[], may_domain_e domain)
 {
-  may_t y;
-
   /* NAN, INF, I and PI are in upper cases.
      Usually, users set their local variables in lower cases.
      Test if the first letter is in range. */
@@ -104,25 +102,13 @@ may_set_str_domain (const char str[], may_domain_e domain)
     else if (strcmp (str, may_pi_name) == 0)
       return MAY_PI;
   }
-  /* Search for x in the small cache in order to reuse previously computed symbols
-     It speeds up the handling of big parsing since it uses less memory and, moreover
-     it speeds up its computation (may_identical is faster) */
-  for (unsigned int i = 0; i < may_g.frame.cache_set_str_n; i++)
-    if (str[0] ==  MAY_NAME (may_g.frame.cache_set_str[i])[0]
-        && strcmp (str, MAY_NAME (may_g.frame.cache_set_str[i])) == 0) {
-      MAY_ASSERT (domain == MAY_SYMBOL (may_g.frame.cache_set_str[i]).domain);
-      return may_g.frame.cache_set_str[i];
-    }
-  /* Compute y */
-  y = MAY_STRING_C (str, domain);
-
-  /* Add y in cache */
-  may_g.frame.cache_set_str[may_g.frame.cache_set_str_i] = y;
-  may_g.frame.cache_set_str_i = (may_g.frame.cache_set_str_i + 1)%MAY_MAX_CACHE_SET_STR;
-  if (may_g.frame.cache_set_str_n < MAY_MAX_CACHE_SET_STR)
-    may_g.frame.cache_set_str_n ++;
-
-  return y;
+  /* The floating point numbers are not interned: there are too many of them */
+  if (MAY_UNLIKELY (str[0] == '#'))
+    return MAY_STRING_C (str, domain);
+  /* Return the unique symbol of the interned symbol table:
+     it uses less memory, it is never copied by the compact, and
+     may_identical is faster on it */
+  return may_symbol_intern (str, domain);
 }
 
 may_t
@@ -138,7 +124,8 @@ may_set_str_local (may_domain_e domain)
   char Buffer[(CHAR_BIT*sizeof may_c.local_counter)+1];
   unsigned int value = MAY_ATOMIC_ADD(may_c.local_counter, 1);
   sprintf (Buffer, "_L%u", value);
-  return may_set_str_domain (Buffer, domain);
+  /* The local variables are unique: don't intern them */
+  return MAY_STRING_C (Buffer, domain);
 }
 
 int
@@ -19,11 +19,6 @@ MA 02110-1301, USA. */
 
 #include "may-impl.h"
 
-/* BUG: -14^(1/2)*15^(1/2)+6^(1/2)*35^(1/2) is not recognized as a 0
-   Solution: Add to the base for the pass 2, the GCDs of the pairs
-   of the current base (Removing GCD=1 and the redundancy).
- */
-
 /* Return X, Y, Z such that (sqrt(X)+sqrt(Y))^2/Z = A+sqrt(B)
    Return 1 if succeed,
    Return 0 if fail.
@@ -86,13 +81,37 @@ isqrt_p (may_t x)
   return ret;
 }
 
+/* Extract A, B and D such that sum = A+B*sqrt(D), with A, B and D
+   integers. Return 0 if sum has not this form */
+static int
+extract_quadratic (mpz_ptr a, mpz_ptr b, mpz_ptr d, may_t sum)
+{
+  may_t ap, bp;
+
+  /* INT+sqrt(INT), INT+INT*sqrt(INT), sqrt(INT)+INT or INT*sqrt(INT)+INT */
+  if (!may_sum_extract (&ap, &bp, sum) || !MAY_INT_P (ap))
+    return 0;
+  if (isqrt_p (bp)) {
+    mpz_set_ui (b, 1);
+    mpz_set (d, MAY_INT (MAY_AT (bp, 0)));
+  } else if (MAY_TYPE (bp) == MAY_FACTOR_T
+             && MAY_TYPE (MAY_AT (bp, 0)) == MAY_INT_T
+             && isqrt_p (MAY_AT (bp, 1))) {
+    mpz_set (b, MAY_INT (MAY_AT (bp, 0)));
+    mpz_set (d, MAY_INT (MAY_AT (MAY_AT (bp, 1), 0)));
+  } else
+    return 0;
+  mpz_set (a, MAY_INT (ap));
+  return 1;
+}
+
 /* Compute sqrt(sum=A+sqrt(B)) */
 static may_t
 compute_sqrt_of_sum_of_sqrt (may_t sum)
 {
   mpz_t x, y, z, a, b;
-  may_t ret, ap, bp;
-  int neg = 0;
+  may_t ret;
+  int neg;
 
   MAY_ASSERT (may_sum_p (sum));
   MAY_ASSERT (MAY_NODE_SIZE(sum) == 2);
@@ -100,33 +119,21 @@ compute_sqrt_of_sum_of_sqrt (may_t sum)
   MAY_ASSERT (MAY_EVAL_P (sum));
 
   MAY_RECORD ();
-  /* INT+sqrt(INT), INT+INT*sqrt(INT), sqrt(INT)+INT or INT*sqrt(INT)+INT */
   /* Extract A & B */
-  if (!may_sum_extract(&ap, &bp, sum))
-    return NULL;
-  if (!MAY_INT_P(ap))
-    return NULL;
-  mpz_init_set (a, MAY_INT (ap));
-  if (isqrt_p (bp)) {
-    mpz_init_set (b, MAY_INT (MAY_AT (bp, 0)));
-  } else if (MAY_TYPE (bp) == MAY_FACTOR_T
-             && MAY_TYPE (MAY_AT (bp, 0)) == MAY_INT_T
-             && isqrt_p (MAY_AT (bp, 1))) {
-    mpz_init_set (b, MAY_INT (MAY_AT (MAY_AT (bp, 1),0)));
-    mpz_mul (b, b, MAY_INT (MAY_AT (bp, 0)));
-    mpz_mul (b, b, MAY_INT (MAY_AT (bp, 0)));
-    neg = mpz_sgn (MAY_INT (MAY_AT (bp, 0))) < 0;
-  } else {
+  mpz_init (a);
+  mpz_init (b);
+  mpz_init (z);
+  if (!extract_quadratic (a, b, z, sum)) {
     MAY_CLEANUP ();
     return NULL;
   }
-  
-  MAY_ASSERT (!MAY_PURENUM_P (bp));
+  neg = mpz_sgn (b) < 0;
+  mpz_mul (b, b, b);
+  mpz_mul (b, b, z);
 
   /* Solve the problem */
   mpz_init (x);
   mpz_init (y);
-  mpz_init (z);
   if (!solve_sqrt_of_sum_of_sqrt (x, y, z, a, b)) {
     MAY_CLEANUP ();
     return NULL;
@@ -144,6 +151,102 @@ compute_sqrt_of_sum_of_sqrt (may_t sum)
   MAY_RET_EVAL (ret);
 }
 
+/* Compute sum^(1/k) for sum = A+B*sqrt(D) if it belongs to the quadratic
+   field K = Q(sqrt(D)), like (7+5*sqrt(2))^(1/3) = 1+sqrt(2).
+   The root r = (U+V*sqrt(D))/2 is an algebraic integer whose norm c is a
+   k-th root of the norm of sum. Its embeddings b1 = sum^(1/k) and
+   b2 = c/b1 are computed numerically to round U = b1+b2 and
+   V = (b1-b2)/sqrt(D), and r^k = sum is then checked in K.
+   Return NULL if no root is found */
+static may_t
+compute_root_in_quadratic_field (may_t sum, unsigned long k)
+{
+  mpz_t a, b, d;
+  may_nf_t K;
+  mpq_t m[3], c;
+  mpq_t *s, *r, *t;
+  mpfr_t sd, b1, b2, u;
+  mp_prec_t prec;
+  int sign;
+
+  MAY_ASSERT (MAY_EVAL_P (sum));
+  MAY_ASSERT (k >= 2);
+
+  MAY_RECORD ();
+  mpz_init (a);
+  mpz_init (b);
+  mpz_init (d);
+  if (!extract_quadratic (a, b, d, sum) || mpz_sgn (d) <= 0) {
+    MAY_CLEANUP ();
+    return NULL;
+  }
+  /* K = Q[y]/(y^2-D) and s = A+B*y */
+  for (int i = 0; i < 3; i++)
+    mpq_init (m[i]);
+  mpq_set_z (m[0], d);
+  mpq_neg (m[0], m[0]);
+  mpq_set_ui (m[2], 1, 1);
+  may_nf_init (K, 2, m);
+  s = may_nf_new (K);
+  mpq_set_z (s[0], a);
+  mpq_set_z (s[1], b);
+  /* c^k = norm (s) */
+  mpq_init (c);
+  may_nf_norm (c, K, s);
+  MAY_ASSERT (mpz_cmp_ui (mpq_denref (c), 1) == 0);
+  if ((mpq_sgn (c) < 0 && (k % 2) == 0)
+      || !mpz_root (mpq_numref (c), mpq_numref (c), k)) {
+    MAY_CLEANUP ();
+    return NULL;
+  }
+  /* b1 = sum^(1/k) with sqrt(D) > 0: the principal root */
+  prec = mpz_sizeinbase (a, 2) + mpz_sizeinbase (b, 2)
+    + mpz_sizeinbase (d, 2) + 64;
+  mpfr_init2 (sd, prec);
+  mpfr_init2 (b1, prec);
+  mpfr_init2 (b2, prec);
+  mpfr_init2 (u, prec);
+  mpfr_set_z (sd, d, GMP_RNDN);
+  mpfr_sqrt (sd, sd, GMP_RNDN);
+  mpfr_mul_z (b1, sd, b, GMP_RNDN);
+  mpfr_add_z (b1, b1, a, GMP_RNDN);
+  if (mpfr_sgn (b1) <= 0) {
+    MAY_CLEANUP ();
+    return NULL;
+  }
+  mpfr_set_ui (u, k, GMP_RNDN);
+  mpfr_ui_div (u, 1, u, GMP_RNDN);
+  mpfr_pow (b1, b1, u, GMP_RNDN);
+  r = may_nf_new (K);
+  t = may_nf_new (K);
+  /* If k is even, the norm of the root is c or -c */
+  for (sign = 0; sign < 1 + (k % 2 == 0); sign++) {
+    if (sign)
+      mpq_neg (c, c);
+    mpfr_set_q (b2, c, GMP_RNDN);
+    mpfr_div (b2, b2, b1, GMP_RNDN);
+    mpfr_add (u, b1, b2, GMP_RNDN);
+    mpfr_get_z (mpq_numref (r[0]), u, GMP_RNDN);
+    mpz_set_ui (mpq_denref (r[0]), 2);
+    mpq_canonicalize (r[0]);
+    mpfr_sub (u, b1, b2, GMP_RNDN);
+    mpfr_div (u, u, sd, GMP_RNDN);
+    mpfr_get_z (mpq_numref (r[1]), u, GMP_RNDN);
+    mpz_set_ui (mpq_denref (r[1]), 2);
+    mpq_canonicalize (r[1]);
+    may_nf_pow_ui (K, t, r, k);
+    if (may_nf_equal_p (K, t, s)) {
+      /* Check that r is the principal root: r(sqrt(D)) > 0 */
+      mpfr_mul_q (u, sd, r[1], GMP_RNDN);
+      mpfr_add_q (u, u, r[0], GMP_RNDN);
+      if (mpfr_sgn (u) > 0)
+        MAY_RET (may_nf_get_upol (K, r, may_sqrt (may_set_z (d))));
+    }
+  }
+  MAY_CLEANUP ();
+  return NULL;
+}
+
 static may_t
 is_sqrt_inside_sum (may_t sum)
 {
@@ -260,7 +363,12 @@ may_sqrtsimp_recur_c (may_t x)
                            may_pow_c (new_base, MAY_AT (x, 1)));
           return may_sqrtsimp_recur_c (may_eval (new));
         } else if (MAY_NODE_SIZE(base) == 2 && MAY_NUM_P (base)
-                   && ( z = compute_sqrt_of_sum_of_sqrt (base)) != NULL)
+                   && mpq_sgn (expo) > 0
+                   && mpz_fits_ulong_p (mpq_denref (expo))
+                   && (z = mpz_cmp_ui (mpq_denref (expo), 2) == 0
+                       ? compute_sqrt_of_sum_of_sqrt (base)
+                       : compute_root_in_quadratic_field
+                       (base, mpz_get_ui (mpq_denref (expo)))) != NULL)
           return z;
         return may_pow_c (base, MAY_AT (x,1));
       }
@@ -308,23 +416,18 @@ may_sqrtsimp_recur_c (may_t x)
   }
 }
 
-/* Seconde passe qui fait:
-    1. Recherche des irrationnels algbriques de l'expression.
-       De la forme ENTIER^RATIONNEL
-    2. Calcul du LCM des dnominateurs des exposants trouvs.
-    3. Mettre les puissances trouves au mme dnominateur.
-       Exemple: LCM=6, 2^(1/3) -> 4->(1/6)
-    4. Classer les puissances dans l'ordre des entiers du plus petit au plus grand
-    5. Recherche des dcompositions des entiers de rang N dans la base [0..N-1
-       Pour i de 2 a #ENTIER
-        count[#entier] = 0
-        Pour j de 1 a i FAIRE
-         si tab[j] divide tab[i]
-           count[#entier] ++
-         sinon
-           next j
-        Construite l'expression remplacante: Product (entier^count)^(1/lcm)
-    6. Si difference, remplacez dans l'expression initiale.
+/* Second pass:
+    1. Search for the algebraic irrationals of the expression,
+       of the form INTEGER^RATIONAL.
+    2. Compute a coprime base of their integers: two elements of the base
+       with a common factor g are replaced by g and their cofactors,
+       until they are pairwise coprime.
+       Example: {30, 105} -> {2, 15, 7}
+    3. Decompose each integer on this base, and replace the irrational
+       by the product of the powers of the base.
+       Example: 30^(1/2)*105^(1/2) -> 2^(1/2)*15^(1/2)*15^(1/2)*7^(1/2)
+       The evaluation merges the powers of a same element of the base,
+       so that the relations between the irrationals are found.
 */
 
 /* Pass 2.1: Search for the irrationnal in the expression x
@@ -346,112 +449,80 @@ sqrtsimp_search_irrational (may_list_t list, may_t x)
   return;
 }
 
-/* Pass 2.2: Compute the LCM of the denominators of the exponent of the
-   found irrationnals */
-static may_t
-sqrtsimp_compute_lcm (may_list_t list)
+/* Pass 2.2: Compute in base the coprime base of the positive integers
+   of the irrationals of the list. Return its size */
+static may_size_t
+sqrtsimp_coprime_base (mpz_t **base, may_list_t list)
 {
-  may_size_t i, n = may_list_get_size (list);
-  mpz_t lcm;
+  may_size_t i, j, k, n, size = may_list_get_size (list), alloc;
+  mpz_t g, *b;
 
-  MAY_RECORD ();
-  mpz_init (lcm);
-  mpz_set (lcm, mpq_denref (MAY_RAT (MAY_AT (may_list_at (list, 0), 1))));
-  for (i = 1; i < n; i++) {
-    mpz_srcptr it = mpq_denref (MAY_RAT (MAY_AT (may_list_at (list, i), 1)));
-    mpz_lcm (lcm, lcm, it);
+  /* Each refinement divides the product of the base by g >= 2 */
+  alloc = size;
+  for (i = 0; i < size; i++)
+    alloc += mpz_sizeinbase (MAY_INT (MAY_AT (may_list_at (list, i), 0)), 2);
+  b = may_alloc (alloc * sizeof *b);
+  for (i = 0; i < alloc; i++)
+    mpz_init (b[i]);
+  mpz_init (g);
+  for (i = n = 0; i < size; i++) {
+    mpz_srcptr z = MAY_INT (MAY_AT (may_list_at (list, i), 0));
+    if (mpz_cmp_ui (z, 1) > 0)
+      mpz_set (b[n++], z);
   }
-  may_t result = MAY_MPZ_NOCOPY_C  (lcm);
-  MAY_RET_EVAL (result);
-}
-
-/* Pass 2.3: Replace the base of the irrationnals by its equivalent
-   using lcm as exponent */
-static int
-sqrtsimp_update_denom (may_list_t list, may_t lcm)
-{
-  may_size_t i, n = may_list_get_size (list);
-  mpz_t num;
-  mpz_init (num);
-  for (i = 0; i < n; i++) {
-    may_t it = may_list_at (list, i);
-    mpz_srcptr base = MAY_INT (MAY_AT (it, 0));
-    mpz_srcptr orga = mpq_numref (MAY_RAT (MAY_AT (it, 1)));
-    mpz_srcptr orgb = mpq_denref (MAY_RAT (MAY_AT (it, 1)));
-    /* Here we have base^(orga/orgb) to transform in
-       ((base)^(orga*lcm/orgb))^(1/lcm) */
-    mpz_mul (num, orga, MAY_INT (lcm));
-    mpz_divexact (num, num, orgb);
-    /* Check for overflow of powering */
-    unsigned long e = may_test_overflow_pow_ui (base, num);
-    if (e == 0)
-      return 0; /* fail */
-    mpz_pow_ui (num, base, e);
-    may_list_set_at (list, i, may_eval (MAY_MPZ_C (num)));
-  }
-  return 1; /* success */
+ restart:
+  for (i = 0; i < n; i++)
+    for (j = i+1; j < n; j++) {
+      mpz_gcd (g, b[i], b[j]);
+      if (mpz_cmp_ui (g, 1) == 0)
+        continue;
+      /* Replace b[i] and b[j] by g, b[i]/g and b[j]/g, and remove the 1 */
+      MAY_ASSERT (n < alloc);
+      mpz_divexact (b[i], b[i], g);
+      mpz_divexact (b[j], b[j], g);
+      mpz_set (b[n++], g);
+      for (k = i = 0; i < n; i++)
+        if (mpz_cmp_ui (b[i], 1) != 0)
+          mpz_swap (b[k++], b[i]);
+      n = k;
+      goto restart;
+    }
+  *base = b;
+  return n;
 }
 
-/* Pass 2.5: Compute the decomposition of the elements in list
-   which lcm is lcm */
-static void
-sqrtsimp_compute_decomp (may_list_t list, may_t lcm)
+/* Pass 2.3: Replace the irrationals of the list in x by their
+   decomposition on the coprime base */
+static may_t
+sqrtsimp_replace_decomp (may_list_t list, may_size_t n, mpz_t base[], may_t x)
 {
-  may_size_t i,j, n=may_list_get_size (list);
-  unsigned int count[n];
+  may_size_t i, j, k, size = may_list_get_size (list);
   mpz_t temp;
-  mpz_init (temp);
 
-  for (i = 1; i < n ; i++) {
-    mpz_srcptr a = MAY_INT (may_list_at (list, i));
-    int decompose = 0;
-    memset (count, 0, sizeof count);
-    mpz_set (temp, a);
-    for (j = 0; j < i; j++) {
-      may_t it = may_list_at (list, j);
-      /* If j was decomposed, skip it*/
-      if (MAY_TYPE (it) != MAY_INT_T)
+  mpz_init (temp);
+  for (i = 0; i < size; i++) {
+    may_t it = may_list_at (list, i);
+    mpz_srcptr z = MAY_INT (MAY_AT (it, 0));
+    if (mpz_cmp_ui (z, 1) <= 0)
+      continue;
+    may_t r = MAY_NODE_C (MAY_PRODUCT_T, n);
+    mpz_set (temp, z);
+    for (j = k = 0; j < n; j++) {
+      unsigned long e = mpz_remove (temp, temp, base[j]);
+      if (e == 0)
         continue;
-      if (mpz_cmp (temp, MAY_INT (it)) < 0)
+      /* z is an element of the base: nothing to do */
+      if (e == 1 && mpz_cmp (z, base[j]) == 0)
         break;
-      /* Count the number of times [j] divide [i] */
-      while (mpz_divisible_p (temp, MAY_INT (it))) {
-        mpz_divexact (temp, temp, MAY_INT (it));
-        count[j] ++;
-        decompose = 1;
-      }
-    }
-    /* Now we have decompose [i] on its previous base */
-    if (decompose) {
-      may_t r = MAY_NODE_C (MAY_PRODUCT_T, n+1);
-      may_size_t k = 0;
-      for (j = 0 ; j < n; j++)
-        if (count[j] != 0)
-          MAY_SET_AT (r, k++, may_pow_c (may_list_at (list,j),
-                                         may_div_c (may_set_ui (count[j]), lcm)));
-      MAY_ASSERT (k <= n);
-      if (mpz_cmp_ui (temp, 1) != 0)
-        MAY_SET_AT (r, k++, may_pow_c (may_set_z (temp),
-                                       may_div_c (MAY_ONE, lcm)));
-      MAY_NODE_SIZE(r) = k;
-      r = may_eval (r);
-      may_list_set_at (list, i, r);
-    }
-  } /* For i */
-}
-
-/* Pass 2.6: Replace the original irrationnals by their
-   decomposition in the original expression */
-static may_t
-sqrtsimp_replace_in_org (may_list_t org, may_list_t newi, may_t x)
-{
-  may_size_t i, n = may_list_get_size (org);
-  MAY_ASSERT (may_list_get_size (newi)== n);
-  for (i = 0; i<n; i++) {
-    may_t r = may_list_at (newi, i);
-    if (MAY_TYPE (r) != MAY_INT_T) {
-      x = may_replace (x, may_list_at (org, i), r);
+      MAY_SET_AT (r, k++, may_pow_c (may_set_z (base[j]),
+                                     may_mul_c (may_set_ui (e),
+                                                MAY_AT (it, 1))));
     }
+    MAY_ASSERT (j < n || mpz_cmp_ui (temp, 1) == 0);
+    if (j < n)
+      continue;
+    MAY_NODE_SIZE(r) = k;
+    x = may_replace (x, it, may_eval (r));
   }
   return x;
 }
@@ -460,43 +531,16 @@ static may_t
 sqrtsimp_pass2 (may_t x)
 {
   may_list_t list;
-  may_list_t orgi;
-  may_t lcm;
+  mpz_t *base;
+  may_size_t n;
 
   may_list_init (list, 0);
   sqrtsimp_search_irrational (list, x);
   if (may_list_get_size (list) <= 1)
     return x;
 
-  /* Save in orgi the original values of the irrationnals */
-  may_list_init (orgi, may_list_get_size (list));
-  may_list_set (orgi, list);
-
-  lcm = sqrtsimp_compute_lcm (list);
-  if (!sqrtsimp_update_denom (list, lcm))
-    return x;
-
-  /* Pass 2.4: Sort the list */
-  /* Not a fast sort, but who cares? n should be very small */
-  {
-    may_size_t i, j, k, n = may_list_get_size (list);
-    for (i = 0; i < (n-1); i++) {
-      k = i;
-      for (j = i+1; j < n; j++)
-        if (mpz_cmp (MAY_INT (may_list_at (list, k)),
-                     MAY_INT (may_list_at (list, j))) > 0)
-          k = j;
-      /* Swap i and k */
-      may_t temp = may_list_at (list, k);
-      may_list_set_at (list, k, may_list_at (list, i));
-      may_list_set_at (list, i, temp);
-      temp = may_list_at (orgi, k);
-      may_list_set_at (orgi, k, may_list_at (orgi, i));
-      may_list_set_at (orgi, i, temp);
-    }
-  }
-  sqrtsimp_compute_decomp (list, lcm);
-  return sqrtsimp_replace_in_org (orgi, list, x);
+  n = sqrtsimp_coprime_base (&base, list);
+  return sqrtsimp_replace_decomp (list, n, base, x);
 }
 
 may_t
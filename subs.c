@@ -118,6 +118,15 @@ gindex (may_hash_t hx, struct may_subs_s *context)
   return (size_t) ((double) hx * context->hash);
 }
 
+/* Return TRUE if the value y of a binding is an expression
+   (within the heap or an interned symbol), not a function CB */
+MAY_INLINE int
+subs_expr_p (const void *y)
+{
+  return ((void*)y >= (void*)may_g.Heap.base && (void*)y < (void*)may_g.Heap.limit)
+    || may_symbol_interned_p (y);
+}
+
 static may_t
 may_subs_recur2 (may_t x, unsigned long level, struct may_subs_s *context)
 {
@@ -146,7 +155,7 @@ may_subs_recur2 (may_t x, unsigned long level, struct may_subs_s *context)
       /* Otherwise, read the replacement value */
       y = context->gvalue[context->gtab[j]-1];
       /* TODO: Doesn't work with thread */
-      if (!((void*)y >= (void*)may_g.Heap.base && (void*)y < (void*)may_g.Heap.limit))
+      if (!subs_expr_p (y))
         return x; /* It is a function CB, not a symbol */
       /* Check if we have to replace the symbol once again */
       if (level > 1)
@@ -178,8 +187,7 @@ may_subs_recur2 (may_t x, unsigned long level, struct may_subs_s *context)
       /* Read the value */
       y = context->gvalue[context->gtab[j]-1];
       /* TODO: Doesn't work with thread */
-      if (((void*)y >= (void*)may_g.Heap.base && (void*)y < (void*)may_g.Heap.limit)
-          || y == 0)
+      if (subs_expr_p (y) || y == 0)
         goto not_found_function; /* It is a symbol, not a CB */
       /* Call the registered function */
       cb = (may_t(*)(may_t)) ((void*) y);
@@ -215,7 +223,7 @@ may_subs_recur2 (may_t x, unsigned long level, struct may_subs_s *context)
           z = may_subs_recur2 (MAY_AT (x, 0), level, context);
           /* Read the value */
           y = context->gvalue[context->gtab[j]-1];
-          if ((void*)y >= (void*)may_g.Heap.base && (void*)y < (void*)may_g.Heap.limit)
+          if (subs_expr_p (y))
             return x; /* It is a symbol, not a CB */
           /* Call the registered function */
           cb = (may_t(*)(may_t)) ((void*) y);
@@ -287,3 +295,230 @@ may_subs_c (may_t x, unsigned long level,
 
   return x;
 }
+
+/* A compiled substitution map is a list:
+     {index, name_0, value_0, name_1, value_1, ...}
+   where name_i is the identifier of the binding i and value_i its
+   evaluated value (0 for a callback). 'index' is a DATA node storing
+   the callbacks, an open addressing hash table of the names (keyed on
+   the hash of the identifier) and for each builtin function the binding
+   of its name. It only stores integers and function pointers, so that
+   the map can be compacted like any other symbolic number. It is never
+   modified once built, so that it can be shared by threads. */
+#define SUBS_NUM_UNARY (MAY_UNARYFUNC_LIMIT - MAY_EXP_T + 1)
+
+struct subs_index_s {
+  unsigned long n;                       /* Number of bindings */
+  unsigned long mask;                    /* Size of the hash table - 1 */
+  unsigned long unary[SUBS_NUM_UNARY];   /* Binding of the builtin
+                                            function (binding+1 or 0) */
+  may_t (*func[]) (may_t);               /* Callbacks (or NULL) followed
+                                            by the hash table (binding+1
+                                            or 0) */
+};
+#define SUBS_TABLE(index) ((unsigned long *) &(index)->func[(index)->n])
+
+struct subs_context_s {
+  const struct subs_index_s *index;
+  const unsigned long *table;
+  may_t map;
+};
+
+may_t
+may_subs_compile (size_t n, const may_binding_t bindings[])
+{
+  unsigned long i, j, s;
+  int t;
+
+  MAY_LOG_FUNC (("n=%lu", (unsigned long) n));
+
+  may_mark ();
+
+  /* Size of the hash table: a power of 2 with a load factor of at most 1/2 */
+  for (s = 16; s < 2*n; s <<= 1);
+
+  may_t data = may_data_c (sizeof (struct subs_index_s)
+                           + n * sizeof (may_t (*) (may_t))
+                           + s * sizeof (unsigned long));
+  struct subs_index_s *index = may_data_ptr (data);
+  may_t tab[2*n+1];
+  index->n = n;
+  index->mask = s - 1;
+  unsigned long *table = SUBS_TABLE (index);
+  memset (index->unary, 0, sizeof index->unary);
+  memset (table, 0, s * sizeof *table);
+  for (i = 0; i < n; i++) {
+    may_t name = may_set_str (bindings[i].name);
+    MAY_ASSERT (bindings[i].func != NULL || bindings[i].value != NULL);
+    index->func[i] = bindings[i].func;
+    tab[1+2*i] = name;
+    tab[2+2*i] = bindings[i].func != NULL ? MAY_ZERO : bindings[i].value;
+    for (j = MAY_HASH (name) & index->mask;
+         table[j] != 0;
+         j = (j+1) & index->mask);
+    table[j] = i + 1;
+    /* Check if it is the name of a builtin function
+       (the first binding of a name wins, as in the hash table) */
+    for (t = MAY_EXP_T; t <= MAY_UNARYFUNC_LIMIT; t++) {
+      struct may_s ms;
+      MAY_OPEN_C (&ms, t);
+      const char *fname = may_get_name (&ms);
+      if (fname != NULL && strcmp (fname, bindings[i].name) == 0
+          && index->unary[t - MAY_EXP_T] == 0)
+        index->unary[t - MAY_EXP_T] = i + 1;
+    }
+  }
+
+  tab[0] = data;
+  return may_keep (may_eval (may_list_vc (2*n+1, tab)));
+}
+
+/* Return the first binding of the identifier 'name' or -1 */
+static long
+subs_find (const struct subs_context_s *context, may_t name)
+{
+  const unsigned long *table = context->table;
+  unsigned long j, k, mask = context->index->mask;
+
+  MAY_ASSERT (MAY_TYPE (name) == MAY_STRING_T);
+  for (j = MAY_HASH (name) & mask; (k = table[j]) != 0; j = (j+1) & mask) {
+    may_t y = MAY_AT (context->map, 2*k-1);
+    if (MAY_HASH (y) == MAY_HASH (name)
+        && strcmp (MAY_NAME (y), MAY_NAME (name)) == 0)
+      return k - 1;
+  }
+  return -1;
+}
+
+static may_t subs_map_recur (may_t, unsigned long,
+                             const struct subs_context_s *);
+
+/* Call the callback of the binding k with the argument z
+   (the substituted argument of x). Return x if it returns NULL */
+static may_t
+subs_call (may_t x, may_t z, long k, unsigned long level,
+           const struct subs_context_s *context)
+{
+  may_t y = (*context->index->func[k]) (z);
+  /* If the registered function returns NULL, return the original expression */
+  if (y == NULL)
+    return x;
+  /* Check if we have to replace the results once again */
+  if (level > 1)
+    y = subs_map_recur (y, level-1, context);
+  return y;
+}
+
+static may_t
+subs_map_recur (may_t x, unsigned long level,
+                const struct subs_context_s *context)
+{
+  may_t y, z;
+  may_size_t i, n;
+  long k;
+  int isnew;
+
+  switch (MAY_TYPE (x))
+    {
+    case MAY_INT_T ...MAY_NUM_LIMIT:
+    case MAY_DATA_T:
+      return x;
+    case MAY_STRING_T:
+      k = subs_find (context, x);
+      /* Not found or a callback: return the string itself */
+      if (k < 0 || context->index->func[k] != NULL)
+        return x;
+      y = MAY_AT (context->map, 2*k+2);
+      /* Check if we have to replace the symbol once again */
+      if (level > 1)
+        y = subs_map_recur (y, level-1, context);
+      return y;
+    case MAY_FUNC_T:
+      k = subs_find (context, MAY_AT (x, 0));
+      /* Substitute the arguments of the function */
+      z = subs_map_recur (MAY_AT (x, 1), level, context);
+      if (k >= 0 && context->index->func[k] != NULL)
+        return subs_call (x, z, k, level, context);
+      /* Not found or a symbol: check if we must rebuild the expression */
+      if (z != MAY_AT (x, 1)) {
+        y = MAY_NODE_C (MAY_FUNC_T, 2);
+        MAY_SET_AT (y, 0, MAY_AT (x, 0));
+        MAY_SET_AT (y, 1, z);
+        x = y;
+      }
+      return x;
+    case MAY_EXP_T ... MAY_UNARYFUNC_LIMIT:
+      k = (long) context->index->unary[MAY_TYPE (x) - MAY_EXP_T] - 1;
+      if (k >= 0 && context->index->func[k] != NULL)
+        return subs_call (x, subs_map_recur (MAY_AT (x, 0), level, context),
+                          k, level, context);
+      /* Falls through. */
+    default:
+      n = MAY_NODE_SIZE(x);
+      y = MAY_NODE_C (MAY_TYPE(x), n);
+      isnew = 0;
+      for (i = 0 ; i < n; i++) {
+        may_t zo = MAY_AT (x, i);
+        z = subs_map_recur (zo, level, context);
+        isnew |= (z != zo);
+        MAY_SET_AT (y, i, z);
+      }
+      return isnew ? y : x;
+    }
+}
+
+may_t
+may_subs_apply_c (may_t x, unsigned long level, may_t map)
+{
+  struct subs_context_s context;
+
+  MAY_LOG_FUNC (("x='%Y' level=%lu", x, level));
+  MAY_ASSERT (MAY_TYPE (map) == MAY_LIST_T && MAY_NODE_SIZE(map) >= 1);
+  MAY_ASSERT (MAY_TYPE (MAY_AT (map, 0)) == MAY_DATA_T);
+
+  context.index = may_data_srcptr (MAY_AT (map, 0));
+  context.table = SUBS_TABLE (context.index);
+  context.map   = map;
+  if (MAY_UNLIKELY (context.index->n == 0))
+    return x;
+  return subs_map_recur (x, level, &context);
+}
+
+may_t
+may_subs_apply (may_t x, unsigned long level, may_t map)
+{
+  MAY_LOG_FUNC (("x='%Y' level=%lu", x, level));
+
+  may_mark ();
+  return may_keep (may_eval (may_subs_apply_c (x, level, map)));
+}
+
+struct subs_papply_s {
+  unsigned long level;
+  may_t map;
+};
+
+static may_t
+subs_papply_func (may_t x, void *data)
+{
+  const struct subs_papply_s *p = data;
+  return may_subs_apply_c (x, p->level, p->map);
+}
+
+void
+may_subs_papply (size_t n, may_t dest[], const may_t src[],
+                 unsigned long level, may_t map)
+{
+  struct subs_papply_s data = { level, map };
+  size_t i;
+
+  MAY_LOG_FUNC (("n=%lu level=%lu", (unsigned long) n, level));
+
+  if (MAY_UNLIKELY (n == 0))
+    return;
+  /* Apply the map to each element of the list of the expressions */
+  may_t y = may_pmap2 (may_list_vc (n, src), subs_papply_func, &data);
+  MAY_ASSERT (MAY_TYPE (y) == MAY_LIST_T && MAY_NODE_SIZE(y) == n);
+  for (i = 0; i < n; i++)
+    dest[i] = MAY_AT (y, i);
+}
@@ -1212,6 +1212,42 @@ test_series_tan (int n)
   return t;
 }
 
+static may_t
+expand_c (may_t x)
+{
+  return may_expand (may_eval (x));
+}
+
+int
+test_map (int n)
+{
+  may_mark ();
+  if (verbose >= 2) {
+    printf ("map (expand, [(x+y+i)^4 for i=1..%d]) ...", n);
+    fflush (stdout);
+  }
+
+  may_t w = may_parse_str ("(x+y+z)^4"), z = may_set_str ("z");
+  may_t tab[n];
+  for (int i = 0; i < n; i++)
+    tab[i] = may_replace (w, z, may_set_ui (i+1));
+  may_t l = may_list_vc (n, tab);
+
+  int t = cputime();
+  may_t r1 = may_map (l, expand_c);
+  t = cputime () - t;
+  int t2 = cputime();
+  may_t r2 = may_pmap (l, expand_c);
+  t2 = cputime () - t2;
+
+  if (verbose >= 2)
+    printf ("%dms (parallel: %dms)\n", t, t2);
+  if (may_identical (r1, r2) != 0)
+    printf ("ERROR: parallel map differs\n");
+  may_keep (NULL);
+  return t2;
+}
+
 int
 test_sum_rationalize (int n)
 {
@@ -1480,6 +1516,7 @@ main (int argc, const char *argv[])
   t += test_S3(500);
   t += test_S4(500);
   t += test_series_tan (100);
+  t += test_map (20000);
 
   // Test rationalize
   t += test_rationalize (1);
@@ -187,6 +187,20 @@ void test_op ()
   x = may_eval (may_map_c (x, may_sin_c));
   check (x, "sin(1)");
 
+  /* Check parallel MAP function */
+  x = may_eval (may_pmap_c (may_parse_str ("{0,2,x+y}"), may_sin_c));
+  check (x, "{0,sin(2),sin(y+x)}");
+  {
+    may_t tab[1000];
+    for (int i = 0; i < 1000; i++)
+      tab[i] = may_add_c (may_set_str ("x"), may_set_ui (i));
+    x = may_eval (may_list_vc (1000, tab));
+    may_t y = may_pmap (x, may_exp);
+    if (may_identical (y, may_map (x, may_exp)) != 0)
+      fail ("pmap", y);
+    check (may_op (y, 999), "exp(999+x)");
+  }
+
   may_keep (NULL);
 }
 
@@ -250,6 +264,47 @@ void test_expand ()
   if (may_identical (x, y) != 0)
     fail ("expand 5.4", x);
 
+  x = may_parse_str ("(1+3*x+2*x^2)^1000");
+  x = may_expand (x);
+  check_bool (may_nops (x) == 2001);
+  y = may_replace (x, may_set_str ("x"), may_set_ui (2));
+  if (may_identical (y, may_parse_str ("15^1000")) != 0)
+    fail ("expand 5.5", y);
+  y = may_replace (x, may_set_str ("x"), may_set_si (-1));
+  check (y, "0");
+
+  x = may_parse_str ("(x^2/2-x^5/3)^3");
+  x = may_expand (x);
+  check (x, "1/8*x^6-1/4*x^9+1/6*x^12-1/27*x^15");
+
+  x = may_set_ui (1);
+  for (int i = 1; i <= 200; i++)
+    x = may_add (x, may_mul (may_set_si (i % 7 - 3),
+                             may_pow (may_set_str ("x"), may_set_ui (i))));
+  y = may_expand (may_mul (may_mul (x, x), x));
+  x = may_expand (may_pow (x, may_set_ui (3)));
+  if (may_identical (x, y) != 0)
+    fail ("expand 5.6", x);
+
+  x = y = may_set_ui (0);
+  for (int i = 0; i < 300; i++) {
+    may_t n = may_set_ui (i);
+    x = may_add (x, may_replace (may_parse_str ("(i%5-2)*x^i*y^(i%17)*z^(i%11)"),
+                                 may_set_str ("i"), n));
+    y = may_add (y, may_replace (may_parse_str ("(i%7-3)*x^(i%23)*y^(i%13)*w^i"),
+                                 may_set_str ("i"), n));
+  }
+  {
+    const char *const name[4] = {"x", "y", "z", "w"};
+    const void *value[4] = {may_set_ui (2), may_set_ui (3), may_set_ui (5), may_set_si (-1)};
+    may_t z = may_expand (may_mul (x, y));
+    x = may_eval (may_mul (may_subs_c (x, 1, 4, name, value),
+                           may_subs_c (y, 1, 4, name, value)));
+    z = may_eval (may_subs_c (z, 1, 4, name, value));
+    if (may_identical (x, z) != 0)
+      fail ("expand 5.7", z);
+  }
+
   x = may_parse_str ("1+x");
   x = may_expand (x);
   check (x, "1+x");
@@ -317,67 +372,98 @@ void test_expand ()
   may_keep (NULL);
 }
 
-#if 0
 void test_matrix ()
 {
-  may_t a, b, det, trace, test;
-  may_size_t n;
-  char *s;
+  may_mat_t a, b, c;
+  may_error_e e;
+  unsigned int i, j, n;
   static const char *trace_str[] =
     {"2+x", "4+2*x", "6+3*x", "8+4*x", "10+5*x"};
   static const char *det_str[] =
     {"2+x", "4*x+x^2", "6*x^2+x^3", "8*x^3+x^4", "10*x^4+x^5"};
 
   may_mark ();
-
-  /* Check det && trace */
-  for (n = 1 ; n < 6 ; n++)
-    {
-      a = may_mat_fill (n, n, may_set_ui (2));
-      if (!may_mat_purenum_p(a))
-	fail ("PureNumP", a);
-      if (!may_mat_square_p(a))
-	fail ("SquareP", a);
-
-      b = may_mat_identity (n, may_set_str("x") );
-      a = may_mat_add (a, b);
-      if (may_mat_purenum_p(a))
-	fail ("PureNumP2", a);
-
-      trace = may_mat_trace (a);
-      test  = may_parse_str (trace_str[n-1]);
-      if (may_identical (trace, test))
-	fail2 ("trace", trace_str[n-1], trace);
-
-      det   = may_expand (may_mat_det (a));
-      test  = may_parse_str (det_str[n-1]);
-      if (may_identical (det, test))
-	fail2 ("det", det_str[n-1], det);
-
-      may_compact (NULL);
-    }
+  may_mat_init (a, 0, 0);
+  may_mat_init (b, 0, 0);
+  may_mat_init (c, 0, 0);
+
+  /* Check det && trace of 2*ONES+x*ID */
+  for (n = 1 ; n < 6 ; n++) {
+    may_mat_resize (a, n, n);
+    may_mat_fill_y (a, may_set_ui (2));
+    may_mat_identity (b, n, may_set_str ("x"));
+    may_mat_add (a, a, b);
+    check (may_mat_trace (a), trace_str[n-1]);
+    check (may_mat_det (a), det_str[n-1]);
+  }
 
   /* Check product of matrix */
-  a = may_mat_fill (4, 4, may_set_ui (2));
-  b = may_mat_identity (4, may_set_str ("x"));
-  b = may_mat_add (a, b);
-  a = may_mat_mul (a, b);
-
-  s = may_get_string (NULL, 0, a);
-  if (strcmp(s, "[16+2*x,16+2*x,16+2*x,16+2*x;16+2*x,16+2*x,16+2*x,16+2*x;16+2*x,16+2*x,16+2*x,16+2*x;16+2*x,16+2*x,16+2*x,16+2*x]"))
-    fail ("mat_mul_symbolique", a);
-
-  a = may_mat_fill (4, 4, may_set_ui (2));
-  b = may_mat_identity (4, may_set_si (-5));
-  b = may_mat_add (a, b);
-  a = may_mat_mul (a, b);
-  s = may_get_string (NULL, 0, a);
-  if (strcmp(s, "[6,6,6,6;6,6,6,6;6,6,6,6;6,6,6,6]"))
-    fail ("mat_mul_num", a);
+  may_mat_resize (a, 4, 4);
+  may_mat_fill_y (a, may_set_ui (2));
+  may_mat_identity (b, 4, may_set_str ("x"));
+  may_mat_add (b, a, b);
+  may_mat_mul (c, a, b);
+  check (may_mat_get_list (c), "{{16+2*x,16+2*x,16+2*x,16+2*x},{16+2*x,16+2*x,16+2*x,16+2*x},{16+2*x,16+2*x,16+2*x,16+2*x},{16+2*x,16+2*x,16+2*x,16+2*x}}");
+  may_mat_identity (b, 4, may_set_si (-5));
+  may_mat_add (b, a, b);
+  may_mat_mul (c, a, b);
+  check (may_mat_get_list (c), "{{6,6,6,6},{6,6,6,6},{6,6,6,6},{6,6,6,6}}");
+  may_mat_transpose (c, a);
+  check_si (may_mat_row (c), 4);
+
+  /* Numerical determinant, rank and solve */
+  may_mat_set_list (a, may_parse_str ("{{2,-1,0},{-1,2,-1},{0,-1,2}}"));
+  check (may_mat_det (a), "4");
+  may_mat_set_list (a, may_parse_str ("{{1/2,1/3},{1/3,1/4}}"));
+  check (may_mat_det (a), "1/72");
+  may_mat_set_list (a, may_parse_str ("{{1,2,3},{4,5,6},{7,8,9}}"));
+  check (may_mat_det (a), "0");
+  check_si (may_mat_rank (a), 2);
+  may_mat_set_list (a, may_parse_str ("{{0,1},{1,0}}"));
+  check (may_mat_det (a), "-1");
+  may_mat_set_list (a, may_parse_str ("{{1,2},{3,4}}"));
+  may_mat_set_list (b, may_parse_str ("{{1},{1/2}}"));
+  may_mat_solve (c, a, b);
+  check (may_mat_get_list (c), "{{-3/2},{5/4}}");
+  may_mat_inverse (c, a);
+  check (may_mat_get_list (c), "{{-2,1},{3/2,-1/2}}");
+  may_mat_set_list (a, may_parse_str ("{{0.5,1},{2,1}}"));
+  check (may_mat_det (a), "-1.5");
+
+  /* Symbolic determinant, rank and solve */
+  may_mat_resize (a, 4, 4);
+  for (i = 0; i < 4; i++)
+    for (j = 0; j < 4; j++)
+      may_mat_set_at (a, i, j, may_pow_si_c (may_set_str (i == 0 ? "a" : i == 1 ? "b" : i == 2 ? "c" : "d"), j));
+  check (may_expand (may_sub (may_mat_det (a), may_parse_str ("(b-a)*(c-a)*(c-b)*(d-a)*(d-b)*(d-c)"))), "0");
+  may_mat_set_list (a, may_parse_str ("{{x,y},{x^2,x*y}}"));
+  check_si (may_mat_rank (a), 1);
+  may_mat_set_list (a, may_parse_str ("{{1/x,1},{1,x}}"));
+  check (may_mat_det (a), "0");
+  may_mat_set_list (a, may_parse_str ("{{a,b},{c,d}}"));
+  may_mat_inverse (c, a);
+  check (may_mat_get_list (c), "{{-d/(b*c-d*a),b/(b*c-d*a)},{c/(b*c-d*a),-a/(b*c-d*a)}}");
+
+  /* Errors */
+  MAY_TRY {
+    may_mat_set_list (a, may_parse_str ("{{1,2},{2,4}}"));
+    may_mat_inverse (c, a);
+    e = MAY_NO_ERR;
+  } MAY_CATCH {
+    may_error_get (&e, NULL);
+  } MAY_ENDTRY;
+  check_bool (e == MAY_SINGULAR_MATRIX_ERR);
+  MAY_TRY {
+    may_mat_resize (a, 2, 3);
+    may_mat_det (a);
+    e = MAY_NO_ERR;
+  } MAY_CATCH {
+    may_error_get (&e, NULL);
+  } MAY_ENDTRY;
+  check_bool (e == MAY_DIMENSION_ERR);
 
   may_keep (NULL);
 }
-#endif
 
 void test_eval ()
 {
@@ -842,6 +928,19 @@ void test_get_name ()
   if (strcmp (may_get_name(x), "f") != 0)
     fail ("exp", x);
 
+  /* The symbols are interned: they survive the compacts */
+  may_mark_t mark;
+  may_mark (mark);
+  x = may_set_str ("x");
+  may_t y = may_set_str_domain ("x", MAY_REAL_D);
+  may_compact (mark, NULL);
+  check_bool (x == may_set_str ("x"));
+  check_bool (x == may_op (may_parse_str ("sin(x)"), 0));
+  check_bool (y == may_set_str_domain ("x", MAY_REAL_D) && y != x);
+  check (x, "x");
+  check_bool (may_symbol_interned_p (x));
+  check_bool (!may_symbol_interned_p ((const void *) &test_get_name));
+
   may_keep (NULL);
 }
 
@@ -875,6 +974,19 @@ void test_add_c (void)
   check (x, "x");
   check (y, "y");
 
+  /* Compact an expression too deep for a recursive walk */
+  (may_mark) (mark2);
+  z = x;
+  for (int i = 0; i < 100000; i++)
+    z = may_func_c ("f", z);
+  z = (may_compact) (mark2, z);
+  for (int i = 0; i < 100000; i++) {
+    check_bool (MAY_TYPE (z) == MAY_FUNC_T
+                && strcmp (may_get_name (z), "f") == 0);
+    z = MAY_AT (z, 1);
+  }
+  check_bool (z == x);
+
   (may_compact) (mark1, NULL);
 }
 
@@ -903,6 +1015,74 @@ void test_error_handler (void)
 }
 
 
+void test_budget (void)
+{
+  may_t a, b, q, r, x;
+  may_error_e e;
+  const char *s;
+  volatile int cancel;
+  unsigned long i;
+
+  may_mark ();
+  x = may_set_str ("x");
+  a = may_sub (may_pow (x, may_set_ui (200)), may_set_ui (1));
+  b = may_sub (x, may_set_ui (2));
+
+  /* Cancel flag */
+  cancel = 1;
+  check_bool (may_kernel_cancel (&cancel) == NULL);
+  MAY_TRY {
+    may_div_qr (&q, &r, a, b, x);
+    e = MAY_NO_ERR;
+  } MAY_CATCH {
+    e = MAY_ERROR;
+  } MAY_ENDTRY;
+  check_bool (e == MAY_INTERRUPT_ERR);
+  may_error_get (NULL, &s);
+  check_bool (strcmp (s, "cancel") == 0);
+  check_bool (strcmp (may_error_what (e), "Interrupted") == 0);
+  /* The budget is removed once exceeded */
+  check_bool (may_kernel_cancel (NULL) == NULL);
+  check_bool (may_div_qr (&q, &r, a, b, x) != 0);
+
+  /* A cancel flag which is not set */
+  cancel = 0;
+  may_kernel_cancel (&cancel);
+  check_bool (may_div_qr (&q, &r, a, b, x) != 0);
+  check_bool (may_kernel_cancel (NULL) == &cancel);
+
+  /* Timeout */
+  may_kernel_timeout (1);
+  MAY_TRY {
+    for (i = 0; i < 1000000; i++)
+      may_div_qr (&q, &r, a, b, x);
+    e = MAY_NO_ERR;
+  } MAY_CATCH {
+    e = MAY_ERROR;
+  } MAY_ENDTRY;
+  check_bool (e == MAY_INTERRUPT_ERR);
+  may_error_get (NULL, &s);
+  check_bool (strcmp (s, "timeout") == 0);
+  check_bool (may_kernel_timeout (0) == 0);
+
+  /* Memory budget */
+  may_kernel_memlimit (4096);
+  MAY_TRY {
+    may_expand (may_pow (may_add (x, may_set_ui (1)), may_set_ui (100)));
+    e = MAY_NO_ERR;
+  } MAY_CATCH {
+    e = MAY_ERROR;
+  } MAY_ENDTRY;
+  check_bool (e == MAY_INTERRUPT_ERR);
+  may_error_get (NULL, &s);
+  check_bool (strcmp (s, "memory") == 0);
+  check_bool (may_kernel_memlimit (0) == 0);
+  /* The heap can be used again */
+  check_bool (may_div_qr (&q, &r, a, b, x) != 0);
+
+  may_keep (NULL);
+}
+
 void test_domain ()
 {
   may_t x, y;
@@ -1035,6 +1215,32 @@ void test_subs (void)
   y = may_eval (y);
   check (y, "f(2)");
 
+  /* Compiled substitution map */
+  {
+    may_binding_t b[4] = {{"x", may_parse_str ("x+y"), NULL},
+                          {"f", NULL, my_f},
+                          {"exp", NULL, my_exp},
+                          {"f", may_set_ui (3), NULL}};
+    may_t map = may_subs_compile (4, b);
+    y = may_subs_apply (may_parse_str ("x+y+exp(x)*log(y)"), 2, map);
+    ref = may_parse_str ("x + 3*y + exp2(x + 3*y) * log(y)");
+    if (may_identical (ref, y))
+      fail ("subs map1", y);
+    y = may_subs_apply (may_parse_str ("f(exp(f(z)))+sin(f)+f"), 1, map);
+    check (y, "-exp2(-z)+sin(f)+f");
+
+    may_t src[1000], dest[1000];
+    for (int i = 0; i < 1000; i++)
+      src[i] = may_eval (may_add_c (may_func_c ("f", may_set_ui (i)),
+                                    may_mul_c (may_set_ui (i),
+                                               may_set_str ("x"))));
+    may_subs_papply (1000, dest, src, 1, map);
+    for (int i = 0; i < 1000; i++)
+      if (may_identical (dest[i], may_subs_apply (src[i], 1, map)) != 0)
+        fail ("subs papply", dest[i]);
+    check (dest[999], "-999+999*(y+x)");
+  }
+
   may_keep (NULL);
 }
 
@@ -1848,6 +2054,22 @@ void test_sqrtsimp ()
   x = may_sqrtsimp (x);
   check (x, "2*sqrt(3)");
 
+  x = may_parse_str ("sqrt(30)*sqrt(105)");
+  x = may_sqrtsimp (x);
+  check (x, "15*sqrt(2)*sqrt(7)");
+
+  x = may_parse_str ("-14^(1/2)*15^(1/2)+6^(1/2)*35^(1/2)");
+  x = may_sqrtsimp (x);
+  check (x, "0");
+
+  x = may_parse_str ("(7+5*sqrt(2))^(1/3)");
+  x = may_sqrtsimp (x);
+  check (x, "1+sqrt(2)");
+
+  x = may_parse_str ("(3+sqrt(5))^(1/3)");
+  x = may_sqrtsimp (x);
+  check (x, "(3+sqrt(5))^(1/3)");
+
   may_keep (NULL);
 }
 
@@ -1927,6 +2149,68 @@ void test_rewrite (void)
   may_keep (NULL);
 }
 
+static int
+test_rewrite_rules_int_p (may_t x)
+{
+  return MAY_TYPE (x) == MAY_INT_T;
+}
+
+void test_rewrite_rules (void)
+{
+  may_t x, r;
+  may_mark ();
+
+  int (*funcp[])(may_t) = { test_rewrite_rules_int_p };
+  may_rule_t rules[] = {
+    { may_parse_str ("sin($0)^2+cos($0)^2+$1"), may_parse_str ("1+$1"), 0, NULL },
+    { may_parse_str ("log(exp($0))"), may_parse_str ("$0"), 0, NULL },
+    { may_parse_str ("f($0)"), may_parse_str ("g($0+1)"), 1, funcp },
+    { may_parse_str ("g($0)"), may_parse_str ("h($0)"), 0, NULL },
+    { may_parse_str ("$0*$1^$2*$1^$3"), may_parse_str ("$0*$1^($2+$3)"), 0, NULL },
+    { may_parse_str ("$2"), may_parse_str ("z"), 2, NULL }
+  };
+  r = may_rewrite_compile (numberof (rules), rules);
+
+  /* Bottom-up: the inner rule applies before the outer one */
+  x = may_parse_str ("log(exp(sin(x)^2+cos(x)^2+y))");
+  check (may_rewrite_rules (x, r, MAY_REWRITE_ONCE), "1+y");
+
+  /* Predicates of the wildcards */
+  x = may_parse_str ("f(2)+f(x)");
+  check (may_rewrite_rules (x, r, MAY_REWRITE_ONCE), "g(3)+f(x)");
+  check (may_rewrite_rules (x, r, MAY_REWRITE_REPEAT), "h(3)+f(x)");
+
+  /* Keep x if no rule applies */
+  x = may_parse_str ("32+a*b^c*c^d");
+  check_bool (may_rewrite_rules (x, r, MAY_REWRITE_MEMO) == x);
+  x = may_parse_str ("32+a*b^c*c^c*b^d");
+  check (may_rewrite_rules (x, r, MAY_REWRITE_MEMO|MAY_REWRITE_REPEAT),
+         "32+a*c^c*b^(c+d)");
+
+  /* The compiled rules survive compaction */
+  r = may_compact (r);
+  x = may_parse_str ("cos(f(2))^2+sin(f(2))^2+log(exp(f(1)))");
+  check (may_rewrite_rules (x, r, MAY_REWRITE_REPEAT|MAY_REWRITE_MEMO), "1+h(2)");
+
+  /* The rule with a too big wildcard never applies */
+  check (may_rewrite_rules (may_parse_str ("x"), r, MAY_REWRITE_ONCE), "x");
+
+  /* Wildcards with several digits, and too large ones */
+  may_rule_t rules2[] = {
+    { may_parse_str ("f($12,$3)"), may_parse_str ("$3-$12"), 0, NULL },
+    { may_parse_str ("g($100)"), may_parse_str ("$100"), 0, NULL }
+  };
+  r = may_rewrite_compile (numberof (rules2), rules2);
+  x = may_parse_str ("f(x,y)+g(z)");
+  check (may_rewrite_rules (x, r, MAY_REWRITE_ONCE), "y-x+g(z)");
+
+  /* Empty set of rules */
+  r = may_rewrite_compile (0, rules2);
+  check_bool (may_rewrite_rules (x, r, MAY_REWRITE_REPEAT) == x);
+
+  may_keep (NULL);
+}
+
 may_t naive_gcd (may_t x, may_t y)
 {
   may_t tab[2];
@@ -2324,9 +2608,22 @@ void test_comdenom (void)
   check (d, "x+abs(x)");
 
   may_comdenom (&n, &d, may_parse_str ("-7/2*sign(2-x)/abs(2-x)+4/5/(5-x^2)-31/25/(1-1/5*x^2)+87/25*sign(5-x^2)*x/abs(5-x^2)-1/50*sign(x)/abs(x)+8/5*x^2/(5-x^2)^2+17/5*x/(5-x^2)^2"));
-  check (n, "350*abs(2-x)*abs(5-x^2)*abs(x)*x^2+174*abs(2-x)*(5-x^2)^2*sign(5-x^2)*abs(x)*x+170*abs(2-x)*abs(5-x^2)*abs(x)*x-abs(2-x)*(5-x^2)^2*abs(5-x^2)*sign(x)-175*sign(2-x)*(5-x^2)^2*abs(5-x^2)*abs(x)-1350*abs(2-x)*abs(5-x^2)*abs(x)");
+  check (n, "-270*abs(2-x)*(5-x^2)*abs(5-x^2)*abs(x)+80*abs(2-x)*abs(5-x^2)*abs(x)*x^2+174*abs(2-x)*(5-x^2)^2*sign(5-x^2)*abs(x)*x+170*abs(2-x)*abs(5-x^2)*abs(x)*x-abs(2-x)*(5-x^2)^2*abs(5-x^2)*sign(x)-175*sign(2-x)*(5-x^2)^2*abs(5-x^2)*abs(x)");
   check (d, "50*abs(2-x)*(5-x^2)^2*abs(5-x^2)*abs(x)");
 
+  /* Sum of many fractions (added up a product tree) */
+  {
+    may_t tab[1200];
+    for (int i = 0; i < 1200; i++)
+      tab[i] = may_div_c (may_pow_c (may_set_str ("y"), may_set_ui (i)),
+                          may_add_c (may_set_str ("x"), may_set_ui (i % 4)));
+    may_comdenom (&n, &d, may_eval (may_add_vc (1200, tab)));
+    check (d, "x*(1+x)*(2+x)*(3+x)");
+    n = may_replace (may_replace (may_div (n, d), may_set_str ("y"), MAY_ONE),
+                     may_set_str ("x"), may_set_ui (5));
+    check (n, "2665/14");
+  }
+
   // Bug.
   may_comdenom (&n, &d, may_parse_str ("169178706511497896613749514463940544830752173718002301211133190226927536125183931297186064408275426210909978360551099687840952332642700116732547658911597459850830580547584/10025803933873765003935660079928874067189934641006113101427956743842798379417500812000841881753338409625715367476858382770619896365966484365223542960377546476818918610381359478637518406831035267196420624792596587582238498725928366184234619140625 + 8942822833778007099823557732086952553642352820482295898195430073195306132440210847667808221989225663598742022302460815626563208810932003375087175068157120660141545298591744/150387059008106475059034901198933111007849019615091696521419351157641975691262512180012628226300076144385730512152875741559298445489497265478353144405663197152283779155720392179562776102465529007946309371888948813733577480888925492763519287109375 * x + 219236472261292884807191372771192612378357271099208319033038953504076533578137437243228973251164033203262431833070896919348318928187423766531706749416331235150031400674000896/2255805885121597125885523517983996665117735294226375447821290267364629635368937682700189423394501142165785957682293136123389476682342458982175297166084947957284256687335805882693441641536982935119194640578334232206003662213333882391452789306640625 * x ^ 2 + 151393862708441642070764141013246866965032788986966823603515816303128784862275756079907253791664723966724229315831204704988917499748269349499327245915068454795867403319246848/2255805885121597125885523517983996665117735294226375447821290267364629635368937682700189423394501142165785957682293136123389476682342458982175297166084947957284256687335805882693441641536982935119194640578334232206003662213333882391452789306640625 * x ^ 4 + 73349706412226210070940744559705229490313767377399644041248856405810527998066015673532239025996065662534177434879910118379514218045077025641819368160243396550012755465207808/751935295040532375295174505994665555039245098075458482607096755788209878456312560900063141131500380721928652560764378707796492227447486327391765722028315985761418895778601960897813880512327645039731546859444744068667887404444627463817596435546875 * x ^ 3 + 9358430874596626501627629806077383513029076326762453234153422022577571181433900657205482567889546976971250225543818600246448569877515297288769167515560059975734110355193856/751935295040532375295174505994665555039245098075458482607096755788209878456312560900063141131500380721928652560764378707796492227447486327391765722028315985761418895778601960897813880512327645039731546859444744068667887404444627463817596435546875 * x ^ 6 + 25153071007375129047298419168148515514587897808658252375124484263618029456185636294177525874166885504093489255937876075156098062123220992527082997811631408713889081792135168/751935295040532375295174505994665555039245098075458482607096755788209878456312560900063141131500380721928652560764378707796492227447486327391765722028315985761418895778601960897813880512327645039731546859444744068667887404444627463817596435546875 * x ^ 5 + 565879067064805783929587204429037461217667815680477642965781260625287530554027906153414523910108139764203973573362479088419489984854540869875603026440643698974627226189824/751935295040532375295174505994665555039245098075458482607096755788209878456312560900063141131500380721928652560764378707796492227447486327391765722028315985761418895778601960897813880512327645039731546859444744068667887404444627463817596435546875 * x ^ 8 + 527649442945820628991658391396009377441442531584218817686637533864526934748231945430434277794148443900499177614585054116101305641776618873575215368144115532087076696621056/150387059008106475059034901198933111007849019615091696521419351157641975691262512180012628226300076144385730512152875741559298445489497265478353144405663197152283779155720392179562776102465529007946309371888948813733577480888925492763519287109375 * x ^ 7 + 33283059650091669567716912507701655989511467282228192494352245679860305539382366159560713151579633179793274868080347281359100560183825952713567932080789731452065842987008/2255805885121597125885523517983996665117735294226375447821290267364629635368937682700189423394501142165785957682293136123389476682342458982175297166084947957284256687335805882693441641536982935119194640578334232206003662213333882391452789306640625 * x ^ 10 + 91837488471719744969245414653665714273543594853691061450862216287178592813938645647440306464586809625306224871942599389622834432304299894053900240012920381013859686678528/751935295040532375295174505994665555039245098075458482607096755788209878456312560900063141131500380721928652560764378707796492227447486327391765722028315985761418895778601960897813880512327645039731546859444744068667887404444627463817596435546875 * x ^ 9 + 3829222358014225706251797284951250421790324766635686955284751225906236732803657704022861985973038553745297996080029850378524195601471126340926541392973503808023822336/50129019669368825019678300399644370335949673205030565507139783719213991897087504060004209408766692048128576837384291913853099481829832421826117714801887732384094593051906797393187592034155176335982103123962982937911192493629641830921173095703125 * x ^ 12 + 193375729079718398165715762890038146300411400715102191241879936908264955006584714053154530291638446964137548802041507444115471877874291880216790340345161942305203027968/150387059008106475059034901198933111007849019615091696521419351157641975691262512180012628226300076144385730512152875741559298445489497265478353144405663197152283779155720392179562776102465529007946309371888948813733577480888925492763519287109375 * x ^ 11 + 20810991076164270142672811331256795770599591123020037800460604488620851808715531000124249923766513879050532587391466578144153236964516990983296420613986433739259904/451161177024319425177104703596799333023547058845275089564258053472925927073787536540037884678900228433157191536458627224677895336468491796435059433216989591456851337467161176538688328307396587023838928115666846441200732442666776478290557861328125 * x ^ 14 + 83243964304657080570691245325027183082398364492080151201842417954483407234862124000496999695066055516202130349565866312576612947858067963933185682455945734957039616/30077411801621295011806980239786622201569803923018339304283870231528395138252502436002525645260015228877146102430575148311859689097899453095670628881132639430456755831144078435912555220493105801589261874377789762746715496177785098552703857421875 * x ^ 13"));
   // Assertions are raised for the bug
@@ -2404,6 +2701,57 @@ void test_may_list (void)
   may_compact (mark, NULL);
 }
 
+void test_may_hset (void)
+{
+  may_t x, z;
+  may_hset_t set;
+  may_size_t i, j;
+  char name[20];
+  may_mark_t mark;
+
+  may_mark (mark);
+
+  may_hset_init (set, 0);
+  check_si (may_hset_get_size (set), 0);
+  check_bool (may_hset_find (&i, set, MAY_ONE) == false);
+
+  /* Enough elements to rehash several times */
+  for (i = 0; i < 1000; i++) {
+    sprintf (name, "x%d", (int) i);
+    check_si (may_hset_push_back (set, may_set_str (name)), i);
+  }
+  check_si (may_hset_push_back (set, may_parse_str ("x17")), 17);
+  check_si (may_hset_get_size (set), 1000);
+  check (may_hset_at (set, 999), "x999");
+
+  may_hset_compact (mark, set);
+
+  check_bool (may_hset_find (&j, set, may_parse_str ("x500")) && j == 500);
+  check_bool (may_hset_find (&j, set, may_parse_str ("y")) == false);
+  check_si (may_hset_push_back (set, may_parse_str ("y")), 1000);
+  check_si (may_hset_push_back (set, may_parse_str ("x0")), 0);
+
+  may_hset_reset (set);
+  check_si (may_hset_get_size (set), 0);
+  check_bool (may_hset_find (&j, set, may_parse_str ("x500")) == false);
+  check_si (may_hset_push_back (set, may_parse_str ("sin(x)")), 0);
+  z = may_hset_quit (set);
+  check_bool (MAY_TYPE (z) == MAY_LIST_T && MAY_NODE_SIZE(z) == 1);
+
+  /* Lots of distinct kernels */
+  x = may_set_ui (0);
+  for (i = 0; i < 2000; i++)
+    x = may_add_c (x, may_pow_c (may_cos_c (may_set_ui (i+1)), MAY_TWO));
+  x = may_eval (x);
+  check_si (may_nops (may_indets (x, MAY_INDETS_NUM)), 2000);
+  z = may_eval (may_mul_c (x, may_add_c (x, may_parse_str ("y"))));
+  check (may_find_one_polvar (1, &z), "y");
+  may_t tab[2] = {x, z};
+  check (may_find_unused_polvar (2, tab), "{y}");
+
+  may_compact (mark, NULL);
+}
+
 void test_degree (void)
 {
   may_t c, x, y, z, leader;
@@ -2575,6 +2923,72 @@ void test_taylor (void)
   z = may_taylor (may_parse_str ("acosh(x)"), may_set_str ("x"), may_set_ui (0), 3);
   check (z, "-1/6*I*x^3-I*x+1/2*I*PI");
 
+  z = may_taylor (may_parse_str ("exp(sin(x))"), may_set_str ("x"), may_set_ui (0), 6);
+  check (z, "1+1/2*x^2-1/8*x^4-1/240*x^6-1/15*x^5+x");
+  z = may_taylor (may_parse_str ("atan(x+1)"), may_set_str ("x"), may_set_ui (0), 6);
+  check (z, "-1/4*x^2+1/12*x^3+1/48*x^6-1/40*x^5+1/2*x+1/4*PI");
+  z = may_taylor (may_parse_str ("x^x"), may_set_str ("x"), may_set_ui (1), 3);
+  check (z, "-1/2*(1-x)^3+(1-x)^2+x");
+  z = may_taylor (may_parse_str ("tan(x)"), may_set_str ("x"), may_set_ui (0), 25);
+  check_bool (may_identical (z, may_taylor (may_parse_str ("sin(x)/cos(x)"),
+                                            may_set_str ("x"),
+                                            may_set_ui (0), 25)) == 0);
+
+  /* At a non zero point, the coefficients are expanded */
+  z = may_taylor (may_parse_str ("tan(x)"), may_set_str ("x"), may_set_ui (1), 3);
+  check (z, "tan(1)+(1+tan(1)^2)*(x-1)+(tan(1)+tan(1)^3)*(x-1)^2"
+         "+(1/3+4/3*tan(1)^2+tan(1)^4)*(x-1)^3");
+  z = may_taylor (may_parse_str ("exp(x)/(1+x)"), may_set_str ("x"), may_set_ui (1), 3);
+  check (z, "1/2*exp(1)+1/4*exp(1)*(x-1)+1/8*exp(1)*(x-1)^2"
+         "+1/48*exp(1)*(x-1)^3");
+  z = may_taylor (may_parse_str ("exp(sin(x))"), may_set_str ("x"), may_set_ui (1), 8);
+  check_bool (may_nops (z) == 9
+              && strlen (may_get_string (NULL, 0, z)) < 2000);
+  /* At a symbolic point (with the derivatives) */
+  z = may_taylor (may_parse_str ("atan(x)^2"), may_set_str ("x"), may_set_str ("a"), 8);
+  check_bool (may_nops (z) == 9
+              && strlen (may_get_string (NULL, 0, z)) < 2000);
+  check_bool (may_identical (may_replace (z, may_set_str ("a"), may_set_ui (0)),
+                             may_taylor (may_parse_str ("atan(x)^2"),
+                                         may_set_str ("x"),
+                                         may_set_ui (0), 8)) == 0);
+
+  may_keep (NULL);
+}
+
+void test_gradient (void)
+{
+  may_t v[3], f[2], z;
+  may_mark ();
+
+  v[0] = may_set_str ("x");
+  v[1] = may_set_str ("y");
+  v[2] = may_set_str ("z");
+  z = may_gradient (may_parse_str ("x^y+z"), 3, v);
+  check (z, "{y*x^(-1+y),x^y*log(x),1}");
+  z = may_gradient (may_parse_str ("a*3"), 3, v);
+  check (z, "{0,0,0}");
+
+  /* Compare with may_diff */
+  f[0] = may_parse_str ("exp(x+y)*log(z)/(x^2+y^2+z^2)+f(x,y)*atan(x*z)+abs(y)");
+  f[1] = may_parse_str ("(x+y+z)^10*cos(x*y*z)+tanh(y)+acosh(z*x)");
+  for (int k = 0; k < 2; k++) {
+    may_t g = may_gradient (f[k], 3, v);
+    for (int i = 0; i < 3; i++)
+      check_bool (may_zero_p (may_expand (may_sub (may_op (g, i),
+                                                   may_diff (f[k], v[i])))));
+  }
+
+  /* Forward mode (more outputs than variables) */
+  z = may_jacobian (2, f, 1, v);
+  for (int k = 0; k < 2; k++)
+    check_bool (may_zero_p (may_expand (may_sub (may_op (may_op (z, k), 0),
+                                                 may_diff (f[k], v[0])))));
+  f[0] = may_parse_str ("x*y");
+  f[1] = may_parse_str ("sin(x+z)");
+  z = may_jacobian (2, f, 3, v);
+  check (z, "{{y,x,0},{cos(z+x),0,cos(z+x)}}");
+
   may_keep (NULL);
 }
 
@@ -2777,12 +3191,12 @@ void test_gcd (void)
   temp[2] = may_expand (may_diff (temp[0], x));
   a = may_gcd (3, temp);
   check_bool (a != NULL);
-  check (a, "1+15*x^2+15*x^4+20*x^3+x^6+6*x^5+6*x");
+  check (a, "(1+x)^6");
 
   temp[2] = may_expand (may_diff (temp[1], x));
   a = may_gcd (3, temp);
   check_bool (a != NULL);
-  check (a, "x^5+5*x^4+10*x^3+10*x^2+5*x+1");
+  check (a, "(1+x)^5");
 
   temp[0] = may_parse_str ("x^2-4");
   temp[1] = may_parse_str ("x^2+4*x+4");
@@ -2864,7 +3278,22 @@ void test_gcd (void)
   temp[1] = may_parse_str ("(x-y)^2*(a-1)^10");
   a = may_gcd (2, temp);
   check_bool (a != NULL);
-  check (a, "x^2-2*x*y+y^2");
+  check (a, "(y-x)^2");
+
+  temp[0] = may_parse_str ("(x^2-1)^30*(x^3-1)^20");
+  temp[1] = may_parse_str ("(x+1)^40*(x^2+x+1)^7");
+  a = may_gcd (2, temp);
+  check (a, "(1+x+x^2)^7*(1+x)^30");
+
+  temp[0] = may_parse_str ("(x^2-1)^5");
+  temp[1] = may_parse_str ("(x^2+2*x+1)^3");
+  a = may_gcd (2, temp);
+  check (a, "(1+x)^5");
+
+  temp[0] = may_expand (may_parse_str ("(1+x^2+y^3+z^4)^3*(1-x^2+y-z)^2"));
+  temp[1] = may_parse_str ("(1+x^2+y^3+z^4)^2*(1-x^2+y-z)");
+  a = may_gcd (2, temp);
+  check (a, "-(1+x^2+y^3+z^4)^2*(1-x^2+y-z)");
 
   temp[0] = may_parse_str ("exp(x)-1");
   temp[1] = may_parse_str ("exp(x)^2-1");
@@ -3077,6 +3506,36 @@ void test_rationalize (void)
   may_keep (NULL);
 }
 
+void test_normal (void)
+{
+  may_t x, y;
+
+  may_mark ();
+  x = may_parse_str ("(x^2-1)/(x-1)");
+  check (may_normal (x), "1+x");
+
+  x = may_parse_str ("1/x+1/y-(x+y)/(x*y)");
+  check (may_normal (x), "0");
+
+  x = may_parse_str ("sin((x^2-1)/(x-1))");
+  check (may_normal (x), "sin(1+x)");
+
+  x = may_parse_str ("1/(1/x+1/y)");
+  check (may_normal (x), "x*y/(x+y)");
+
+  /* Equal rational functions have the same normal form */
+  x = may_parse_str ("2/(3*x-6)+1/(x-2)");
+  y = may_parse_str ("(10*x+5)/((3*x-6)*(2*x+1))");
+  check_bool (may_identical (may_normal (x), may_normal (y)) == 0);
+  check_bool (may_equal_p (x, y));
+  check_bool (!may_equal_p (x, may_parse_str ("5/(3*x-5)")));
+
+  x = may_parse_str ("(a+b)^3/(a^2-b^2)-(a+b)^2/(a-b)");
+  check_bool (may_equal_p (x, MAY_ZERO));
+
+  may_keep (NULL);
+}
+
 void test_intmod (void)
 {
   may_t a, b;
@@ -3127,6 +3586,57 @@ void test_intmod (void)
   b = may_parse_str ("-x");
   check (b, "16*x");
 
+  /* Check the word-size arithmetic against GMP */
+  {
+    static const char *const mod_str[] = {
+      "4611686018427387847", "4611686018427387903", "3037000493", "4611686018427387904"
+    };
+    mpz_t m, x, y, r;
+    mpz_inits (m, x, y, r, NULL);
+    may_kernel_intmod (NULL);
+    for (unsigned int i = 0; i < numberof (mod_str); i++) {
+      mpz_set_str (m, mod_str[i], 10);
+      mpz_set_ui (x, 1234567);
+      mpz_set_ui (y, 7654321);
+      for (unsigned long k = 0; k < 100; k++) {
+        /* Pseudo-random residues */
+        mpz_mul (x, x, x);
+        mpz_add_ui (x, x, k);
+        mpz_mod (x, x, m);
+        mpz_mul (y, y, x);
+        mpz_add_ui (y, y, 3);
+        mpz_mod (y, y, m);
+        /* The exponent is built before setting intmod so that it is not reduced */
+        may_t e = may_set_si (-(long) k-1);
+        may_kernel_intmod (may_set_z (m));
+        may_t mx = may_set_z (x), my = may_set_z (y);
+        may_t vadd = may_add (mx, my), vsub = may_sub (mx, my);
+        may_t vmul = may_mul (mx, my), vdiv = may_div (mx, my);
+        may_t vpow = may_pow (mx, may_set_ui (k*12345+1));
+        may_t vneg = may_pow (mx, e);
+        may_kernel_intmod (NULL);
+        mpz_add (r, x, y); mpz_mod (r, r, m);
+        check_bool (MAY_TYPE (vadd) == MAY_INT_T && mpz_cmp (MAY_INT (vadd), r) == 0);
+        mpz_sub (r, x, y); mpz_mod (r, r, m);
+        check_bool (mpz_cmp (MAY_INT (vsub), r) == 0);
+        mpz_mul (r, x, y); mpz_mod (r, r, m);
+        check_bool (mpz_cmp (MAY_INT (vmul), r) == 0);
+        if (mpz_invert (r, y, m)) {
+          mpz_mul (r, r, x); mpz_mod (r, r, m);
+          check_bool (MAY_TYPE (vdiv) == MAY_INT_T && mpz_cmp (MAY_INT (vdiv), r) == 0);
+        } else
+          check_bool (may_nan_p (vdiv));
+        mpz_powm_ui (r, x, k*12345+1, m);
+        check_bool (mpz_cmp (MAY_INT (vpow), r) == 0);
+        if (mpz_invert (r, x, m)) {
+          mpz_powm_ui (r, r, k+1, m);
+          check_bool (MAY_TYPE (vneg) == MAY_INT_T && mpz_cmp (MAY_INT (vneg), r) == 0);
+        } else
+          check_bool (may_nan_p (vneg));
+      }
+    }
+  }
+
   may_kernel_intmod (NULL);
   b = may_parse_str ("2-3");
   check (b, "-1");
@@ -3441,6 +3951,19 @@ void test_expand_var (void)
   a = may_collect (a, may_set_str ("a"));
   check (a, "1+a+(b+c)*a^2+d*a^3");
 
+  /* The coefficients are not expanded */
+  a = may_parse_str ("(x+1)^3*(b+c)^2+x*sin(x)+x/(1+x)");
+  a = may_collect (a, may_set_str ("x"));
+  check (a, "(b+c)^2+(b+c)^2*x^3+3*(b+c)^2*x^2+x*(3*(b+c)^2+1/(1+x)+sin(x))");
+  a = may_parse_str ("x*(b+c)-x*b-x*c+x^2*(y+1)^5");
+  a = may_collect (a, may_set_str ("x"));
+  check (a, "(1+y)^5*x^2");
+  a = may_collect (may_parse_str ("(b+c)^2"), may_set_str ("x"));
+  check (a, "(b+c)^2");
+  a = may_parse_str ("(x+y+1)^2*(z+1)");
+  a = may_collect (a, may_parse_str ("{x,y}"));
+  check_bool (may_zero_p (may_expand (may_sub (a, may_parse_str ("(x+y+1)^2*(z+1)")))));
+
   may_keep (NULL);
 }
 
@@ -3468,6 +3991,113 @@ void test_smod (void)
   may_keep (NULL);
 }
 
+void test_resultant (void)
+{
+  may_t a, b, x;
+  may_mark ();
+  x = may_set_str ("x");
+
+  a = may_resultant (may_parse_str ("x^2-2"), may_parse_str ("x^2-3"), x);
+  check (a, "1");
+  a = may_resultant (may_parse_str ("x*y-1"), may_parse_str ("x-y"), x);
+  check (a, "1-y^2");
+  a = may_resultant (may_parse_str ("(x-1)*(x+y)"), may_parse_str ("x^2-1"), x);
+  check (a, "0");
+  a = may_resultant (may_parse_str ("3"), may_parse_str ("x^2+y"), x);
+  check (a, "9");
+  check_bool (may_resultant (may_parse_str ("sin(x)"), x, x) == NULL);
+
+  /* The subresultant PRS (rational coefficients) and the multimodular
+     algorithm must agree: res(a/2,b) = res(a,b)/2^deg(b) */
+  a = may_parse_str ("(x+y+1)^5-3*x^3*y^2+x*z^2-5");
+  b = may_parse_str ("(x-2*y+z)^4+x^3*y-11");
+  a = may_resultant (a, b, x);
+  b = may_resultant (may_div (may_parse_str ("(x+y+1)^5-3*x^3*y^2+x*z^2-5"),
+                              may_set_ui (2)), b, x);
+  check_bool (may_identical (a, may_expand (may_mul (b, may_set_ui (16)))) == 0);
+
+  /* deg(a) < deg(b) with the multimodular algorithm */
+  a = may_resultant (may_parse_str ("x+y"), may_parse_str ("x^6-y"), x);
+  check (a, "y^6-y");
+  a = may_resultant (may_parse_str ("x^2+y"), may_parse_str ("x^5+y*x+1"), x);
+  b = may_resultant (may_parse_str ("x^5+y*x+1"), may_parse_str ("x^2+y"), x);
+  check_bool (may_identical (a, b) == 0);
+  b = may_resultant (may_parse_str ("x^2/3+y/3"), may_parse_str ("x^5+y*x+1"), x);
+  check_bool (may_identical (a, may_expand (may_mul (b, may_set_ui (243)))) == 0);
+
+  a = may_discriminant (may_parse_str ("a*x^2+b*x+c"), x);
+  check (a, "b^2-4*a*c");
+  a = may_discriminant (may_parse_str ("x^3+p*x+q"), x);
+  check (a, "-4*p^3-27*q^2");
+  a = may_discriminant (may_parse_str ("(x-1)^2*(x+3)"), x);
+  check (a, "0");
+
+  may_keep (NULL);
+}
+
+void test_compose (void)
+{
+  may_t a, b, x;
+  may_mark ();
+  x = may_set_str ("x");
+
+  a = may_compose (may_parse_str ("x^2+1"), may_parse_str ("x+y"), x);
+  check (a, "1+y^2+2*y*x+x^2");
+  a = may_compose (may_parse_str ("3*x^5-2*x^2+a*x+7"), may_parse_str ("x^2-x+1"), x);
+  check (a, "8+39*x^2+133*x^4-86*x^3+135*x^6-153*x^5+45*x^8-90*x^7+3*x^10-15*x^9+a*x^2+a-11*x-a*x");
+  a = may_compose (may_parse_str ("2/3"), may_parse_str ("x+1"), x);
+  check (a, "2/3");
+  check_bool (may_compose (may_parse_str ("1/x"), x, x) == NULL);
+
+  /* Divide and conquer */
+  a = may_parse_str ("(1+2*x-x^3)^7-5*x^10+x^20");
+  b = may_parse_str ("x^2-3*x+y");
+  check_bool (may_identical (may_compose (a, b, x),
+                             may_expand (may_replace (a, x, b))) == 0);
+
+  may_keep (NULL);
+}
+
+void test_multipoint (void)
+{
+  enum { N = MAY_MULTIEVAL_THRESHOLD + 100, n = 200 };
+  const unsigned long p = 1000003, npts = N + 1000;
+  static unsigned long f[N], pts[N + 1000], val[N + 1000];
+  unsigned long g[2*n], v[2*n], i, j;
+  may_mark ();
+
+  for (i = 0; i < N; i++)
+    f[i] = (i * 7919 + 13) % p;
+  for (i = 0; i < npts; i++)
+    pts[i] = (i * i + 3 * i + 1) % p;
+  /* Horner scheme and subproduct tree */
+  may_multieval_ui (val, N, f, 10, pts, p);
+  may_multieval_ui (val + 10, N, f, npts - 10, pts + 10, p);
+  for (i = 0; i < npts; i += 97) {
+    unsigned long r = 0;
+    for (j = N; j-- > 0; )
+      r = (r * pts[i] + f[j]) % p;
+    check_bool (val[i] == r);
+  }
+
+  /* Lagrange and subproduct tree, with one or several vectors */
+  for (i = 0; i < n; i++)
+    pts[i] = i * i + 1;
+  may_multieval_ui (v, n, f, n, pts, p);
+  may_multieval_ui (v + n, n, f, n, pts, p);
+  v[n+5] = (v[n+5] + 1) % p;
+  may_interpolate_ui (g, n, pts, 2, v, p);
+  check_bool (memcmp (g, f, n * sizeof *f) == 0);
+  check_bool (memcmp (g + n, f, n * sizeof *f) != 0);
+  may_multieval_ui (val, n, g + n, n, pts, p);
+  check_bool (memcmp (val, v + n, n * sizeof *f) == 0);
+  may_interpolate_ui (g, 20, pts, 1, v, p);
+  may_multieval_ui (val, 20, g, 20, pts, p);
+  check_bool (memcmp (val, v, 20 * sizeof *val) == 0);
+
+  may_keep (NULL);
+}
+
 void test_ratfactor (void)
 {
   may_t a, x;
@@ -4555,6 +5185,8 @@ static const char *table_antidiff[] = {
   "1/cos(a*x)^2", "tan(a*x)/a",
   "1/cos(a*x)^3", "-1/2*cos(a*x)/a-1/4*log(abs(1+cos(a*x)))/a+1/4*log(abs(1-cos(a*x)))/a",
   "tan(x)/cos(x)", "1/cos(x)",
+  "sin(x)^2/cos(x)", "-sin(x)+ln(1/cos(x)+tan(x))",
+  "sin(2*x+1)^2/cos(2*x+1)", "-sin(2*x+1)/2+ln(1/cos(2*x+1)+tan(2*x+1))/2",
   "tan(x)/cos(x)^2", "1/cos(x)^2/2",
   "tan(x)/cos(x)^1034", "1/cos(x)^2/1034",
   "1/sin(x)", "ln(abs(tan(x/2)))",
@@ -4571,6 +5203,7 @@ static const char *table_antidiff[] = {
   "x*sin(a*x)", "-x*cos(a*x)/a+sin(a*x)/a^2",
   "x^2*sin(x)", "-cos(x)*x^2+2*cos(x)+2*sin(x)*x", // "(2-x^2)*cos(x)+2*x*sin(x)",
   "x^2*sin(a*x)", "2*(x*sin(a*x)/a+cos(a*x)/a^2)/a-x^2*cos(a*x)/a", //"(2-a^2*x^2)/a^3*cos(a*x)+2*x*sin(a*x)/a^2",
+  "x^2*sin(2*x+1)", "-1/2*cos(1+2*x)*x^2+1/4*cos(1+2*x)+1/2*sin(1+2*x)*x",
 
   "exp(x)*sin(x)", "1/2*exp(x)*(sin(x)-cos(x))",
   "exp(b*x)*sin(a*x)", "exp(b*x)/(a^2+b^2)*(b*sin(a*x)-a*cos(a*x))",
@@ -4578,6 +5211,7 @@ static const char *table_antidiff[] = {
   "exp(b*x)*cos(a*x)", "exp(b*x)/(a^2+b^2)*(a*sin(a*x)+b*cos(a*x))",
 
   "x*exp(x)*sin(x)", "1/2*(cos(x)*(1-x)+sin(x)*x)*exp(x)", // "1/2*exp(x)*(cos(x)-x*cos(x)+x*sin(x))",
+  "x*exp(a*x)*cos(b*x+c)", "(b*sin(b*x+c)*(a^2*x-2*a+b^2*x)+(a^3*x+b^2+b^2*a*x-a^2)*cos(b*x+c))*exp(a*x)/(b^2+a^2)^2",
   "x*exp(x)*cos(x)", "1/2*(cos(x)*x-sin(x)*(1-x))*exp(x)", // "1/2*exp(x)*(x*cos(x)-sin(x)+x*sin(x))",
 
   "cosh(a*x)", "1/a*sinh(a*x)",
@@ -4635,6 +5269,21 @@ void test_rootof (void)
   x = may_parse_str("ROOTOF(2,0,x)^2");
   check (x, "0");
 
+  x = may_parse_str("ROOTOF(2,x+1,x)^20");
+  check (x, "4181+6765*ROOTOF(2,1+x,x)");
+
+  x = may_parse_str("ROOTOF(2,x+1,x)^(-1)");
+  check (x, "-1+ROOTOF(2,1+x,x)");
+
+  x = may_parse_str("ROOTOF(3,x/2+1,x)^7");
+  check (x, "1/4+9/8*ROOTOF(3,1+1/2*x,x)+ROOTOF(3,1+1/2*x,x)^2");
+
+  /* Below and above 2*N for a big N */
+  x = may_parse_str("ROOTOF(1000,x+1,x)^1999");
+  check (x, "1+ROOTOF(1000,1+x,x)+ROOTOF(1000,1+x,x)^999");
+  x = may_parse_str("ROOTOF(1000,x+1,x)^2001");
+  check (x, "ROOTOF(1000,1+x,x)+2*ROOTOF(1000,1+x,x)^2+ROOTOF(1000,1+x,x)^3");
+
   may_keep (NULL);
 }
 
@@ -4739,9 +5388,139 @@ void test_thread_for(void)
 
 }
 
+/* The budget of the computation is checked by the jobs of the workers */
+void test_thread_budget(void)
+{
+  volatile int cancel = 1;
+  volatile may_error_e e;
+  const char *str;
+  may_mark_t mark;
+  may_mark(mark);
+
+  may_kernel_worker(2, 0);
+  may_t x = may_set_str ("x");
+  may_t a = may_sub (may_pow (x, may_set_ui (200)), may_set_ui (1));
+  may_t b = may_sub (x, may_set_ui (2));
+
+  /* Cancel flag within the jobs */
+  may_kernel_cancel (&cancel);
+  MAY_TRY {
+    MAY_SPAWN_BLOCK(block, mark);
+    MAY_SPAWN (block, (a, b, x), { may_t q; may_t r; may_div_qr (&q, &r, a, b, x); }, ());
+    MAY_SPAWN (block, (a, b, x), { may_t q; may_t r; may_div_qr (&q, &r, a, b, x); }, ());
+    MAY_SPAWN_SYNC(block);
+    e = MAY_NO_ERR;
+  } MAY_CATCH {
+    e = MAY_ERROR;
+  } MAY_ENDTRY;
+  check_bool (e == MAY_INTERRUPT_ERR);
+  may_error_get (NULL, &str);
+  check_bool (strcmp (str, "cancel") == 0);
+  check_bool (may_kernel_cancel (NULL) == NULL);
+
+  /* Timeout within the body of a parallel loop */
+  may_kernel_timeout (1);
+  MAY_TRY {
+    MAY_SPAWN_FOR(mark, i, 0, 4*MAY_SPAWN_FOR_TH, (a, b, x), {
+        may_t q;
+        may_t r;
+        for (int j = 0; j < 1000; j++)
+          may_div_qr (&q, &r, a, b, x);
+      });
+    e = MAY_NO_ERR;
+  } MAY_CATCH {
+    e = MAY_ERROR;
+  } MAY_ENDTRY;
+  check_bool (e == MAY_INTERRUPT_ERR);
+  may_error_get (NULL, &str);
+  check_bool (strcmp (str, "timeout") == 0);
+  check_bool (may_kernel_timeout (0) == 0);
+
+  /* The workers and the budget can be used again */
+  cancel = 1;
+  may_kernel_cancel (&cancel);
+  MAY_TRY {
+    may_t q, r;
+    may_div_qr (&q, &r, a, b, x);
+    e = MAY_NO_ERR;
+  } MAY_CATCH {
+    e = MAY_ERROR;
+  } MAY_ENDTRY;
+  check_bool (e == MAY_INTERRUPT_ERR);
+  may_kernel_cancel (NULL);
+  may_t c = NULL;
+  MAY_SPAWN_BLOCK(block, mark);
+  MAY_SPAWN (block, (a, b, x), { may_t r; may_div_qr (&c, &r, a, b, x); }, (c));
+  MAY_SPAWN_SYNC(block);
+  check_bool (c != NULL);
+
+  may_kernel_worker(1, 0);
+  may_compact(mark, NULL);
+}
+
+struct session_s {
+  mp_prec_t prec;
+  int ok;
+};
+
+static void *session_main (void *data)
+{
+  struct session_s *s = data;
+  volatile int ok = 0;
+
+  if (may_session_start (0) != 0)
+    return NULL;
+  may_kernel_prec (s->prec);
+  MAY_TRY {
+    ok = 1;
+    for (unsigned long n = 2; n < 40; n++) {
+      may_mark_t mark;
+      may_mark (mark);
+      may_t x = may_set_str ("x");
+      may_t y = may_expand (may_pow (may_add (x, MAY_ONE), may_set_ui (n)));
+      ok &= may_identical (may_replace (y, x, MAY_ONE),
+                           may_set_ui (1UL << n)) == 0;
+      may_t pi = may_evalf (may_set_str ("PI"));
+      ok &= mpfr_get_prec (MAY_FLOAT (pi)) == s->prec;
+      may_compact (mark, NULL);
+    }
+    may_error_throw (MAY_DIMENSION_ERR, "session");
+    ok = 0;
+  } MAY_CATCH {
+    ok &= MAY_ERROR == MAY_DIMENSION_ERR;
+  } MAY_ENDTRY;
+  may_session_end ();
+  s->ok = ok;
+  return NULL;
+}
+
+void test_session(void)
+{
+  struct session_s s[4];
+  pthread_t th[4];
+  mp_prec_t prec = may_kernel_prec (0);
+
+  for (int i = 0; i < 4; i++) {
+    s[i].prec = 50 + 20 * i;
+    s[i].ok = 0;
+    pthread_create (&th[i], NULL, session_main, &s[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    pthread_join (th[i], NULL);
+    check_bool (s[i].ok);
+  }
+  check_bool (may_kernel_prec (0) == prec);
+}
+
 #else
 void test_thread(void) {}
 void test_thread_for(void) {}
+void test_thread_budget(void) {}
+void test_session(void)
+{
+  /* No independent session without threads */
+  check_bool (may_session_start (0) == -1);
+}
 #endif
 
 int main (int argc, const char *argv[])
@@ -4773,8 +5552,10 @@ int main (int argc, const char *argv[])
     test_get_name ();
     test_add_c ();
     test_error_handler ();
+    test_budget ();
     test_may_list ();
-    //test_matrix ();
+    test_may_hset ();
+    test_matrix ();
     test_table ();
     test_table2 ();
     test_iterator ();
@@ -4789,6 +5570,7 @@ int main (int argc, const char *argv[])
     test_sqrtsimp ();
     test_match ();
     test_rewrite ();
+    test_rewrite_rules ();
     test_domain ();
     test_divexact ();
     test_naive_gcd ();
@@ -4800,12 +5582,14 @@ int main (int argc, const char *argv[])
     test_replacefunc ();
     test_degree ();
     test_taylor ();
+    test_gradient ();
     test_indets ();
     test_divqr ();
     test_divqr_xexp ();
     test_gcd ();
     test_lcm ();
     test_rationalize ();
+    test_normal ();
     test_intmod ();
     test_texpand ();
     test_extension1 ();
@@ -4815,6 +5599,9 @@ int main (int argc, const char *argv[])
     test_approx ();
     test_intmaxsize ();
     test_sqrfree ();
+    test_resultant ();
+    test_compose ();
+    test_multipoint ();
     test_ratfactor ();
     test_series ();
     test_combine ();
@@ -4826,6 +5613,8 @@ int main (int argc, const char *argv[])
     test_rootof();
     test_thread();
     test_thread_for();
+    test_thread_budget();
+    test_session();
   } MAY_CATCH {
     may_kernel_info (stdout, "FATAL");
     printf("Exception '%s' caught\n", may_error_what (MAY_ERROR));
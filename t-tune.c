@@ -20,85 +20,438 @@ MA 02110-1301, USA. */
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <sys/resource.h>
 
 #include "may-impl.h"
 
-static may_size_t may_sort_threshold = MAY_SORT_THRESHOLD;
-#undef MAY_SORT_THRESHOLD
-#define MAY_SORT_THRESHOLD may_sort_threshold
+/* Measure the thresholds of MAYLIB on the build machine and
+   print them as the header may-tuned.h (See 'make tune'):
+     ./t-tune > may-tuned.h
+   The sources using them are included here with the thresholds
+   replaced by variables, so that they can be changed at run time.
+   A threshold keeps its default value unless the gain of the tuned
+   one is bigger than the noise of the measures.
+   MAY_MAX_TRY_HEUGCD isn't tuned since it changes the results. */
+
+static unsigned long tune_sort1 = MAY_SORT_THRESHOLD1;
+static unsigned long tune_sort2 = MAY_SORT_THRESHOLD2;
+static unsigned long tune_sort3 = MAY_SORT_THRESHOLD3;
+static unsigned long tune_basecase = MAY_EXPAND_BASECASE_THRESHOLD;
+static unsigned long tune_miller = MAY_EXPAND_POW_MILLER_THRESHOLD;
+static unsigned long tune_kronecker = MAY_EXPAND_KRONECKER_THRESHOLD;
+static unsigned long tune_algebraic = MAY_EXPAND_ALGEBRAIC_RATIO;
+static unsigned long tune_kara = MAY_KARA_THRESHOLD;
+#undef MAY_SORT_THRESHOLD1
+#undef MAY_SORT_THRESHOLD2
+#undef MAY_SORT_THRESHOLD3
+#undef MAY_EXPAND_BASECASE_THRESHOLD
+#undef MAY_EXPAND_POW_MILLER_THRESHOLD
+#undef MAY_EXPAND_KRONECKER_THRESHOLD
+#undef MAY_EXPAND_ALGEBRAIC_RATIO
+#undef MAY_KARA_THRESHOLD
+#define MAY_SORT_THRESHOLD1 tune_sort1
+#define MAY_SORT_THRESHOLD2 tune_sort2
+#define MAY_SORT_THRESHOLD3 tune_sort3
+#define MAY_EXPAND_BASECASE_THRESHOLD tune_basecase
+#define MAY_EXPAND_POW_MILLER_THRESHOLD tune_miller
+#define MAY_EXPAND_KRONECKER_THRESHOLD tune_kronecker
+#define MAY_EXPAND_ALGEBRAIC_RATIO tune_algebraic
+#define MAY_KARA_THRESHOLD tune_kara
+
+#ifdef MAY_WANT_THREAD
+static unsigned long tune_spawn = MAY_SPAWN_FOR_TH;
+# undef MAY_SPAWN_FOR_TH
+# define MAY_SPAWN_FOR_TH tune_spawn
+# include "kernel_thread.c"
+#endif
 
 #include "eval.c"
+#include "expand.c"
+#include "expand_kara.c"
+
+/* Minimal time of a measure (in ms), number of measures,
+   and minimal relative gain to change a threshold */
+#define TUNE_TIME 100
+#define TUNE_REPEAT 5
+#define TUNE_GAIN 0.05
 
 static int
 cputime (void)
 {
+#ifndef MAY_WANT_THREAD
   struct rusage rus;
 
   getrusage (0, &rus);
   return rus.ru_utime.tv_sec * 1000 + rus.ru_utime.tv_usec / 1000;
+#else
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#endif
+}
+
+/* Relative spread of the measures done since the last comparison */
+static double tune_noise;
+
+/* Return the time (in ms) of one call to bench
+   (the minimum of several measures to reduce the noise) */
+static double
+measure (void (*bench) (void))
+{
+  int t, m = 1;
+  double best = 0.0, worst = 0.0;
+
+  for (int r = 0; r < TUNE_REPEAT; ) {
+    may_mark ();
+    t = cputime ();
+    for (int i = 0; i < m; i++)
+      (*bench) ();
+    t = cputime () - t;
+    may_keep (NULL);
+    if (t < TUNE_TIME) {
+      m *= 2;
+      continue;
+    }
+    if (r++ == 0 || (double) t / m < best)
+      best = (double) t / m;
+    worst = MAX (worst, (double) t / m);
+  }
+  tune_noise = MAX (tune_noise, (worst - best) / best);
+  return best;
+}
+
+/* Return true if the time t is better than the time ref
+   by more than the noise of the measures */
+static bool
+faster_p (double t, double ref)
+{
+  return t < ref * (1.0 - MAX (TUNE_GAIN, tune_noise));
+}
+
+/* Return true if the method a shall be used rather than the method b,
+   of times ta and tb: default_p is true if the default threshold uses a.
+   *changed is set if it isn't the method of the default threshold */
+static bool
+choose_p (bool default_p, double ta, double tb, bool *changed)
+{
+  bool r = default_p ? !faster_p (tb, ta) : faster_p (ta, tb);
+  tune_noise = 0.0;
+  *changed |= r != default_p;
+  return r;
+}
+
+/* Set *param to the candidate which minimizes the time of bench,
+   if it is faster than its default value */
+static void
+best_candidate (const char name[], unsigned long *param,
+                int n, const unsigned long cand[], void (*bench) (void))
+{
+  unsigned long default_val = *param;
+  double ref = measure (bench);
+  double best = ref;
+  unsigned long best_val = default_val;
+
+  fprintf (stderr, "%s=%lu (default): %.3fms\n", name, default_val, ref);
+  for (int i = 0; i < n; i++) {
+    *param = cand[i];
+    double t = measure (bench);
+    fprintf (stderr, "%s=%lu: %.3fms\n", name, cand[i], t);
+    if (t < best)
+      best = t, best_val = cand[i];
+  }
+  if (!faster_p (best, ref))
+    best_val = default_val;
+  fprintf (stderr, "%s: noise=%.1f%% => %lu\n", name, 100.0 * tune_noise,
+           best_val);
+  tune_noise = 0.0;
+  *param = best_val;
 }
 
+/* Return the first size of a run of two sizes for which slow_p is false
+   (the sizes are given by the table size[n]) */
 static int
-my_log2(int n)
+first_win (int n, const bool slow_p[])
 {
-  return sizeof(int)*8 - __builtin_clz(n);
+  for (int i = 0; i < n; i++)
+    if (!slow_p[i] && (i == n-1 || !slow_p[i+1]))
+      return i;
+  return n;
 }
 
+/* Return a random dense univariate polynomial with n terms */
+static may_t
+random_upoly (int n, const char var[])
+{
+  may_t tab[n];
+  for (int i = 0; i < n; i++)
+    tab[i] = may_mul_c (may_set_si (rand () % 201 - 100),
+                        may_pow_c (may_set_str (var), may_set_ui (i)));
+  return may_eval (may_add_vc (n, tab));
+}
 
-static double
-measure_sort_pair (may_size_t size)
+/* Return a random polynomial in 'x', 'y', 'z' of total degree d */
+static may_t
+random_mpoly (int d)
+{
+  may_t tab[(d+1)*(d+1)*(d+1)];
+  int n = 0;
+  for (int i = 0; i <= d; i++)
+    for (int j = 0; i + j <= d; j++)
+      for (int k = 0; i + j + k <= d; k++)
+        tab[n++] = may_mul_vac (may_set_si (rand () % 21 - 10),
+                                may_pow_c (may_set_str ("x"), may_set_ui (i)),
+                                may_pow_c (may_set_str ("y"), may_set_ui (j)),
+                                may_pow_c (may_set_str ("z"), may_set_ui (k)),
+                                NULL);
+  return may_eval (may_add_vc (n, tab));
+}
+
+
+/* Sort of the pairs: count sort or merge sort */
+static may_pair_t *sort_src, *sort_tab;
+static may_size_t sort_size;
+
+static void
+bench_sort_pair (void)
+{
+  memcpy (sort_tab, sort_src, sort_size * sizeof *sort_tab);
+  sort_pair (sort_tab, sort_size);
+}
+
+static void
+tune_sort_pair (void)
+{
+  const unsigned long def1 = tune_sort1, def2 = tune_sort2, def3 = tune_sort3;
+  may_size_t size[100];
+  bool merge_p[100], changed = false;
+  int n = 0;
+
+  for (may_size_t s = 4; s < MAY_HASH_MAX * 2 && n < 100; s += s/4 + 1) {
+    may_mark ();
+    sort_src = may_alloc (s * sizeof *sort_src);
+    sort_tab = may_alloc (s * sizeof *sort_tab);
+    for (may_size_t i = 0; i < s; i++) {
+      char buffer[100];
+      sort_src[i].first = may_set_ui (rand ());
+      sprintf (buffer, "x%lu", (unsigned long) rand ());
+      sort_src[i].second = may_set_str (buffer);
+    }
+    sort_size = s;
+    /* Count sort */
+    tune_sort1 = 0, tune_sort2 = 1, tune_sort3 = 0;
+    double d1 = measure (bench_sort_pair);
+    /* Merge sort */
+    tune_sort1 = s;
+    double d2 = measure (bench_sort_pair);
+    fprintf (stderr, "sort %lu: count=%.4fms merge=%.4fms\n",
+             (unsigned long) s, d1, d2);
+    size[n] = s;
+    merge_p[n++] = choose_p (s <= def1 || (s >= def2 && s <= def3),
+                             d2, d1, &changed);
+    may_keep (NULL);
+  }
+  /* The merge sort is faster for small sizes,
+     and it may be faster again around MAY_HASH_MAX */
+  bool count_p[100];
+  int i = first_win (n, merge_p);
+  tune_sort1 = i == 0 ? 0 : size[i-1];
+  for (int j = 0; j < n; j++)
+    count_p[j] = j < i || !merge_p[j];
+  int j = first_win (n, count_p);
+  if (j < n) {
+    tune_sort2 = size[j];
+    while (j < n && merge_p[j])
+      j++;
+    tune_sort3 = size[j-1];
+  } else
+    tune_sort2 = 1, tune_sort3 = 0;
+  if (!changed)
+    tune_sort1 = def1, tune_sort2 = def2, tune_sort3 = def3;
+}
+
+
+/* Product of sums: basecase or heavy methods */
+static may_t bench_tab[10];
+
+static void
+bench_expand (void)
+{
+  for (int i = 0; i < 10 && bench_tab[i] != NULL; i++)
+    may_expand (bench_tab[i]);
+}
+
+static void
+tune_basecase_threshold (void)
+{
+  static const unsigned long cand[] = {25, 50, 100, 200, 400, 800, 1600};
+  static const char *const str[] = {
+    "(1+x+y+z)*(1+a+b+c+d)", "(1+x+y+z)^2*(x-y+z-1)^2",
+    "(1+x+y)^4*(1+z+a)^4", "(1+x+y+z)^3*(1+a+b+c)^3*(1+x+a)",
+    "(1+x+y+z+a)^4*(1-x+y-z+b)^3", NULL};
+  memset (bench_tab, 0, sizeof bench_tab);
+  for (int i = 0; str[i] != NULL; i++)
+    bench_tab[i] = may_parse_str (str[i]);
+  best_candidate ("basecase", &tune_basecase, numberof (cand), cand,
+                  bench_expand);
+}
+
+
+/* Power of univariate polynomials: recurrence or Kronecker substitution */
+static void
+tune_miller_threshold (void)
 {
-  may_mark ();
+  static const int nz[] = {8, 16, 32, 64, 128, 256};
+  const unsigned long def = tune_miller;
+  bool miller_p[numberof (nz)], changed = false;
 
-  may_pair_t *tab = may_alloc (size * sizeof *tab );
-  for(may_size_t i = 0; i < size ;i ++) {
-    char buffer[100];
-    tab[i].first = may_set_ui ((unsigned long) i*i);
-    sprintf (buffer, "x%d", (int) i);
-    tab[i].second = may_set_str (buffer);
+  for (unsigned i = 0; i < numberof (nz); i++) {
+    may_mark ();
+    memset (bench_tab, 0, sizeof bench_tab);
+    bench_tab[0] = may_eval (may_pow_c (random_upoly (nz[i], "x"),
+                                      may_set_ui (8)));
+    tune_miller = ULONG_MAX;
+    double d1 = measure (bench_expand);
+    tune_miller = 0;
+    double d2 = measure (bench_expand);
+    fprintf (stderr, "pow %d: miller=%.3fms kronecker=%.3fms\n", nz[i], d1, d2);
+    miller_p[i] = choose_p (nz[i] <= def, d1, d2, &changed);
+    may_keep (NULL);
   }
+  unsigned i = first_win (numberof (nz), miller_p);
+  tune_miller = !changed ? def : i == 0 ? 0 : nz[i-1];
+}
+
+
+/* Product of univariate polynomials: Kronecker substitution or not */
+static void
+tune_kronecker_threshold (void)
+{
+  static const int n[] = {2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128};
+  const unsigned long def = tune_kronecker;
+  bool slow_p[numberof (n)], changed = false;
+
+  for (unsigned i = 0; i < numberof (n); i++) {
+    may_mark ();
+    memset (bench_tab, 0, sizeof bench_tab);
+    bench_tab[0] = may_eval (may_mul_vac (random_upoly (n[i], "x"),
+                                          random_upoly (n[i], "x"),
+                                          random_upoly (n[i], "x"), NULL));
+    tune_kronecker = 1;
+    double d1 = measure (bench_expand);
+    tune_kronecker = ULONG_MAX;
+    double d2 = measure (bench_expand);
+    fprintf (stderr, "mul %d: kronecker=%.3fms other=%.3fms\n", n[i], d1, d2);
+    slow_p[i] = !choose_p (n[i] >= def, d1, d2, &changed);
+    may_keep (NULL);
+  }
+  unsigned i = first_win (numberof (n), slow_p);
+  tune_kronecker = !changed ? def
+    : i == numberof (n) ? ULONG_MAX / 2 : (unsigned long) n[i];
+}
+
+
+/* Power of sums with algebraic numbers: binary exponentiation or multinomial */
+static void
+tune_algebraic_ratio (void)
+{
+  static const unsigned long cand[] = {2, 3, 4, 6, 8, 16};
+  static const char *const str[] = {
+    "(sqrt(2)+sqrt(3)+sqrt(5)+x)^8", "(1+sqrt(2)+sqrt(3)+x+y)^6",
+    "(sqrt(2)+sqrt(3)+sqrt(5)+sqrt(7)+x+y)^5", "(2^(1/3)+3^(1/2)+x)^10",
+    "(1+sqrt(2)+sqrt(3)+sqrt(5)+sqrt(6)+sqrt(7)+sqrt(10)+x)^4", NULL};
+  memset (bench_tab, 0, sizeof bench_tab);
+  for (int i = 0; str[i] != NULL; i++)
+    bench_tab[i] = may_parse_str (str[i]);
+  best_candidate ("algebraic", &tune_algebraic, numberof (cand), cand,
+                  bench_expand);
+}
 
-  int t0, m0;
-  t0 = 0;
-  m0 = 5;
-  while (t0 < 1000) {
-    m0 *= 2;
-    t0 = cputime();
-    for(int m = 0; m < m0 ; m++)
-      sort_pair (tab, size);
-    t0 = cputime() - t0;
+
+/* Initial Karatsuba threshold */
+static may_t kara_a[3], kara_b[3], kara_var;
+
+static void
+bench_kara (void)
+{
+  for (int i = 0; i < 3; i++)
+    may_karatsuba (kara_a[i], kara_b[i], kara_var);
+}
+
+static void
+tune_kara_threshold (void)
+{
+  static const unsigned long cand[] = {4, 6, 10, 16, 24, 32, 48, 64};
+  for (int i = 0; i < 3; i++) {
+    kara_a[i] = may_expand (random_mpoly (4 + 3*i));
+    kara_b[i] = may_expand (random_mpoly (4 + 3*i));
   }
-  may_keep (NULL);
-  return (double) t0 / m0;
+  kara_var = may_parse_str ("{x,y,z}");
+  best_candidate ("kara", &tune_kara, numberof (cand), cand, bench_kara);
 }
 
+
+#ifdef MAY_WANT_THREAD
+/* Minimal number of iterations of a loop to spawn it over the threads */
+static may_t spawn_tab[3000];
+
 static void
-best_sort_pair (void)
-{
-  int count = 0;
-  for(may_size_t size = 4 ; size < MAY_HASH_MAX * 2; size+=my_log2(size)) {
-    /* count sort */
-    may_sort_threshold = 1;
-    double d1 = measure_sort_pair (size);
-    /* merge sort */
-    may_sort_threshold = 1000000000;
-    double d2 = measure_sort_pair (size);
-    printf ("%d %e %e\n", size, d1, d2);
-    count += (d1 < d2);
+bench_spawn (void)
+{
+  static const int n[] = {100, 300, 1000, 3000};
+  for (unsigned j = 0; j < numberof (n); j++) {
+    may_mark_t mark;
+    may_mark (mark);
+    may_t *tab = spawn_tab;
+    may_t *dest = may_alloc (n[j] * sizeof *dest);
+    MAY_SPAWN_FOR (mark, i, 0, n[j], (tab, dest), {
+        dest[i] = may_expand (may_pow (tab[i], MAY_TWO));
+      });
+    may_compact (mark, NULL);
   }
-  /* Profile
-     sort2 > sort small
-     sort2 < sort medium 7 <= ???
-     sort2 > sort around hash_max
-     sort2 < sort above 2*hash_max
-  */
 }
 
-int main()
+static void
+tune_spawn_for (void)
+{
+  static const unsigned long cand[] = {50, 100, 200, 500, 1000, 2000};
+  for (int i = 0; i < (int) numberof (spawn_tab); i++)
+    spawn_tab[i] = may_eval (may_add_c (random_upoly (3, "x"),
+                                        may_set_str ("y")));
+  best_candidate ("spawn", &tune_spawn, numberof (cand), cand, bench_spawn);
+}
+#endif
+
+int main (void)
 {
-  printf ("%s\n", may_get_version ());
+  fprintf (stderr, "%s\n", may_get_version ());
   may_kernel_start (0, 0);
-  best_sort_pair();
-  may_kernel_end();
+  srand (42);
+
+  tune_sort_pair ();
+  tune_basecase_threshold ();
+  tune_miller_threshold ();
+  tune_kronecker_threshold ();
+  tune_algebraic_ratio ();
+  tune_kara_threshold ();
+#ifdef MAY_WANT_THREAD
+  tune_spawn_for ();
+#endif
+
+  printf ("/* Generated by 'make tune' for %s */\n", may_get_version ());
+  printf ("#define MAY_SORT_THRESHOLD1 %lu\n", tune_sort1);
+  printf ("#define MAY_SORT_THRESHOLD2 %lu\n", tune_sort2);
+  printf ("#define MAY_SORT_THRESHOLD3 %lu\n", tune_sort3);
+  printf ("#define MAY_EXPAND_BASECASE_THRESHOLD %lu\n", tune_basecase);
+  printf ("#define MAY_EXPAND_POW_MILLER_THRESHOLD %lu\n", tune_miller);
+  printf ("#define MAY_EXPAND_KRONECKER_THRESHOLD %lu\n", tune_kronecker);
+  printf ("#define MAY_EXPAND_ALGEBRAIC_RATIO %lu\n", tune_algebraic);
+  printf ("#define MAY_KARA_THRESHOLD %lu\n", tune_kara);
+#ifdef MAY_WANT_THREAD
+  printf ("#define MAY_SPAWN_FOR_TH %lu\n", tune_spawn);
+#endif
+
+  may_kernel_end ();
+  return 0;
 }
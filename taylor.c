@@ -19,22 +19,443 @@ MA 02110-1301, USA. */
 
 #include "may-impl.h"
 
+/* Truncated Taylor arithmetic: each node of the evaluated expression
+   is mapped to the vector of its m+1 first Taylor coefficients in (x-a),
+   computed from the vectors of its arguments with the classic
+   recurrences (product, power, exp, log, sin/cos, ...).
+   The vectors are memoized per node so that shared subexpressions are
+   only computed once: the cost is linear in the size of the DAG and
+   quadratic in the order, whereas the successive derivatives used by
+   the generic method may grow exponentially.
+   Each coefficient is expanded as soon as it is computed, since it
+   feeds the coefficients of the next orders (the quotients of the
+   recurrences would otherwise pile up).
+   A node which can't be handled (unknown function depending on x,
+   singular point, ...) makes the whole computation fail (NULL)
+   and may_taylor falls back to the derivative method, as does
+   a point which isn't a rational number. */
+
+typedef struct {
+  may_t x, a;           /* Variable and point of the expansion */
+  unsigned long n;      /* Number of coefficients (order + 1) */
+  may_hset_t done;      /* Nodes already expanded */
+  may_t **coef;         /* coef[i]: coefficients of the i-th node of done */
+  may_size_t alloc;
+} taylor_t;
+
+static may_t *taylor_recur (taylor_t *, may_t);
+
+static may_t *
+vec_new (taylor_t *t)
+{
+  return may_alloc (t->n * sizeof (may_t));
+}
+
+static may_t *
+vec_const (taylor_t *t, may_t c)
+{
+  may_t *w = vec_new (t);
+  w[0] = c;
+  for (unsigned long k = 1; k < t->n; k++)
+    w[k] = MAY_ZERO;
+  return w;
+}
+
+/* Return the coefficient c evaluated and expanded */
+static may_t
+coef_eval (may_t c)
+{
+  c = may_eval (c);
+  return MAY_PURENUM_P (c) ? c : may_expand (c);
+}
+
+/* Return the coefficient of the sum of the n first terms of tab */
+static may_t
+vec_sum (unsigned long n, may_t *tab)
+{
+  return n == 0 ? MAY_ZERO : coef_eval (n == 1 ? tab[0] : may_add_vc (n, tab));
+}
+
+/* w = u * v */
+static may_t *
+vec_mul (taylor_t *t, const may_t *u, const may_t *v)
+{
+  may_t *w = vec_new (t);
+  may_t tab[t->n];
+  for (unsigned long k = 0; k < t->n; k++) {
+    unsigned long i = 0;
+    for (unsigned long j = 0; j <= k; j++)
+      if (!MAY_ZERO_P (u[j]) && !MAY_ZERO_P (v[k-j]))
+        tab[i++] = may_mul_c (u[j], v[k-j]);
+    w[k] = vec_sum (i, tab);
+  }
+  return w;
+}
+
+/* w = u^p with p independent of x (but not a positive integer)
+   and u[0] != 0:
+   w[k] = 1/(k*u[0]) * sum(((p+1)*j-k)*u[j]*w[k-j], j=1..k) */
+static may_t *
+vec_pow (taylor_t *t, const may_t *u, may_t p)
+{
+  may_t *w = vec_new (t);
+  may_t tab[t->n];
+  may_t p1 = may_eval (may_add_c (p, MAY_ONE));
+  w[0] = may_eval (may_pow_c (u[0], p));
+  for (unsigned long k = 1; k < t->n; k++) {
+    unsigned long i = 0;
+    for (unsigned long j = 1; j <= k; j++)
+      if (!MAY_ZERO_P (u[j]))
+        tab[i++] = may_mul_vac (may_sub_c (may_mul_c (p1, may_set_ui (j)),
+                                           may_set_ui (k)),
+                                u[j], w[k-j], NULL);
+    w[k] = coef_eval (may_div_c (vec_sum (i, tab),
+                                 may_mul_c (may_set_ui (k), u[0])));
+  }
+  return w;
+}
+
+/* w = w0*exp(u-u[0]): w[k] = 1/k * sum(j*u[j]*w[k-j], j=1..k) */
+static may_t *
+vec_exp (taylor_t *t, const may_t *u, may_t w0)
+{
+  may_t *w = vec_new (t);
+  may_t tab[t->n];
+  w[0] = w0;
+  for (unsigned long k = 1; k < t->n; k++) {
+    unsigned long i = 0;
+    for (unsigned long j = 1; j <= k; j++)
+      if (!MAY_ZERO_P (u[j]))
+        tab[i++] = may_mul_vac (may_set_ui (j), u[j], w[k-j], NULL);
+    w[k] = coef_eval (may_div_c (vec_sum (i, tab), may_set_ui (k)));
+  }
+  return w;
+}
+
+/* w = log(u) (Assuming u[0] != 0):
+   w[k] = (u[k] - 1/k*sum(j*w[j]*u[k-j], j=1..k-1)) / u[0] */
+static may_t *
+vec_log (taylor_t *t, const may_t *u)
+{
+  may_t *w = vec_new (t);
+  may_t tab[t->n];
+  w[0] = may_eval (may_log_c (u[0]));
+  for (unsigned long k = 1; k < t->n; k++) {
+    unsigned long i = 0;
+    for (unsigned long j = 1; j < k; j++)
+      if (!MAY_ZERO_P (u[k-j]) && !MAY_ZERO_P (w[j]))
+        tab[i++] = may_mul_vac (may_set_ui (j), w[j], u[k-j], NULL);
+    w[k] = coef_eval (may_div_c (may_sub_c (u[k],
+                                            may_div_c (vec_sum (i, tab),
+                                                       may_set_ui (k))),
+                                 u[0]));
+  }
+  return w;
+}
+
+/* s = sin(u), c = cos(u) (or sinh / cosh if hyperbolic):
+   s[k] = 1/k * sum(j*u[j]*c[k-j], j=1..k)
+   c[k] = -/+ 1/k * sum(j*u[j]*s[k-j], j=1..k) */
+static void
+vec_sincos (taylor_t *t, may_t **ps, may_t **pc, const may_t *u, int hyper)
+{
+  may_t *s = vec_new (t), *c = vec_new (t);
+  may_t tab_s[t->n], tab_c[t->n];
+  s[0] = may_eval (hyper ? may_sinh_c (u[0]) : may_sin_c (u[0]));
+  c[0] = may_eval (hyper ? may_cosh_c (u[0]) : may_cos_c (u[0]));
+  for (unsigned long k = 1; k < t->n; k++) {
+    unsigned long i = 0;
+    for (unsigned long j = 1; j <= k; j++)
+      if (!MAY_ZERO_P (u[j])) {
+        may_t ju = may_mul_c (may_set_ui (j), u[j]);
+        tab_s[i] = may_mul_c (ju, c[k-j]);
+        tab_c[i++] = may_mul_c (ju, s[k-j]);
+      }
+    s[k] = coef_eval (may_div_c (vec_sum (i, tab_s), may_set_ui (k)));
+    c[k] = coef_eval (may_div_c (vec_sum (i, tab_c),
+                                 may_set_si (hyper ? (long) k : -(long) k)));
+  }
+  *ps = s;
+  *pc = c;
+}
+
+/* w = tan(u) (or tanh if hyperbolic), with tan' = 1+tan^2 so that the
+   coefficients are polynomials in w[0]: with d = 1 +/- w^2,
+   w[k] = 1/k * sum(j*u[j]*d[k-j], j=1..k) */
+static may_t *
+vec_tan (taylor_t *t, const may_t *u, may_t w0, int hyper)
+{
+  may_t *w = vec_new (t), *d = vec_new (t);
+  may_t tab[t->n];
+  w[0] = w0;
+  for (unsigned long k = 1; k < t->n; k++) {
+    unsigned long i = 0, m = k-1;
+    /* d[k-1] only depends on w[0..k-1] */
+    for (unsigned long j = 0; j <= m; j++)
+      if (!MAY_ZERO_P (w[j]) && !MAY_ZERO_P (w[m-j]))
+        tab[i++] = may_mul_c (w[j], w[m-j]);
+    may_t sqr = vec_sum (i, tab);
+    if (hyper)
+      sqr = may_neg_c (sqr);
+    d[m] = coef_eval (m == 0 ? may_add_c (MAY_ONE, sqr) : sqr);
+    i = 0;
+    for (unsigned long j = 1; j <= k; j++)
+      if (!MAY_ZERO_P (u[j]) && !MAY_ZERO_P (d[k-j]))
+        tab[i++] = may_mul_vac (may_set_ui (j), u[j], d[k-j], NULL);
+    w[k] = coef_eval (may_div_c (vec_sum (i, tab), may_set_ui (k)));
+  }
+  return w;
+}
+
+/* Return the first non zero index of u (or t->n if u is zero) */
+static unsigned long
+vec_valuation (taylor_t *t, const may_t *u)
+{
+  unsigned long v = 0;
+  while (v < t->n && MAY_ZERO_P (u[v]))
+    v++;
+  return v;
+}
+
+/* w = u^p with p a positive integer, by binary powering with vec_mul
+   (the recurrence of vec_pow would divide each coefficient by u[0]).
+   Return NULL if p is too big */
+static may_t *
+vec_pow_ui (taylor_t *t, const may_t *u, may_t p)
+{
+  unsigned long v = vec_valuation (t, u), e;
+  may_t *w = NULL;
+
+  /* u = (x-a)^v*u' so u^p = O((x-a)^(v*p)) */
+  if (v > 0 && (v >= t->n || !mpz_fits_ulong_p (MAY_INT (p))
+                || mpz_get_ui (MAY_INT (p)) >= t->n
+                || mpz_get_ui (MAY_INT (p)) * v >= t->n))
+    return vec_const (t, MAY_ZERO);
+  if (!mpz_fits_ulong_p (MAY_INT (p)))
+    return NULL;
+  for (e = mpz_get_ui (MAY_INT (p)); ; e >>= 1) {
+    if ((e & 1) != 0) {
+      if (w == NULL) {
+        w = vec_new (t);
+        memcpy (w, u, t->n * sizeof (may_t));
+      } else
+        w = vec_mul (t, w, u);
+    }
+    if (e == 1)
+      return w;
+    u = vec_mul (t, u, u);
+  }
+}
+
+/* Return the vector of a unary function from the vector of the
+   derivative of its inverse: w[0] = f(u[0]), w[k] = (u'*h)[k-1]/k
+   with h=h0^p0 (*h1^p1 if h1 is not NULL) */
+static may_t *
+vec_integ (taylor_t *t, may_t f, const may_t *u,
+           const may_t *h0, may_t p0, const may_t *h1, may_t p1)
+{
+  may_t *d, *h, *w;
+  unsigned long k;
+
+  if (MAY_ZERO_P (h0[0]) || (h1 != NULL && MAY_ZERO_P (h1[0])))
+    return NULL;
+  h = vec_pow (t, h0, p0);
+  if (h1 != NULL)
+    h = vec_mul (t, h, vec_pow (t, h1, p1));
+  d = vec_new (t);
+  for (k = 0; k + 1 < t->n; k++)
+    d[k] = coef_eval (may_mul_c (may_set_ui (k+1), u[k+1]));
+  d[k] = MAY_ZERO;
+  d = vec_mul (t, d, h);
+  w = vec_new (t);
+  w[0] = f;
+  for (k = 1; k < t->n; k++)
+    w[k] = coef_eval (may_div_c (d[k-1], may_set_ui (k)));
+  return w;
+}
+
+/* Return 1+s*u^2 */
+static may_t *
+vec_one_sqr (taylor_t *t, const may_t *u, long s)
+{
+  may_t *w = vec_mul (t, u, u);
+  for (unsigned long k = 0; k < t->n; k++)
+    w[k] = coef_eval (may_mul_c (may_set_si (s), w[k]));
+  w[0] = coef_eval (may_add_c (MAY_ONE, w[0]));
+  return w;
+}
+
+/* Return u+c */
+static may_t *
+vec_add_const (taylor_t *t, const may_t *u, may_t c)
+{
+  may_t *w = vec_new (t);
+  memcpy (w, u, t->n * sizeof (may_t));
+  w[0] = coef_eval (may_add_c (u[0], c));
+  return w;
+}
+
+static may_t *
+taylor_node (taylor_t *t, may_t f)
+{
+  may_t *u, *w, *s, *c;
+  may_t f0, half;
+  may_size_t i, n;
+  unsigned long k;
+  may_type_t type = MAY_TYPE (f);
+
+  if (type == MAY_STRING_T && may_identical (f, t->x) == 0) {
+    w = vec_const (t, t->a);
+    if (t->n > 1)
+      w[1] = MAY_ONE;
+    return w;
+  }
+  if (may_independent_p (f, t->x))
+    return vec_const (t, f);
+
+  half = may_set_si_ui (-1, 2);
+  switch (type) {
+  case MAY_SUM_T:
+    n = MAY_NODE_SIZE (f);
+    {
+      may_t *v[n], tab[n];
+      for (i = 0; i < n; i++)
+        if ((v[i] = taylor_recur (t, MAY_AT (f, i))) == NULL)
+          return NULL;
+      w = vec_new (t);
+      for (k = 0; k < t->n; k++) {
+        may_size_t j = 0;
+        for (i = 0; i < n; i++)
+          if (!MAY_ZERO_P (v[i][k]))
+            tab[j++] = v[i][k];
+        w[k] = vec_sum (j, tab);
+      }
+    }
+    return w;
+  case MAY_PRODUCT_T:
+    n = MAY_NODE_SIZE (f);
+    if ((w = taylor_recur (t, MAY_AT (f, 0))) == NULL)
+      return NULL;
+    for (i = 1; i < n; i++) {
+      if ((u = taylor_recur (t, MAY_AT (f, i))) == NULL)
+        return NULL;
+      w = vec_mul (t, w, u);
+    }
+    return w;
+  case MAY_FACTOR_T:
+    if ((u = taylor_recur (t, MAY_AT (f, 1))) == NULL)
+      return NULL;
+    w = vec_new (t);
+    for (k = 0; k < t->n; k++)
+      w[k] = coef_eval (may_mul_c (MAY_AT (f, 0), u[k]));
+    return w;
+  case MAY_POW_T:
+    if ((u = taylor_recur (t, MAY_AT (f, 0))) == NULL)
+      return NULL;
+    if (may_independent_p (MAY_AT (f, 1), t->x)) {
+      if (MAY_TYPE (MAY_AT (f, 1)) == MAY_INT_T
+          && mpz_sgn (MAY_INT (MAY_AT (f, 1))) > 0)
+        return vec_pow_ui (t, u, MAY_AT (f, 1));
+      if (!MAY_ZERO_P (u[0]))
+        return vec_pow (t, u, MAY_AT (f, 1));
+      return NULL;
+    }
+    /* u^e = exp(e*log(u)) */
+    if (MAY_ZERO_P (u[0])
+        || (s = taylor_recur (t, MAY_AT (f, 1))) == NULL)
+      return NULL;
+    f0 = may_eval (may_pow_c (u[0], s[0]));
+    return vec_exp (t, vec_mul (t, s, vec_log (t, u)), f0);
+  default:
+    break;
+  }
+
+  /* Unary functions */
+  if (type <= MAY_ATOMIC_LIMIT || type >= MAY_UNARYFUNC_LIMIT
+      || (u = taylor_recur (t, MAY_AT (f, 0))) == NULL)
+    return NULL;
+  f0 = MAY_NODE_C (type, 1);
+  MAY_SET_AT (f0, 0, u[0]);
+  f0 = may_eval (f0);
+  switch (type) {
+  case MAY_EXP_T:
+    return vec_exp (t, u, f0);
+  case MAY_LOG_T:
+    return MAY_ZERO_P (u[0]) ? NULL : vec_log (t, u);
+  case MAY_SIN_T:
+  case MAY_COS_T:
+  case MAY_SINH_T:
+  case MAY_COSH_T:
+    vec_sincos (t, &s, &c, u, type == MAY_SINH_T || type == MAY_COSH_T);
+    return type == MAY_SIN_T || type == MAY_SINH_T ? s : c;
+  case MAY_TAN_T:
+  case MAY_TANH_T:
+    {
+      /* Singular if cos(u[0]) = 0 */
+      may_t c0 = may_eval (type == MAY_TAN_T ? may_cos_c (u[0])
+                           : may_cosh_c (u[0]));
+      return MAY_ZERO_P (c0) ? NULL : vec_tan (t, u, f0, type == MAY_TANH_T);
+    }
+  case MAY_ASIN_T:
+    /* asin(u)' = u' * (1-u^2)^(-1/2) */
+    return vec_integ (t, f0, u, vec_one_sqr (t, u, -1), half, NULL, NULL);
+  case MAY_ACOS_T:
+    /* acos(u)' = u' * -(1-u^2)^(-1/2) */
+    w = vec_integ (t, f0, u, vec_one_sqr (t, u, -1), half, NULL, NULL);
+    if (w != NULL)
+      for (k = 1; k < t->n; k++)
+        w[k] = coef_eval (may_neg_c (w[k]));
+    return w;
+  case MAY_ATAN_T:
+    /* atan(u)' = u' * (1+u^2)^(-1) */
+    return vec_integ (t, f0, u, vec_one_sqr (t, u, 1), MAY_N_ONE, NULL, NULL);
+  case MAY_ASINH_T:
+    /* asinh(u)' = u' * (1+u^2)^(-1/2) */
+    return vec_integ (t, f0, u, vec_one_sqr (t, u, 1), half, NULL, NULL);
+  case MAY_ACOSH_T:
+    /* acosh(u)' = u' * (u-1)^(-1/2) * (u+1)^(-1/2) */
+    return vec_integ (t, f0, u, vec_add_const (t, u, MAY_N_ONE), half,
+                      vec_add_const (t, u, MAY_ONE), half);
+  case MAY_ATANH_T:
+    /* atanh(u)' = u' * (1-u^2)^(-1) */
+    return vec_integ (t, f0, u, vec_one_sqr (t, u, -1), MAY_N_ONE, NULL, NULL);
+  default:
+    return NULL;
+  }
+}
+
+static may_t *
+taylor_recur (taylor_t *t, may_t f)
+{
+  may_size_t i;
+  may_t *w;
+
+  if (may_hset_find (&i, t->done, f))
+    return t->coef[i];
+  w = taylor_node (t, f);
+  if (w == NULL)
+    return NULL;
+  i = may_hset_push_back (t->done, f);
+  if (i >= t->alloc) {
+    may_size_t alloc = 2 * t->alloc + 16;
+    t->coef = may_realloc (t->coef, t->alloc * sizeof (may_t *),
+                           alloc * sizeof (may_t *));
+    t->alloc = alloc;
+  }
+  t->coef[i] = w;
+  return w;
+}
+
 /* Returns sum(diff(f,v,n)/n!*(x-a)^n,n=0,m) */
 
-may_t
-may_taylor (may_t f, may_t x, may_t a, unsigned long m)
+static may_t
+taylor_diff (may_t f, may_t x, may_t a, unsigned long m)
 {
   mpz_t z;
   unsigned long n;
   may_t xa, ref, fn;
   may_t result[m+1];
 
-  MAY_ASSERT (MAY_EVAL_P (f) && MAY_EVAL_P (x) && MAY_EVAL_P (a));
-  MAY_ASSERT (MAY_TYPE (x) == MAY_STRING_T);
-  MAY_LOG_FUNC (("f='%Y' x='%Y' a='%Y' m=%lu", f, x, a, m));
-
-  may_mark ();
-
   mpz_init_set_ui (z, 1);
   xa = may_set_ui (1);
   ref = may_sub (x, a);
@@ -54,6 +475,44 @@ may_taylor (may_t f, may_t x, may_t a, unsigned long m)
                                       xa),
                            may_set_z (z));
   }
-  ref = may_add_vc (m+1, result);
-  return may_keep (may_eval (ref));
+  return may_add_vc (m+1, result);
+}
+
+may_t
+may_taylor (may_t f, may_t x, may_t a, unsigned long m)
+{
+  taylor_t t;
+  may_t *c, xa, ref, y;
+  may_t result[m+1];
+  unsigned long k;
+
+  MAY_ASSERT (MAY_EVAL_P (f) && MAY_EVAL_P (x) && MAY_EVAL_P (a));
+  MAY_ASSERT (MAY_TYPE (x) == MAY_STRING_T);
+  MAY_LOG_FUNC (("f='%Y' x='%Y' a='%Y' m=%lu", f, x, a, m));
+
+  may_mark ();
+
+  t.x = x;
+  t.a = a;
+  t.n = m + 1;
+  t.coef = NULL;
+  t.alloc = 0;
+  may_hset_init (t.done, 0);
+  /* At a point which isn't a rational number, the coefficients are
+     expressions of the point which are smaller with the derivatives */
+  c = MAY_TYPE (a) == MAY_INT_T || MAY_TYPE (a) == MAY_RAT_T
+    ? taylor_recur (&t, f) : NULL;
+  if (c == NULL)
+    y = taylor_diff (f, x, a, m);
+  else {
+    xa = MAY_ONE;
+    ref = may_sub (x, a);
+    result[0] = c[0];
+    for (k = 1; k <= m; k++) {
+      xa = may_mul (xa, ref);       /* xa = (x-a)^k */
+      result[k] = may_mul_c (c[k], xa);
+    }
+    y = may_add_vc (m+1, result);
+  }
+  return may_keep (may_eval (y));
 }